@@ -6,7 +6,11 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <stdexcept>
+#include <vector>
 #include "bst.h"
+#include "frozen_tree.h"
+#include "thread_pool.h"
 
 struct KeyError { };
 
@@ -14,6 +18,9 @@ struct KeyError { };
 * A special kind of node for an AVL tree, which adds the balance as a data member, plus
 * other additional helper functions. You do NOT need to implement any functionality or
 * add additional data members or helper functions.
+* The subtree size is only kept up to date by order-statistic AVLTrees; it is
+* 32 bits so that it shares the padding after the balance, which is why those
+* trees refuse to grow past AVLTree::MAX_ORDER_STATISTICS_SIZE items.
 */
 template <typename Key, typename Value>
 class AVLNode : public Node<Key, Value>
@@ -21,22 +28,28 @@ class AVLNode : public Node<Key, Value>
 public:
     // Constructor/destructor.
     AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
-    virtual ~AVLNode();
+    AVLNode(const ItemBuilder<Key, Value>& build, AVLNode<Key, Value>* parent);
+    ~AVLNode();
 
     // Getter/setter for the node's height.
     int8_t getBalance () const;
     void setBalance (int8_t balance);
     void updateBalance(int8_t diff);
 
-    // Getters for parent, left, and right. These need to be redefined since they
+    // Getter/setter for the number of nodes in this subtree.
+    uint32_t getSize() const;
+    void setSize(uint32_t size);
+
+    // Getters for parent, left, and right. These hide the Node versions since they
     // return pointers to AVLNodes - not plain Nodes. See the Node class in bst.h
     // for more information.
-    virtual AVLNode<Key, Value>* getParent() const override;
-    virtual AVLNode<Key, Value>* getLeft() const override;
-    virtual AVLNode<Key, Value>* getRight() const override;
+    AVLNode<Key, Value>* getParent() const;
+    AVLNode<Key, Value>* getLeft() const;
+    AVLNode<Key, Value>* getRight() const;
 
 protected:
     int8_t balance_;    // effectively a signed char
+    uint32_t size_;
 };
 
 /*
@@ -50,7 +63,17 @@ protected:
 */
 template<class Key, class Value>
 AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value> *parent) :
-    Node<Key, Value>(key, value, parent), balance_(0)
+    Node<Key, Value>(key, value, parent), balance_(0), size_(1)
+{
+
+}
+
+/**
+* A constructor whose key/value pair build constructs in place.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>::AVLNode(const ItemBuilder<Key, Value>& build, AVLNode<Key, Value> *parent) :
+    Node<Key, Value>(build, parent), balance_(0), size_(1)
 {
 
 }
@@ -92,8 +115,26 @@ void AVLNode<Key, Value>::updateBalance(int8_t diff)
 }
 
 /**
-ting the parent since a static_cast is necessary to make sure
-* that our node is a AVLNode.
+* A getter for the size of the subtree rooted at this node.
+*/
+template<class Key, class Value>
+uint32_t AVLNode<Key, Value>::getSize() const
+{
+    return size_;
+}
+
+/**
+* A setter for the size of the subtree rooted at this node.
+*/
+template<class Key, class Value>
+void AVLNode<Key, Value>::setSize(uint32_t size)
+{
+    size_ = size;
+}
+
+/**
+* A getter for the parent. A static_cast is all that is needed since every
+* node in an AVLTree is an AVLNode, so no virtual call is involved.
 */
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getParent() const
@@ -127,21 +168,103 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
 */
 
 
-template <class Key, class Value>
-class AVLTree : public BinarySearchTree<Key, Value>
+/**
+* A self-balancing AVL tree.
+* With OrderStatistics set, every AVLNode also tracks its subtree size, which
+* makes select() and rank() O(log n) at the price of walking the whole path
+* to the root on each insert and remove. The sizes are 32 bits, so such a
+* tree holds at most MAX_ORDER_STATISTICS_SIZE items; an insert, bulk load,
+* join or union that would go past that throws std::length_error.
+*/
+template <class Key, class Value, class Compare = std::less<Key>, bool OrderStatistics = false>
+class AVLTree : public BinarySearchTree<Key, Value, Compare>
 {
 public:
-    virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
+    typedef typename BinarySearchTree<Key, Value, Compare>::iterator iterator;
+
+    AVLTree();
+    explicit AVLTree(std::shared_ptr<NodePool> pool, const Compare& comp = Compare());
     virtual void remove(const Key& key);  // TODO
+
+    // Order statistics (OrderStatistics trees only)
+    static const std::size_t MAX_ORDER_STATISTICS_SIZE = UINT32_MAX;
+    iterator select(std::size_t k) const;
+    std::size_t rank(const Key& key) const;
+
+    // Join and split in O(log n); the tree passed in is emptied and,
+    // unless one of the two is empty, must share this tree's node pool
+    void join(const Key& key, const Value& value, AVLTree& right);
+    void join(AVLTree& right);
+    void split(const Key& key, AVLTree& right);
+
+    // Set operations built on join/split, with the same pool rule; the tree
+    // passed in is emptied
+    void unionWith(AVLTree& other, ThreadPool& threads = ThreadPool::shared());
+    void intersectWith(AVLTree& other, ThreadPool& threads = ThreadPool::shared());
+    void difference(AVLTree& other, ThreadPool& threads = ThreadPool::shared());
+
+    // Read-only copy laid out for fast lookups
+    FrozenTree<Key, Value, Compare> freeze() const;
 protected:
+    // Constructor for derived trees whose nodes extend AVLNode
+    AVLTree(std::size_t nodeSize, typename BinarySearchTree<Key, Value, Compare>::NodeDestroyer destroyer,
+        std::shared_ptr<NodePool> pool, const Compare& comp);
+
     virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+    virtual Node<Key, Value>* constructNode(const ItemBuilder<Key, Value>& build, Node<Key, Value>* parent);
+    virtual void insertFixup(Node<Key, Value>* node);
+    virtual void builtSubtree(Node<Key, Value>* node, int leftHeight, int rightHeight);
+    virtual const char* checkNode(const Node<Key, Value>* node, int leftHeight, int rightHeight) const;
+
+    // Join/split on detached subtrees whose heights are passed along
+    enum SetOperation { SET_UNION, SET_INTERSECTION, SET_DIFFERENCE };
+    // set operations only fork while both subtrees are at least this tall
+    static const int PARALLEL_MIN_HEIGHT = 16;
+
+    AVLNode<Key, Value>* takeNodes(AVLTree& other, int& height);
+    static std::size_t addCounts(std::size_t a, std::size_t b);
+    static void checkOrderStatisticsSize(std::size_t count);
+    static AVLNode<Key, Value>* joinNodes(AVLNode<Key, Value>* left, int leftHeight, AVLNode<Key, Value>* pivot,
+        AVLNode<Key, Value>* right, int rightHeight, int& height);
+    static AVLNode<Key, Value>* joinSpine(AVLNode<Key, Value>* left, int leftHeight, AVLNode<Key, Value>* pivot,
+        AVLNode<Key, Value>* right, int rightHeight, int& height);
+    static AVLNode<Key, Value>* joinNodes(AVLNode<Key, Value>* left, int leftHeight,
+        AVLNode<Key, Value>* right, int rightHeight, int& height);
+    static AVLNode<Key, Value>* splitLast(AVLNode<Key, Value>* node, int height,
+        AVLNode<Key, Value>*& last, int& restHeight);
+    void splitNodes(AVLNode<Key, Value>* node, int height, const Key& key,
+        AVLNode<Key, Value>*& left, int& leftHeight, AVLNode<Key, Value>*& found,
+        AVLNode<Key, Value>*& right, int& rightHeight) const;
+    AVLNode<Key, Value>* setOperationNodes(SetOperation op, AVLNode<Key, Value>* a, int aHeight,
+        AVLNode<Key, Value>* b, int bHeight, int& height, std::vector<Node<Key, Value>*>& garbage,
+        ThreadPool& threads) const;
+    void setOperation(SetOperation op, AVLTree& other, ThreadPool& threads);
 
     // Add helper functions here
 		AVLNode<Key, Value>* rotateLeft(AVLNode<Key, Value>* node) {
+			AVLNode<Key, Value>* top = rotateLeftAt(node);
+			// if working with root node, update pointer
+			if (top != NULL && top->getParent() == NULL) {
+				this->root_ = top;
+			}
+			return top;
+		}
+
+		AVLNode<Key, Value>* rotateRight(AVLNode<Key, Value>* node) {
+			AVLNode<Key, Value>* top = rotateRightAt(node);
+			if (top != NULL && top->getParent() == NULL) {
+				this->root_ = top;
+			}
+			return top;
+		}
+
+		// rotations that also work on subtrees detached from the tree (join/split)
+		static AVLNode<Key, Value>* rotateLeftAt(AVLNode<Key, Value>* node) {
 			// TODO
 			if (node == NULL || node->getRight() == NULL) {
 				return node;
 			}
+			BST_COUNT(ROTATIONS);
 
 			AVLNode<Key, Value>* parent = node->getParent();
 			AVLNode<Key, Value>* rightChild = node->getRight();
@@ -152,10 +275,7 @@ protected:
 
 			rightChild->setParent(parent);
 
-			// if working with root node, update pointer
-			if (parent == NULL) {
-				this->root_ = rightChild;
-			} else {
+			if (parent != NULL) {
 				if (parent->getLeft() == node) {
 					parent->setLeft(rightChild);
 				} else {
@@ -173,6 +293,11 @@ protected:
 			rightChild->setLeft(node);
 			node->setParent(rightChild);
 
+			if (OrderStatistics) {
+				updateSize(node);
+				updateSize(rightChild);
+			}
+
 			// set balance to each modified node in subtree
 			int8_t newNodeBalance = nodeBalance - 1 - std::max(rightBalance, (int8_t)0);
 			int8_t newRightChildBalance = rightBalance - 1 + std::min(newNodeBalance, (int8_t)0);
@@ -183,11 +308,12 @@ protected:
 			return rightChild;
 		}
 
-		AVLNode<Key, Value>* rotateRight(AVLNode<Key, Value>* node) {
+		static AVLNode<Key, Value>* rotateRightAt(AVLNode<Key, Value>* node) {
 			// base case or don't need a right rotation
 			if (node == NULL || node->getLeft() == NULL) {
 				return node;
 			}
+			BST_COUNT(ROTATIONS);
 
 			AVLNode<Key, Value>* parent = node->getParent();
 			AVLNode<Key, Value>* leftChild = node->getLeft();
@@ -198,10 +324,7 @@ protected:
 
 			leftChild->setParent(parent);
 
-			// if working with root node, update pointer
-			if (parent == NULL) {
-				this->root_ = leftChild;
-			} else {
+			if (parent != NULL) {
 				if (parent->getLeft() == node) {
 					parent->setLeft(leftChild);
 				} else {
@@ -219,6 +342,11 @@ protected:
 			leftChild->setRight(node);
 			node->setParent(leftChild);
 
+			if (OrderStatistics) {
+				updateSize(node);
+				updateSize(leftChild);
+			}
+
 			// set balance to each modified node in subtree
 			int8_t newNodeBalance = nodeBalance + 1 - std::min(leftBalance, (int8_t)0);
 			int8_t newLeftChildBalance = leftBalance + 1 + std::max(newNodeBalance, (int8_t)0);
@@ -229,10 +357,97 @@ protected:
 			return leftChild;
 		}
 
+		static uint32_t subtreeSize(AVLNode<Key, Value>* node) {
+			return node == NULL ? 0 : node->getSize();
+		}
+
+		static void updateSize(AVLNode<Key, Value>* node) {
+			node->setSize(1 + subtreeSize(node->getLeft()) + subtreeSize(node->getRight()));
+		}
+
+		// add diff to the size of node and every ancestor
+		static void adjustSizesToRoot(AVLNode<Key, Value>* node, int diff) {
+			while (node != NULL) {
+				node->setSize(node->getSize() + diff);
+				node = node->getParent();
+			}
+		}
+
+		// height of a subtree, read off the balances along its tallest path
+		static int subtreeHeight(AVLNode<Key, Value>* node) {
+			int height = 0;
+			while (node != NULL) {
+				++height;
+				node = node->getBalance() < 0 ? node->getLeft() : node->getRight();
+			}
+			return height;
+		}
+
+		static void exposeChildren(AVLNode<Key, Value>* node, int height,
+			AVLNode<Key, Value>*& left, int& leftHeight, AVLNode<Key, Value>*& right, int& rightHeight) {
+			left = node->getLeft();
+			right = node->getRight();
+			leftHeight = height - (node->getBalance() > 0 ? 2 : 1);
+			rightHeight = height - (node->getBalance() < 0 ? 2 : 1);
+
+			node->setLeft(NULL);
+			node->setRight(NULL);
+			if (left != NULL) {
+				left->setParent(NULL);
+			}
+			if (right != NULL) {
+				right->setParent(NULL);
+			}
+		}
+
+		static void collectNodes(AVLNode<Key, Value>* node, std::vector<Node<Key, Value>*>& out) {
+			if (node == NULL) {
+				return;
+			}
+			collectNodes(node->getLeft(), out);
+			collectNodes(node->getRight(), out);
+			out.push_back(node);
+		}
+
+		// insertHelper for a detached subtree: node's child just got one
+		// taller; returns whether the whole subtree got taller too
+		static bool growHelper(AVLNode<Key, Value>* node) {
+			while (true) {
+				int8_t balance = node->getBalance();
+				if (balance == 0) {
+					return false;
+				}
+
+				if (balance == 1 || balance == -1) {
+					AVLNode<Key, Value>* parent = node->getParent();
+					if (parent == NULL) {
+						return true;
+					}
+					parent->updateBalance(parent->getLeft() == node ? -1 : 1);
+					node = parent;
+					continue;
+				}
+
+				if (balance == 2) {
+					if (node->getRight()->getBalance() == -1) {
+						rotateRightAt(node->getRight());
+					}
+					rotateLeftAt(node);
+				} else {
+					if (node->getLeft()->getBalance() == 1) {
+						rotateLeftAt(node->getLeft());
+					}
+					rotateRightAt(node);
+				}
+				return false;
+			}
+		}
+
 		void insertHelper(AVLNode<Key, Value>* node) {
 			AVLNode<Key, Value>* parent = node;
 
 			while (parent != NULL) {
+				BST_REBALANCE_STEP();
 				int8_t parent_balance = parent->getBalance();
 				if (parent_balance == 0) {
 					break;
@@ -279,6 +494,7 @@ protected:
 
 		void removeHelper(AVLNode<Key, Value>* node, int8_t difference) {
 			while (node != NULL && difference != 0) {
+				BST_REBALANCE_STEP();
 				AVLNode<Key, Value>* parent = node->getParent();
 				int8_t nextDiff = 0;
 				// update initial balance
@@ -337,43 +553,75 @@ protected:
 		}
 };
 
+template<class Key, class Value, class Compare, bool OrderStatistics>
+const std::size_t AVLTree<Key, Value, Compare, OrderStatistics>::MAX_ORDER_STATISTICS_SIZE;
+
+/**
+* Default constructor, which sizes the node pool for AVLNodes.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+AVLTree<Key, Value, Compare, OrderStatistics>::AVLTree() :
+    BinarySearchTree<Key, Value, Compare>(sizeof(AVLNode<Key, Value>),
+        &BinarySearchTree<Key, Value, Compare>::template destroyAs<AVLNode<Key, Value> >,
+        std::shared_ptr<NodePool>(), Compare())
+{
+
+}
+
+/**
+* Constructor that allocates nodes from a (possibly shared) pool and
+* orders keys with comp.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+AVLTree<Key, Value, Compare, OrderStatistics>::AVLTree(std::shared_ptr<NodePool> pool, const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare>(sizeof(AVLNode<Key, Value>),
+        &BinarySearchTree<Key, Value, Compare>::template destroyAs<AVLNode<Key, Value> >,
+        pool, comp)
+{
+
+}
+
+/**
+* Constructor for derived trees whose nodes are AVLNodes with extra
+* members: the pool blocks are nodeSize bytes and destroyer knows the
+* real node type.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+AVLTree<Key, Value, Compare, OrderStatistics>::AVLTree(std::size_t nodeSize,
+    typename BinarySearchTree<Key, Value, Compare>::NodeDestroyer destroyer,
+    std::shared_ptr<NodePool> pool, const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare>(nodeSize, destroyer, pool, comp)
+{
+
+}
+
 /*
  * Recall: If key is already in the tree, you should 
  * overwrite the current value with the updated value.
+ * The shared BinarySearchTree insert path finds the spot and links the new
+ * AVLNode; this hook then fixes the balances on the way back up.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::insert(const std::pair<const Key, Value> &new_item)
+template<class Key, class Value, class Compare, bool OrderStatistics>
+void AVLTree<Key, Value, Compare, OrderStatistics>::insertFixup(Node<Key, Value>* node)
 {
-	if (this->root_ == NULL) {
-		this->root_ = new AVLNode<Key, Value>(new_item.first, new_item.second, NULL);
+	AVLNode<Key, Value>* parent = static_cast<AVLNode<Key, Value>*>(node)->getParent();
+	if (parent == NULL) {
 		return;
 	}
 
-	AVLNode<Key, Value>* curr = static_cast<AVLNode<Key,Value>*>(this->root_);
-	AVLNode<Key, Value>* parent = NULL;
-
-	while (curr != NULL) {
-		parent = curr;
-		if (new_item.first < curr->getKey()) {
-			curr = curr->getLeft();
-		} else if (new_item.first > curr->getKey()) {
-			curr = curr->getRight();
-		} else {
-			curr->setValue(new_item.second);
-			return;
-		}
+	// sizes first, so the rotations below see correct child sizes
+	if (OrderStatistics) {
+		adjustSizesToRoot(parent, 1);
 	}
 
-	AVLNode<Key, Value>* newNode = new AVLNode<Key, Value>(new_item.first, new_item.second, parent);
-	if (new_item.first < parent->getKey()) {
-		parent->setLeft(newNode);
+	if (parent->getLeft() == node) {
 		parent->updateBalance(-1);
 	} else {
-		parent->setRight(newNode);
 		parent->updateBalance(1);
 	}
 
 	if (parent->getBalance() != 0) {
+		BST_REBALANCE_START();
 		insertHelper(parent);
 	}
 }
@@ -382,8 +630,8 @@ void AVLTree<Key, Value>::insert(const std::pair<const Key, Value> &new_item)
  * Recall: The writeup specifies that if a node has 2 children you
  * should swap with the predecessor and then remove.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::remove(const Key& key)
+template<class Key, class Value, class Compare, bool OrderStatistics>
+void AVLTree<Key, Value, Compare, OrderStatistics>::remove(const Key& key)
 {
 	AVLNode<Key, Value>* nodeToRemove = static_cast<AVLNode<Key, Value>*>(this->internalFind(key));
 	
@@ -397,6 +645,8 @@ void AVLTree<Key, Value>::remove(const Key& key)
 		nodeSwap(nodeToRemove, pred);
 	}
 
+	this->boundsBeforeUnlink(nodeToRemove);
+
 	AVLNode<Key, Value>* parent = nodeToRemove->getParent();
 	AVLNode<Key, Value>* child = NULL;
 
@@ -428,18 +678,572 @@ void AVLTree<Key, Value>::remove(const Key& key)
 
 	AVLNode<Key, Value>* temp_node = parent;
 
-	delete nodeToRemove;
+	this->destroyNode(nodeToRemove);
+
+	if (OrderStatistics) {
+		adjustSizesToRoot(parent, -1);
+	}
 
+	BST_REBALANCE_START();
 	removeHelper(temp_node, difference);
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+/**
+* Nodes of an AVLTree are AVLNodes, for both inserts and bulk loads.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+Node<Key, Value>* AVLTree<Key, Value, Compare, OrderStatistics>::constructNode(const ItemBuilder<Key, Value>& build,
+    Node<Key, Value>* parent)
+{
+    if (OrderStatistics) {
+        checkOrderStatisticsSize(this->size() + 1);
+    }
+    return this->template createNode<AVLNode<Key, Value> >(build, static_cast<AVLNode<Key, Value>*>(parent));
+}
+
+/**
+* Bulk-load hook: the balance is known as soon as both subtree heights are.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+void AVLTree<Key, Value, Compare, OrderStatistics>::builtSubtree(Node<Key, Value>* node, int leftHeight, int rightHeight)
+{
+    AVLNode<Key, Value>* avlNode = static_cast<AVLNode<Key, Value>*>(node);
+    avlNode->setBalance(rightHeight - leftHeight);
+    if (OrderStatistics) {
+        updateSize(avlNode);
+    }
+}
+
+/**
+* validate() hook: the stored balance must be the actual height
+* difference (and within one), and order statistic sizes must add up.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+const char* AVLTree<Key, Value, Compare, OrderStatistics>::checkNode(const Node<Key, Value>* node,
+    int leftHeight, int rightHeight) const
 {
-    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    const AVLNode<Key, Value>* avlNode = static_cast<const AVLNode<Key, Value>*>(node);
+    if (avlNode->getBalance() != rightHeight - leftHeight) {
+        return "a stored balance factor does not match the subtree heights";
+    }
+    if (std::abs(rightHeight - leftHeight) > 1) {
+        return "a node is out of AVL balance";
+    }
+    if (OrderStatistics &&
+        avlNode->getSize() != 1 + subtreeSize(avlNode->getLeft()) + subtreeSize(avlNode->getRight())) {
+        return "a stored subtree size is wrong";
+    }
+    return NULL;
+}
+
+template<class Key, class Value, class Compare, bool OrderStatistics>
+void AVLTree<Key, Value, Compare, OrderStatistics>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+{
+    BinarySearchTree<Key, Value, Compare>::nodeSwap(n1, n2);
     int8_t tempB = n1->getBalance();
     n1->setBalance(n2->getBalance());
     n2->setBalance(tempB);
+    uint32_t tempS = n1->getSize();
+    n1->setSize(n2->getSize());
+    n2->setSize(tempS);
+}
+
+/**
+* Returns an iterator to the k-th smallest item (counting from 0),
+* or end() if there are not that many items.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+typename AVLTree<Key, Value, Compare, OrderStatistics>::iterator
+AVLTree<Key, Value, Compare, OrderStatistics>::select(std::size_t k) const
+{
+    static_assert(OrderStatistics, "select() needs an AVLTree with OrderStatistics enabled");
+
+    AVLNode<Key, Value>* curr = static_cast<AVLNode<Key, Value>*>(this->root_);
+    while (curr != NULL) {
+        std::size_t leftSize = subtreeSize(curr->getLeft());
+        if (k < leftSize) {
+            curr = curr->getLeft();
+        } else if (k == leftSize) {
+            break;
+        } else {
+            k -= leftSize + 1;
+            curr = curr->getRight();
+        }
+    }
+    return this->iteratorAt(curr);
+}
+
+/**
+* Returns how many keys in the tree are less than key, which is the
+* position select() would find key at if it is present.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+std::size_t AVLTree<Key, Value, Compare, OrderStatistics>::rank(const Key& key) const
+{
+    static_assert(OrderStatistics, "rank() needs an AVLTree with OrderStatistics enabled");
+
+    std::size_t less = 0;
+    AVLNode<Key, Value>* curr = static_cast<AVLNode<Key, Value>*>(this->root_);
+    while (curr != NULL) {
+        if (this->comp_(curr->getKey(), key)) {
+            less += subtreeSize(curr->getLeft()) + 1;
+            curr = curr->getRight();
+        } else {
+            curr = curr->getLeft();
+        }
+    }
+    return less;
+}
+
+/**
+* Copies the items into an immutable FrozenTree, which has the same
+* find/lower_bound/iterator surface but searches a contiguous array.
+* Later changes to this tree are not reflected in it.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+FrozenTree<Key, Value, Compare> AVLTree<Key, Value, Compare, OrderStatistics>::freeze() const
+{
+    return FrozenTree<Key, Value, Compare>(this->begin(), this->end(), this->comp_);
+}
+
+/**
+* Appends key/value and then every item of right to this tree in O(log n).
+* All keys here must be less than key, which must be less than every key
+* in right; std::invalid_argument is thrown otherwise, or if both trees
+* have items but different node pools. right is left empty.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+void AVLTree<Key, Value, Compare, OrderStatistics>::join(const Key& key, const Value& value, AVLTree& right)
+{
+    if ((this->maxNode_ != NULL && !this->comp_(this->maxNode_->getKey(), key)) ||
+        (right.minNode_ != NULL && !this->comp_(key, right.minNode_->getKey()))) {
+        throw std::invalid_argument("AVLTree::join: keys are not in order");
+    }
+
+    std::size_t count = addCounts(addCounts(this->knownCount(), right.knownCount()), 1);
+    checkOrderStatisticsSize(count);
+    int rightHeight;
+    AVLNode<Key, Value>* rightRoot = takeNodes(right, rightHeight);
+    AVLNode<Key, Value>* leftRoot = static_cast<AVLNode<Key, Value>*>(this->root_);
+    AVLNode<Key, Value>* pivot = static_cast<AVLNode<Key, Value>*>(
+        this->makeNode(NULL, key, value));
+
+    int height;
+    this->adoptSubtree(joinNodes(leftRoot, subtreeHeight(leftRoot), pivot, rightRoot, rightHeight, height), count);
+}
+
+/**
+* Appends every item of right to this tree in O(log n). All keys here
+* must be less than the keys in right, and as with the other join both
+* trees must share a node pool. right is left empty.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+void AVLTree<Key, Value, Compare, OrderStatistics>::join(AVLTree& right)
+{
+    if (&right == this) {
+        throw std::invalid_argument("AVLTree::join: cannot join a tree with itself");
+    }
+    if (this->maxNode_ != NULL && right.minNode_ != NULL &&
+        !this->comp_(this->maxNode_->getKey(), right.minNode_->getKey())) {
+        throw std::invalid_argument("AVLTree::join: keys are not in order");
+    }
+
+    std::size_t count = addCounts(this->knownCount(), right.knownCount());
+    checkOrderStatisticsSize(count);
+    int rightHeight;
+    AVLNode<Key, Value>* rightRoot = takeNodes(right, rightHeight);
+    AVLNode<Key, Value>* leftRoot = static_cast<AVLNode<Key, Value>*>(this->root_);
+
+    int height;
+    this->adoptSubtree(joinNodes(leftRoot, subtreeHeight(leftRoot), rightRoot, rightHeight, height), count);
+}
+
+/**
+* Moves every item whose key is not less than key into right (whose old
+* contents are cleared) in O(log n); this tree keeps the smaller keys.
+* right ends up sharing this tree's node pool.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+void AVLTree<Key, Value, Compare, OrderStatistics>::split(const Key& key, AVLTree& right)
+{
+    if (&right == this) {
+        throw std::invalid_argument("AVLTree::split: cannot split a tree into itself");
+    }
+    right.clear();
+    right.pool_ = this->pool_;
+
+    AVLNode<Key, Value>* root = static_cast<AVLNode<Key, Value>*>(this->root_);
+    AVLNode<Key, Value>* less;
+    AVLNode<Key, Value>* found;
+    AVLNode<Key, Value>* greater;
+    int lessHeight, greaterHeight;
+    splitNodes(root, subtreeHeight(root), key, less, lessHeight, found, greater, greaterHeight);
+    if (found != NULL) {
+        greater = joinNodes(NULL, 0, found, greater, greaterHeight, greaterHeight);
+    }
+
+    // without subtree sizes the split does not know how many items went where
+    this->adoptSubtree(less, OrderStatistics ? subtreeSize(less) : this->UNKNOWN_COUNT);
+    right.adoptSubtree(greater, OrderStatistics ? subtreeSize(greater) : this->UNKNOWN_COUNT);
+}
+
+/**
+* Adds every item of other whose key is not already here (existing
+* values win). other is left empty. Large inputs are merged in parallel.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+void AVLTree<Key, Value, Compare, OrderStatistics>::unionWith(AVLTree& other, ThreadPool& threads)
+{
+    setOperation(SET_UNION, other, threads);
+}
+
+/**
+* Keeps only the items whose keys are also in other. other is left empty.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+void AVLTree<Key, Value, Compare, OrderStatistics>::intersectWith(AVLTree& other, ThreadPool& threads)
+{
+    setOperation(SET_INTERSECTION, other, threads);
+}
+
+/**
+* Removes every item whose key is in other. other is left empty.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+void AVLTree<Key, Value, Compare, OrderStatistics>::difference(AVLTree& other, ThreadPool& threads)
+{
+    setOperation(SET_DIFFERENCE, other, threads);
+}
+
+/**
+* Detaches other's nodes as a subtree that can be linked into this tree,
+* leaving other empty. Nodes can only move between trees that share a
+* node pool (an empty tree simply switches to other's pool), so
+* std::invalid_argument is thrown for two non-empty trees with different
+* pools rather than copying every item; construct one tree with the
+* other's getPool() to join them.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, OrderStatistics>::takeNodes(AVLTree& other, int& height)
+{
+    if (other.root_ == NULL) {
+        height = 0;
+        return NULL;
+    }
+
+    if (other.pool_ != this->pool_) {
+        if (this->root_ != NULL) {
+            throw std::invalid_argument("AVLTree: only trees sharing a node pool can be combined");
+        }
+        this->pool_ = other.pool_;
+    }
+
+    AVLNode<Key, Value>* root = static_cast<AVLNode<Key, Value>*>(other.root_);
+    other.adoptSubtree(NULL, 0);
+    height = subtreeHeight(root);
+    return root;
+}
+
+/**
+* Adds two item counts, either of which may be UNKNOWN_COUNT.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+std::size_t AVLTree<Key, Value, Compare, OrderStatistics>::addCounts(std::size_t a, std::size_t b)
+{
+    if (a == AVLTree::UNKNOWN_COUNT || b == AVLTree::UNKNOWN_COUNT) {
+        return AVLTree::UNKNOWN_COUNT;
+    }
+    return a + b;
+}
+
+/**
+* Throws std::length_error if an order-statistic tree would end up with
+* count items, more than its 32-bit subtree sizes can hold. Trees without
+* order statistics have no limit.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+void AVLTree<Key, Value, Compare, OrderStatistics>::checkOrderStatisticsSize(std::size_t count)
+{
+    if (OrderStatistics && count != AVLTree::UNKNOWN_COUNT && count > MAX_ORDER_STATISTICS_SIZE) {
+        throw std::length_error("AVLTree: an order statistic tree holds at most 2^32 - 1 items");
+    }
+}
+
+/**
+* Links left, pivot and right (keys in that order) into one balanced
+* subtree and returns its root; height is set to its height.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, OrderStatistics>::joinNodes(AVLNode<Key, Value>* left,
+    int leftHeight, AVLNode<Key, Value>* pivot, AVLNode<Key, Value>* right, int rightHeight, int& height)
+{
+    if (leftHeight > rightHeight + 1 || rightHeight > leftHeight + 1) {
+        return joinSpine(left, leftHeight, pivot, right, rightHeight, height);
+    }
+
+    pivot->setParent(NULL);
+    pivot->setLeft(left);
+    if (left != NULL) {
+        left->setParent(pivot);
+    }
+    pivot->setRight(right);
+    if (right != NULL) {
+        right->setParent(pivot);
+    }
+    pivot->setBalance(rightHeight - leftHeight);
+    if (OrderStatistics) {
+        updateSize(pivot);
+    }
+
+    height = std::max(leftHeight, rightHeight) + 1;
+    return pivot;
+}
+
+/**
+* joinNodes when one side is at least two taller: walk down the inner
+* spine of the taller subtree to a subtree about as tall as the shorter
+* one, hang the pivot there, and rebalance upwards like an insert does.
+* Costs O(height difference).
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, OrderStatistics>::joinSpine(AVLNode<Key, Value>* left,
+    int leftHeight, AVLNode<Key, Value>* pivot, AVLNode<Key, Value>* right, int rightHeight, int& height)
+{
+    bool leftTaller = leftHeight > rightHeight;
+    AVLNode<Key, Value>* top = leftTaller ? left : right;
+    int shortHeight = leftTaller ? rightHeight : leftHeight;
+
+    AVLNode<Key, Value>* parent = NULL;
+    AVLNode<Key, Value>* spot = top;
+    int spotHeight = leftTaller ? leftHeight : rightHeight;
+    while (spotHeight > shortHeight + 1) {
+        parent = spot;
+        if (leftTaller) {
+            spotHeight -= spot->getBalance() < 0 ? 2 : 1;
+            spot = spot->getRight();
+        } else {
+            spotHeight -= spot->getBalance() > 0 ? 2 : 1;
+            spot = spot->getLeft();
+        }
+    }
+
+    // the pivot's subtree is exactly one taller than the one it replaces
+    int pivotHeight;
+    if (leftTaller) {
+        pivot = joinNodes(spot, spotHeight, pivot, right, rightHeight, pivotHeight);
+        parent->setRight(pivot);
+    } else {
+        pivot = joinNodes(left, leftHeight, pivot, spot, spotHeight, pivotHeight);
+        parent->setLeft(pivot);
+    }
+    pivot->setParent(parent);
+
+    // sizes first, so the rotations below see correct child sizes
+    if (OrderStatistics) {
+        adjustSizesToRoot(parent, 1 + subtreeSize(leftTaller ? right : left));
+    }
+
+    parent->updateBalance(leftTaller ? 1 : -1);
+    bool grew = growHelper(parent);
+
+    // a rotation at the top moves it one level down
+    if (top->getParent() != NULL) {
+        top = top->getParent();
+    }
+    height = (leftTaller ? leftHeight : rightHeight) + (grew ? 1 : 0);
+    return top;
+}
+
+/**
+* Links left and right (every key in left before every key in right)
+* into one balanced subtree, using the largest node of left as pivot.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, OrderStatistics>::joinNodes(AVLNode<Key, Value>* left,
+    int leftHeight, AVLNode<Key, Value>* right, int rightHeight, int& height)
+{
+    if (left == NULL) {
+        height = rightHeight;
+        return right;
+    }
+    if (right == NULL) {
+        height = leftHeight;
+        return left;
+    }
+
+    AVLNode<Key, Value>* last;
+    int restHeight;
+    AVLNode<Key, Value>* rest = splitLast(left, leftHeight, last, restHeight);
+    return joinNodes(rest, restHeight, last, right, rightHeight, height);
+}
+
+/**
+* Detaches the largest node of the subtree at node into last and returns
+* the rest of the subtree (rebalanced) with its height in restHeight.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, OrderStatistics>::splitLast(AVLNode<Key, Value>* node,
+    int height, AVLNode<Key, Value>*& last, int& restHeight)
+{
+    AVLNode<Key, Value>* left;
+    AVLNode<Key, Value>* right;
+    int leftHeight, rightHeight;
+    exposeChildren(node, height, left, leftHeight, right, rightHeight);
+
+    if (right == NULL) {
+        last = node;
+        restHeight = leftHeight;
+        return left;
+    }
+
+    int remainingHeight;
+    AVLNode<Key, Value>* remaining = splitLast(right, rightHeight, last, remainingHeight);
+    return joinNodes(left, leftHeight, node, remaining, remainingHeight, restHeight);
+}
+
+/**
+* Splits the detached subtree at node into the keys less than key (left),
+* the node holding key if there is one (found) and the greater keys (right).
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+void AVLTree<Key, Value, Compare, OrderStatistics>::splitNodes(AVLNode<Key, Value>* node, int height,
+    const Key& key, AVLNode<Key, Value>*& left, int& leftHeight, AVLNode<Key, Value>*& found,
+    AVLNode<Key, Value>*& right, int& rightHeight) const
+{
+    if (node == NULL) {
+        left = right = found = NULL;
+        leftHeight = rightHeight = 0;
+        return;
+    }
+
+    AVLNode<Key, Value>* nodeLeft;
+    AVLNode<Key, Value>* nodeRight;
+    int nodeLeftHeight, nodeRightHeight;
+    exposeChildren(node, height, nodeLeft, nodeLeftHeight, nodeRight, nodeRightHeight);
+
+    AVLNode<Key, Value>* rest;
+    int restHeight;
+    if (this->comp_(key, node->getKey())) {
+        splitNodes(nodeLeft, nodeLeftHeight, key, left, leftHeight, found, rest, restHeight);
+        right = joinNodes(rest, restHeight, node, nodeRight, nodeRightHeight, rightHeight);
+    } else if (this->comp_(node->getKey(), key)) {
+        splitNodes(nodeRight, nodeRightHeight, key, rest, restHeight, found, right, rightHeight);
+        left = joinNodes(nodeLeft, nodeLeftHeight, node, rest, restHeight, leftHeight);
+    } else {
+        left = nodeLeft;
+        leftHeight = nodeLeftHeight;
+        right = nodeRight;
+        rightHeight = nodeRightHeight;
+        found = node;
+    }
+}
+
+/**
+* The union/intersection/difference recursion: split a by the root key of
+* b, recurse on both halves (in parallel when they are big) and join the
+* results. Nodes dropped from the result go to garbage rather than back to
+* the pool, which is not thread-safe.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, OrderStatistics>::setOperationNodes(SetOperation op,
+    AVLNode<Key, Value>* a, int aHeight, AVLNode<Key, Value>* b, int bHeight, int& height,
+    std::vector<Node<Key, Value>*>& garbage, ThreadPool& threads) const
+{
+    if (a == NULL) {
+        if (op == SET_UNION) {
+            height = bHeight;
+            return b;
+        }
+        collectNodes(b, garbage);
+        height = 0;
+        return NULL;
+    }
+    if (b == NULL) {
+        if (op == SET_INTERSECTION) {
+            collectNodes(a, garbage);
+            height = 0;
+            return NULL;
+        }
+        height = aHeight;
+        return a;
+    }
+
+    AVLNode<Key, Value>* bLeft;
+    AVLNode<Key, Value>* bRight;
+    int bLeftHeight, bRightHeight;
+    exposeChildren(b, bHeight, bLeft, bLeftHeight, bRight, bRightHeight);
+
+    AVLNode<Key, Value>* aLeft;
+    AVLNode<Key, Value>* found;
+    AVLNode<Key, Value>* aRight;
+    int aLeftHeight, aRightHeight;
+    splitNodes(a, aHeight, b->getKey(), aLeft, aLeftHeight, found, aRight, aRightHeight);
+
+    AVLNode<Key, Value>* left;
+    AVLNode<Key, Value>* right;
+    int leftHeight, rightHeight;
+    if (aHeight >= PARALLEL_MIN_HEIGHT && bHeight >= PARALLEL_MIN_HEIGHT) {
+        std::vector<Node<Key, Value>*> rightGarbage;
+        threads.parallelInvoke(
+            [&]() { left = setOperationNodes(op, aLeft, aLeftHeight, bLeft, bLeftHeight, leftHeight, garbage, threads); },
+            [&]() { right = setOperationNodes(op, aRight, aRightHeight, bRight, bRightHeight, rightHeight,
+                rightGarbage, threads); });
+        garbage.insert(garbage.end(), rightGarbage.begin(), rightGarbage.end());
+    } else {
+        left = setOperationNodes(op, aLeft, aLeftHeight, bLeft, bLeftHeight, leftHeight, garbage, threads);
+        right = setOperationNodes(op, aRight, aRightHeight, bRight, bRightHeight, rightHeight, garbage, threads);
+    }
+
+    if (op == SET_UNION) {
+        // keep a's item when both have the key
+        if (found != NULL) {
+            garbage.push_back(b);
+            return joinNodes(left, leftHeight, found, right, rightHeight, height);
+        }
+        return joinNodes(left, leftHeight, b, right, rightHeight, height);
+    }
+
+    garbage.push_back(b);
+    if (op == SET_INTERSECTION && found != NULL) {
+        return joinNodes(left, leftHeight, found, right, rightHeight, height);
+    }
+    if (found != NULL) {
+        garbage.push_back(found);
+    }
+    return joinNodes(left, leftHeight, right, rightHeight, height);
+}
+
+/**
+* Runs a set operation against other's nodes and frees whatever was dropped.
+*/
+template<class Key, class Value, class Compare, bool OrderStatistics>
+void AVLTree<Key, Value, Compare, OrderStatistics>::setOperation(SetOperation op, AVLTree& other, ThreadPool& threads)
+{
+    if (&other == this) {
+        if (op == SET_DIFFERENCE) {
+            this->clear();
+        }
+        return;
+    }
+
+    std::size_t count = addCounts(this->knownCount(), other.knownCount());
+    if (op == SET_UNION) {
+        // duplicates may bring a union back under the limit, but it is not
+        // known how many there are until the nodes have been merged
+        checkOrderStatisticsSize(count);
+    }
+    int otherHeight;
+    AVLNode<Key, Value>* otherRoot = takeNodes(other, otherHeight);
+    AVLNode<Key, Value>* root = static_cast<AVLNode<Key, Value>*>(this->root_);
+
+    std::vector<Node<Key, Value>*> garbage;
+    int height;
+    root = setOperationNodes(op, root, subtreeHeight(root), otherRoot, otherHeight, height, garbage, threads);
+
+    for (std::size_t i = 0; i < garbage.size(); ++i) {
+        this->destroyNode(garbage[i]);
+    }
+    this->adoptSubtree(root, count == this->UNKNOWN_COUNT ? count : count - garbage.size());
 }
 
 
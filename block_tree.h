@@ -0,0 +1,919 @@
+#ifndef BLOCK_TREE_H
+#define BLOCK_TREE_H
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "frozen_tree.h"
+#include "simd_search.h"
+
+/**
+* An ordered map for arithmetic keys that compares a whole cache line of
+* keys per level instead of one: a B+ tree whose nodes hold up to WIDTH
+* keys (see BlockSearch), searched with SIMD compares where the target
+* has them and a scalar loop otherwise. Items live in the leaves, which
+* are linked in key order for the iterator; inner nodes hold separator
+* keys and children only. Every node but the root stays at least half
+* full and all leaves are at the same depth, so with 64-bit keys a
+* million items are five levels deep.
+*
+* Keys are ordered by std::less, with the semantics of BinarySearchTree
+* and AVLTree: insert() overwrites the value of an existing key, removing
+* a missing key does nothing and iterators visit the items in key order.
+* Unused key slots hold the largest key value (or infinity), so NaN keys
+* are not supported. Both insert() and remove() invalidate iterators.
+*/
+template <class Key, class Value>
+class BlockTree
+{
+    static_assert(std::is_arithmetic<Key>::value, "BlockTree needs an arithmetic key type");
+
+protected:
+    struct Leaf;
+
+public:
+    class iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type* pointer;
+        typedef value_type& reference;
+
+        iterator();
+
+        std::pair<const Key, Value>& operator*() const;
+        std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class BlockTree<Key, Value>;
+        iterator(Leaf* leaf, std::size_t slot);
+
+        Leaf* leaf_;
+        std::size_t slot_;
+    };
+
+    BlockTree();
+    ~BlockTree();
+    // the tree owns its nodes, so it cannot be copied
+    BlockTree(const BlockTree&) = delete;
+    BlockTree& operator=(const BlockTree&) = delete;
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    iterator begin() const;
+    iterator end() const;
+    std::size_t size() const;
+    bool empty() const;
+    bool isBalanced() const;
+
+protected:
+    typedef std::pair<const Key, Value> Item;
+    typedef BlockSearch<Key, std::less<Key> > Search;
+    static const std::size_t WIDTH = Search::WIDTH;
+
+    // the keys come first so that they fill the node's first cache line
+    struct Block
+    {
+        Key keys[WIDTH];
+        std::size_t count;
+    };
+
+    struct Leaf : Block
+    {
+        Leaf* next;
+        typename std::aligned_storage<sizeof(Item), std::alignment_of<Item>::value>::type items[WIDTH];
+
+        Item& item(std::size_t slot) { return *reinterpret_cast<Item*>(&items[slot]); }
+    };
+
+    struct Inner : Block
+    {
+        Block* children[WIDTH + 1];
+    };
+
+    static Key padKey();
+    static std::size_t slotOf(const Block* block, const Key& key, bool strict);
+    static std::size_t minCount(int level);
+    Leaf* leafFor(const Key& key) const;
+    iterator seek(const Key& key, bool strict) const;
+
+    Leaf* newLeaf();
+    Inner* newInner();
+    void freeLeaf(Leaf* leaf);
+    void freeInner(Inner* inner);
+
+    static void moveItem(Leaf* from, std::size_t fromSlot, Leaf* to, std::size_t toSlot);
+    static void insertItem(Leaf* leaf, std::size_t slot, Item&& item);
+    static void eraseItem(Leaf* leaf, std::size_t slot);
+    static void insertChild(Inner* inner, std::size_t slot, const Key& separator, Block* child);
+    static void eraseChild(Inner* inner, std::size_t slot);
+
+    Block* insertBelow(Block* node, int level, const Item& item, Key& separator);
+    Leaf* splitLeaf(Leaf* leaf, std::size_t slot, Item&& item, Key& separator);
+    Inner* splitInner(Inner* inner, std::size_t slot, const Key& childSeparator, Block* child, Key& separator);
+    bool removeBelow(Block* node, int level, const Key& key);
+    void refillLeaf(Inner* parent, std::size_t slot);
+    void refillInner(Inner* parent, std::size_t slot);
+    void destroyBelow(Block* node, int level);
+    bool checkBelow(const Block* node, int level, const Key* low, const Key* high, std::size_t& items) const;
+
+    Block* root_;
+    // levels including the leaves; 0 when empty
+    int height_;
+    std::size_t size_;
+};
+
+/*
+  ----------------------------------------------
+  Begin implementations for the BlockTree class.
+  ----------------------------------------------
+*/
+
+/**
+* Default constructor for an end() iterator.
+*/
+template<class Key, class Value>
+BlockTree<Key, Value>::iterator::iterator() :
+    leaf_(NULL),
+    slot_(0)
+{
+
+}
+
+/**
+* Constructor for the item in slot of leaf.
+*/
+template<class Key, class Value>
+BlockTree<Key, Value>::iterator::iterator(Leaf* leaf, std::size_t slot) :
+    leaf_(leaf),
+    slot_(slot)
+{
+
+}
+
+/**
+* Provides access to the item.
+*/
+template<class Key, class Value>
+std::pair<const Key, Value>& BlockTree<Key, Value>::iterator::operator*() const
+{
+    return leaf_->item(slot_);
+}
+
+/**
+* Provides access to the address of the item.
+*/
+template<class Key, class Value>
+std::pair<const Key, Value>* BlockTree<Key, Value>::iterator::operator->() const
+{
+    return &(leaf_->item(slot_));
+}
+
+/**
+* Checks if 'this' iterator's internals have the same value as 'rhs'
+*/
+template<class Key, class Value>
+bool BlockTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return leaf_ == rhs.leaf_ && slot_ == rhs.slot_;
+}
+
+/**
+* Checks if 'this' iterator's internals have a different value as 'rhs'
+*/
+template<class Key, class Value>
+bool BlockTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Advances the iterator to the next item in order, moving on to the next
+* leaf after the last slot.
+*/
+template<class Key, class Value>
+typename BlockTree<Key, Value>::iterator& BlockTree<Key, Value>::iterator::operator++()
+{
+    if (++slot_ == leaf_->count) {
+        leaf_ = leaf_->next;
+        slot_ = 0;
+    }
+    return *this;
+}
+
+/**
+* Default constructor
+*/
+template<class Key, class Value>
+BlockTree<Key, Value>::BlockTree() :
+    root_(NULL),
+    height_(0),
+    size_(0)
+{
+
+}
+
+/**
+* Destructor, which frees every node.
+*/
+template<class Key, class Value>
+BlockTree<Key, Value>::~BlockTree()
+{
+    clear();
+}
+
+/**
+* Inserts key/value, overwriting the value if the key exists.
+*/
+template<class Key, class Value>
+void BlockTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    if (root_ == NULL) {
+        Leaf* leaf = newLeaf();
+        try {
+            insertItem(leaf, 0, Item(keyValuePair));
+        } catch (...) {
+            freeLeaf(leaf);
+            throw;
+        }
+        root_ = leaf;
+        height_ = 1;
+        size_ = 1;
+        return;
+    }
+
+    Key separator;
+    Block* split = insertBelow(root_, height_, keyValuePair, separator);
+    if (split != NULL) {
+        Inner* top = newInner();
+        top->keys[0] = separator;
+        top->children[0] = root_;
+        top->children[1] = split;
+        top->count = 1;
+        root_ = top;
+        ++height_;
+    }
+}
+
+/**
+* Removes the item with key, if any. Nodes that drop below half full
+* borrow from or merge with a sibling.
+*/
+template<class Key, class Value>
+void BlockTree<Key, Value>::remove(const Key& key)
+{
+    if (root_ == NULL || !removeBelow(root_, height_, key)) {
+        return;
+    }
+    if (root_->count == 0) {
+        if (height_ == 1) {
+            freeLeaf(static_cast<Leaf*>(root_));
+            root_ = NULL;
+        } else {
+            Inner* old = static_cast<Inner*>(root_);
+            root_ = old->children[0];
+            freeInner(old);
+        }
+        --height_;
+    }
+}
+
+/**
+* Deletes every item.
+*/
+template<class Key, class Value>
+void BlockTree<Key, Value>::clear()
+{
+    if (root_ != NULL) {
+        destroyBelow(root_, height_);
+    }
+    root_ = NULL;
+    height_ = 0;
+    size_ = 0;
+}
+
+/**
+* Returns an iterator to the item with key, or end().
+*/
+template<class Key, class Value>
+typename BlockTree<Key, Value>::iterator BlockTree<Key, Value>::find(const Key& key) const
+{
+    if (root_ == NULL) {
+        return end();
+    }
+    Leaf* leaf = leafFor(key);
+    std::size_t slot = slotOf(leaf, key, false);
+    if (slot == leaf->count || key < leaf->keys[slot]) {
+        return end();
+    }
+    return iterator(leaf, slot);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key.
+*/
+template<class Key, class Value>
+typename BlockTree<Key, Value>::iterator BlockTree<Key, Value>::lower_bound(const Key& key) const
+{
+    return seek(key, false);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key.
+*/
+template<class Key, class Value>
+typename BlockTree<Key, Value>::iterator BlockTree<Key, Value>::upper_bound(const Key& key) const
+{
+    return seek(key, true);
+}
+
+/**
+* Returns an iterator to the smallest item.
+*/
+template<class Key, class Value>
+typename BlockTree<Key, Value>::iterator BlockTree<Key, Value>::begin() const
+{
+    if (root_ == NULL) {
+        return end();
+    }
+    Block* node = root_;
+    for (int level = height_; level > 1; --level) {
+        node = static_cast<Inner*>(node)->children[0];
+    }
+    return iterator(static_cast<Leaf*>(node), 0);
+}
+
+/**
+* Returns the end iterator.
+*/
+template<class Key, class Value>
+typename BlockTree<Key, Value>::iterator BlockTree<Key, Value>::end() const
+{
+    return iterator();
+}
+
+/**
+* Returns the number of items.
+*/
+template<class Key, class Value>
+std::size_t BlockTree<Key, Value>::size() const
+{
+    return size_;
+}
+
+/**
+* Returns true if there are no items.
+*/
+template<class Key, class Value>
+bool BlockTree<Key, Value>::empty() const
+{
+    return size_ == 0;
+}
+
+/**
+* Return true iff all leaves are at the same depth, every node but the
+* root is at least half full, the keys are in order and within their
+* separators, unused slots are padded and the leaf chain holds size()
+* items.
+*/
+template<class Key, class Value>
+bool BlockTree<Key, Value>::isBalanced() const
+{
+    if (root_ == NULL) {
+        return height_ == 0 && size_ == 0;
+    }
+    std::size_t items = 0;
+    if (!checkBelow(root_, height_, NULL, NULL, items) || items != size_) {
+        return false;
+    }
+    std::size_t chained = 0;
+    for (iterator it = begin(); it != end(); ++it) {
+        ++chained;
+    }
+    return chained == size_;
+}
+
+/**
+* The key that fills unused slots: it never sorts before a real key, so
+* only the clamp in slotOf() has to account for it.
+*/
+template<class Key, class Value>
+Key BlockTree<Key, Value>::padKey()
+{
+    return std::numeric_limits<Key>::has_infinity ?
+        std::numeric_limits<Key>::infinity() : std::numeric_limits<Key>::max();
+}
+
+/**
+* Returns how many of block's keys are less than key (not greater than
+* key if strict). For an inner node with strict set this is the index of
+* the child to descend into.
+*/
+template<class Key, class Value>
+std::size_t BlockTree<Key, Value>::slotOf(const Block* block, const Key& key, bool strict)
+{
+    std::size_t before = Search::countBefore(block->keys, key, strict, std::less<Key>());
+    return before < block->count ? before : block->count;
+}
+
+/**
+* The fewest keys a node other than the root may hold at level (1 being
+* the leaves); splits never leave less.
+*/
+template<class Key, class Value>
+std::size_t BlockTree<Key, Value>::minCount(int level)
+{
+    return level == 1 ? WIDTH / 2 : (WIDTH - 1) / 2;
+}
+
+/**
+* Descends to the leaf that holds key if it is in a non-empty tree. Each
+* separator is no greater than every key to its right, so keys equal to
+* it go right.
+*/
+template<class Key, class Value>
+typename BlockTree<Key, Value>::Leaf* BlockTree<Key, Value>::leafFor(const Key& key) const
+{
+    Block* node = root_;
+    for (int level = height_; level > 1; --level) {
+        Inner* inner = static_cast<Inner*>(node);
+        node = inner->children[slotOf(inner, key, true)];
+    }
+    return static_cast<Leaf*>(node);
+}
+
+/**
+* Returns the first item whose key is not less than key (greater than
+* key if strict), which is in the leaf for key or starts the next one.
+*/
+template<class Key, class Value>
+typename BlockTree<Key, Value>::iterator BlockTree<Key, Value>::seek(const Key& key, bool strict) const
+{
+    if (root_ == NULL) {
+        return end();
+    }
+    Leaf* leaf = leafFor(key);
+    std::size_t slot = slotOf(leaf, key, strict);
+    if (slot == leaf->count) {
+        return iterator(leaf->next, 0);
+    }
+    return iterator(leaf, slot);
+}
+
+/**
+* Allocates an empty leaf on a cache line boundary, so that its keys can
+* be loaded with aligned SIMD loads.
+*/
+template<class Key, class Value>
+typename BlockTree<Key, Value>::Leaf* BlockTree<Key, Value>::newLeaf()
+{
+    Leaf* leaf = new (CacheAlignedAllocator<Leaf>().allocate(1)) Leaf;
+    for (std::size_t i = 0; i < WIDTH; ++i) {
+        leaf->keys[i] = padKey();
+    }
+    leaf->count = 0;
+    leaf->next = NULL;
+    return leaf;
+}
+
+/**
+* Allocates an empty inner node on a cache line boundary.
+*/
+template<class Key, class Value>
+typename BlockTree<Key, Value>::Inner* BlockTree<Key, Value>::newInner()
+{
+    Inner* inner = new (CacheAlignedAllocator<Inner>().allocate(1)) Inner;
+    for (std::size_t i = 0; i < WIDTH; ++i) {
+        inner->keys[i] = padKey();
+    }
+    inner->count = 0;
+    return inner;
+}
+
+/**
+* Frees a leaf whose items have already been destroyed or moved out.
+*/
+template<class Key, class Value>
+void BlockTree<Key, Value>::freeLeaf(Leaf* leaf)
+{
+    CacheAlignedAllocator<Leaf>().deallocate(leaf, 1);
+}
+
+/**
+* Frees an inner node; its children are left alone.
+*/
+template<class Key, class Value>
+void BlockTree<Key, Value>::freeInner(Inner* inner)
+{
+    CacheAlignedAllocator<Inner>().deallocate(inner, 1);
+}
+
+/**
+* Moves the item in fromSlot into the empty toSlot (possibly of the same
+* leaf) and pads the slot it left. Counts are left to the caller.
+*/
+template<class Key, class Value>
+void BlockTree<Key, Value>::moveItem(Leaf* from, std::size_t fromSlot, Leaf* to, std::size_t toSlot)
+{
+    new (&to->items[toSlot]) Item(std::move(from->item(fromSlot)));
+    from->item(fromSlot).~Item();
+    to->keys[toSlot] = from->keys[fromSlot];
+    from->keys[fromSlot] = padKey();
+}
+
+/**
+* Shifts the items from slot on up by one and moves item into slot. The
+* leaf must have room.
+*/
+template<class Key, class Value>
+void BlockTree<Key, Value>::insertItem(Leaf* leaf, std::size_t slot, Item&& item)
+{
+    for (std::size_t i = leaf->count; i > slot; --i) {
+        moveItem(leaf, i - 1, leaf, i);
+    }
+    new (&leaf->items[slot]) Item(std::move(item));
+    leaf->keys[slot] = leaf->item(slot).first;
+    ++leaf->count;
+}
+
+/**
+* Destroys the item in slot and shifts the ones after it down.
+*/
+template<class Key, class Value>
+void BlockTree<Key, Value>::eraseItem(Leaf* leaf, std::size_t slot)
+{
+    leaf->item(slot).~Item();
+    for (std::size_t i = slot + 1; i < leaf->count; ++i) {
+        moveItem(leaf, i, leaf, i - 1);
+    }
+    --leaf->count;
+    leaf->keys[leaf->count] = padKey();
+}
+
+/**
+* Puts separator in key slot and child to its right. The node must have
+* room.
+*/
+template<class Key, class Value>
+void BlockTree<Key, Value>::insertChild(Inner* inner, std::size_t slot, const Key& separator, Block* child)
+{
+    for (std::size_t i = inner->count; i > slot; --i) {
+        inner->keys[i] = inner->keys[i - 1];
+        inner->children[i + 1] = inner->children[i];
+    }
+    inner->keys[slot] = separator;
+    inner->children[slot + 1] = child;
+    ++inner->count;
+}
+
+/**
+* Removes the key in slot and the child to its right.
+*/
+template<class Key, class Value>
+void BlockTree<Key, Value>::eraseChild(Inner* inner, std::size_t slot)
+{
+    for (std::size_t i = slot + 1; i < inner->count; ++i) {
+        inner->keys[i - 1] = inner->keys[i];
+        inner->children[i] = inner->children[i + 1];
+    }
+    --inner->count;
+    inner->keys[inner->count] = padKey();
+}
+
+/**
+* Inserts item below node, which is at level (1 being the leaves). If
+* node had to split, returns the new right sibling and sets separator to
+* its smallest key; returns NULL otherwise.
+*/
+template<class Key, class Value>
+typename BlockTree<Key, Value>::Block* BlockTree<Key, Value>::insertBelow(Block* node, int level,
+    const Item& item, Key& separator)
+{
+    if (level == 1) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        std::size_t slot = slotOf(leaf, item.first, false);
+        if (slot < leaf->count && !(item.first < leaf->keys[slot])) {
+            leaf->item(slot).second = item.second;
+            return NULL;
+        }
+        // copied first, so that a throwing copy leaves the tree as it was
+        Item staged(item);
+        Leaf* split = NULL;
+        if (leaf->count < WIDTH) {
+            insertItem(leaf, slot, std::move(staged));
+        } else {
+            split = splitLeaf(leaf, slot, std::move(staged), separator);
+        }
+        ++size_;
+        return split;
+    }
+
+    Inner* inner = static_cast<Inner*>(node);
+    std::size_t slot = slotOf(inner, item.first, true);
+    Key childSeparator;
+    Block* child = insertBelow(inner->children[slot], level - 1, item, childSeparator);
+    if (child == NULL) {
+        return NULL;
+    }
+    if (inner->count < WIDTH) {
+        insertChild(inner, slot, childSeparator, child);
+        return NULL;
+    }
+    return splitInner(inner, slot, childSeparator, child, separator);
+}
+
+/**
+* Splits a full leaf so that both halves end up at least half full with
+* item in its place, links the new right half after it and returns it.
+*/
+template<class Key, class Value>
+typename BlockTree<Key, Value>::Leaf* BlockTree<Key, Value>::splitLeaf(Leaf* leaf, std::size_t slot,
+    Item&& item, Key& separator)
+{
+    Leaf* right = newLeaf();
+    // the left half keeps this many of the WIDTH + 1 items
+    std::size_t half = (WIDTH + 1) / 2;
+    std::size_t first = slot < half ? half - 1 : half;
+    for (std::size_t i = first; i < WIDTH; ++i) {
+        moveItem(leaf, i, right, i - first);
+    }
+    right->count = WIDTH - first;
+    leaf->count = first;
+    if (slot < half) {
+        insertItem(leaf, slot, std::move(item));
+    } else {
+        insertItem(right, slot - half, std::move(item));
+    }
+
+    right->next = leaf->next;
+    leaf->next = right;
+    separator = right->keys[0];
+    return right;
+}
+
+/**
+* Splits a full inner node that has to take childSeparator and child at
+* slot: the middle key moves up as separator and the keys and children
+* after it go to the new right sibling, which is returned.
+*/
+template<class Key, class Value>
+typename BlockTree<Key, Value>::Inner* BlockTree<Key, Value>::splitInner(Inner* inner, std::size_t slot,
+    const Key& childSeparator, Block* child, Key& separator)
+{
+    Inner* right = newInner();
+
+    Key keys[WIDTH + 1];
+    Block* children[WIDTH + 2];
+    children[0] = inner->children[0];
+    for (std::size_t i = 0, from = 0; i <= WIDTH; ++i) {
+        if (i == slot) {
+            keys[i] = childSeparator;
+            children[i + 1] = child;
+        } else {
+            keys[i] = inner->keys[from];
+            children[i + 1] = inner->children[from + 1];
+            ++from;
+        }
+    }
+
+    std::size_t half = (WIDTH + 1) / 2;
+    for (std::size_t i = 0; i < WIDTH; ++i) {
+        inner->keys[i] = i < half ? keys[i] : padKey();
+    }
+    for (std::size_t i = 0; i <= half; ++i) {
+        inner->children[i] = children[i];
+    }
+    inner->count = half;
+
+    for (std::size_t i = half + 1; i <= WIDTH; ++i) {
+        right->keys[i - half - 1] = keys[i];
+    }
+    for (std::size_t i = half + 1; i <= WIDTH + 1; ++i) {
+        right->children[i - half - 1] = children[i];
+    }
+    right->count = WIDTH - half;
+    separator = keys[half];
+    return right;
+}
+
+/**
+* Removes key from below node, which is at level, and refills any child
+* that drops below minCount(). Returns false if key was not there.
+*/
+template<class Key, class Value>
+bool BlockTree<Key, Value>::removeBelow(Block* node, int level, const Key& key)
+{
+    if (level == 1) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        std::size_t slot = slotOf(leaf, key, false);
+        if (slot == leaf->count || key < leaf->keys[slot]) {
+            return false;
+        }
+        eraseItem(leaf, slot);
+        --size_;
+        return true;
+    }
+
+    Inner* inner = static_cast<Inner*>(node);
+    std::size_t slot = slotOf(inner, key, true);
+    if (!removeBelow(inner->children[slot], level - 1, key)) {
+        return false;
+    }
+    if (inner->children[slot]->count < minCount(level - 1)) {
+        if (level == 2) {
+            refillLeaf(inner, slot);
+        } else {
+            refillInner(inner, slot);
+        }
+    }
+    return true;
+}
+
+/**
+* Refills the leaf at parent's child slot from a neighbour: the two merge
+* if they fit in one leaf, otherwise the fuller one hands over an item.
+*/
+template<class Key, class Value>
+void BlockTree<Key, Value>::refillLeaf(Inner* parent, std::size_t slot)
+{
+    std::size_t pair = slot > 0 ? slot - 1 : slot;
+    Leaf* left = static_cast<Leaf*>(parent->children[pair]);
+    Leaf* right = static_cast<Leaf*>(parent->children[pair + 1]);
+
+    if (left->count + right->count <= WIDTH) {
+        for (std::size_t i = 0; i < right->count; ++i) {
+            moveItem(right, i, left, left->count + i);
+        }
+        left->count += right->count;
+        left->next = right->next;
+        freeLeaf(right);
+        eraseChild(parent, pair);
+        return;
+    }
+
+    if (left->count < right->count) {
+        moveItem(right, 0, left, left->count);
+        ++left->count;
+        for (std::size_t i = 1; i < right->count; ++i) {
+            moveItem(right, i, right, i - 1);
+        }
+        --right->count;
+    } else {
+        for (std::size_t i = right->count; i > 0; --i) {
+            moveItem(right, i - 1, right, i);
+        }
+        moveItem(left, left->count - 1, right, 0);
+        --left->count;
+        ++right->count;
+    }
+    parent->keys[pair] = right->keys[0];
+}
+
+/**
+* Refills the inner node at parent's child slot the same way; the
+* separator between the two comes down from parent into the merged node,
+* or rotates through parent when a child changes sides.
+*/
+template<class Key, class Value>
+void BlockTree<Key, Value>::refillInner(Inner* parent, std::size_t slot)
+{
+    std::size_t pair = slot > 0 ? slot - 1 : slot;
+    Inner* left = static_cast<Inner*>(parent->children[pair]);
+    Inner* right = static_cast<Inner*>(parent->children[pair + 1]);
+
+    if (left->count + right->count + 1 <= WIDTH) {
+        left->keys[left->count] = parent->keys[pair];
+        for (std::size_t i = 0; i < right->count; ++i) {
+            left->keys[left->count + 1 + i] = right->keys[i];
+        }
+        for (std::size_t i = 0; i <= right->count; ++i) {
+            left->children[left->count + 1 + i] = right->children[i];
+        }
+        left->count += right->count + 1;
+        freeInner(right);
+        eraseChild(parent, pair);
+        return;
+    }
+
+    if (left->count < right->count) {
+        left->keys[left->count] = parent->keys[pair];
+        left->children[left->count + 1] = right->children[0];
+        ++left->count;
+        parent->keys[pair] = right->keys[0];
+        for (std::size_t i = 1; i < right->count; ++i) {
+            right->keys[i - 1] = right->keys[i];
+        }
+        for (std::size_t i = 1; i <= right->count; ++i) {
+            right->children[i - 1] = right->children[i];
+        }
+        --right->count;
+        right->keys[right->count] = padKey();
+    } else {
+        for (std::size_t i = right->count; i > 0; --i) {
+            right->keys[i] = right->keys[i - 1];
+        }
+        for (std::size_t i = right->count + 1; i > 0; --i) {
+            right->children[i] = right->children[i - 1];
+        }
+        right->keys[0] = parent->keys[pair];
+        right->children[0] = left->children[left->count];
+        ++right->count;
+        --left->count;
+        parent->keys[pair] = left->keys[left->count];
+        left->keys[left->count] = padKey();
+    }
+}
+
+/**
+* Destroys every item below node and frees the nodes. The recursion is
+* only as deep as the tree, which stays shallow.
+*/
+template<class Key, class Value>
+void BlockTree<Key, Value>::destroyBelow(Block* node, int level)
+{
+    if (level == 1) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        for (std::size_t i = 0; i < leaf->count; ++i) {
+            leaf->item(i).~Item();
+        }
+        freeLeaf(leaf);
+        return;
+    }
+    Inner* inner = static_cast<Inner*>(node);
+    for (std::size_t i = 0; i <= inner->count; ++i) {
+        destroyBelow(inner->children[i], level - 1);
+    }
+    freeInner(inner);
+}
+
+/**
+* The isBalanced() check for the subtree at node, whose keys must be at
+* least *low and less than *high (either may be NULL for no bound).
+* Adds the items found to items.
+*/
+template<class Key, class Value>
+bool BlockTree<Key, Value>::checkBelow(const Block* node, int level, const Key* low, const Key* high,
+    std::size_t& items) const
+{
+    if (node->count > WIDTH || (node != root_ && node->count < minCount(level)) ||
+        (level > 1 && node->count == 0)) {
+        return false;
+    }
+    for (std::size_t i = 0; i < WIDTH; ++i) {
+        if (i >= node->count) {
+            if (node->keys[i] != padKey()) {
+                return false;
+            }
+            continue;
+        }
+        if ((i > 0 && !(node->keys[i - 1] < node->keys[i])) || (low != NULL && node->keys[i] < *low) ||
+            (high != NULL && !(node->keys[i] < *high))) {
+            return false;
+        }
+    }
+
+    if (level == 1) {
+        Leaf* leaf = static_cast<Leaf*>(const_cast<Block*>(node));
+        for (std::size_t i = 0; i < leaf->count; ++i) {
+            if (leaf->item(i).first != leaf->keys[i]) {
+                return false;
+            }
+        }
+        items += leaf->count;
+        return true;
+    }
+
+    const Inner* inner = static_cast<const Inner*>(node);
+    for (std::size_t i = 0; i <= inner->count; ++i) {
+        const Key* childLow = i == 0 ? low : &inner->keys[i - 1];
+        const Key* childHigh = i == inner->count ? high : &inner->keys[i];
+        if (!checkBelow(inner->children[i], level - 1, childLow, childHigh, items)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+  --------------------------------------------
+  End implementations for the BlockTree class.
+  --------------------------------------------
+*/
+
+#endif
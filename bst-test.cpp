@@ -1,7 +1,15 @@
 #include <iostream>
+#include <cstdio>
 #include <map>
+#include <sstream>
 #include "bst.h"
 #include "avlbst.h"
+#include "concurrent_avlbst.h"
+#include "persistent_avlbst.h"
+#include "compact_avlbst.h"
+#include "rbbst.h"
+#include "splaybst.h"
+#include "mapped_tree.h"
 
 using namespace std;
 
@@ -44,5 +52,193 @@ int main(int argc, char *argv[])
     cout << "Erasing b" << endl;
     at.remove('b');
 
+    // Move-aware insertion reports whether the key was new
+    std::pair<AVLTree<char,int>::iterator, bool> result = at.try_emplace('z', 26);
+    cout << "\ntry_emplace z inserted: " << result.second << endl;
+    result = at.insert_or_assign('z', 27);
+    cout << "insert_or_assign z inserted: " << result.second << ", value " << result.first->second << endl;
+
+    // Custom ordering through the Compare parameter
+    AVLTree<char,int,std::greater<char> > descending;
+    descending.insert(std::make_pair('a',1));
+    descending.insert(std::make_pair('c',3));
+    descending.insert(std::make_pair('b',2));
+    cout << "\nDescending AVLTree contents:";
+    for(AVLTree<char,int,std::greater<char> >::iterator it = descending.begin(); it != descending.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
+
+    // Range scans
+    cout << "\nKeys in [a, c):";
+    AVLTree<char,int> letters;
+    for(char c = 'a'; c <= 'e'; ++c) letters.insert(std::make_pair(c, c - 'a'));
+    letters.forEachInRange('a', 'c', [](std::pair<const char,int>& item) { cout << " " << item.first; });
+    cout << endl << "lower_bound('c'): " << letters.lower_bound('c')->first
+         << ", upper_bound('c'): " << letters.upper_bound('c')->first << endl;
+
+    // Batched lookups
+    std::vector<char> wanted;
+    wanted.push_back('e');
+    wanted.push_back('x');
+    wanted.push_back('a');
+    std::vector<AVLTree<char,int>::iterator> hits;
+    letters.findBatch(wanted, hits);
+    cout << "findBatch(e, x, a):";
+    for(size_t i = 0; i < hits.size(); ++i) {
+        cout << " " << (hits[i] == letters.end() ? "-" : std::to_string(hits[i]->second));
+    }
+    cout << endl;
+
+    // Hinted insert in front of the smallest key
+    letters.insert(letters.begin(), std::make_pair('A', -1));
+    cout << "After hinted insert, first key: " << letters.begin()->first << endl;
+    letters.remove('A');
+
+    // Reverse iteration
+    cout << "\nLast two keys:";
+    AVLTree<char,int>::reverse_iterator rit = letters.rbegin();
+    cout << " " << rit->first;
+    ++rit;
+    cout << " " << rit->first << endl;
+
+    // Frozen read-only copy
+    FrozenTree<char,int> frozen = letters.freeze();
+    cout << "\nFrozen copy has " << frozen.size() << " keys, find('b'): " << frozen.find('b')->second
+         << ", lower_bound('z') is end: " << (frozen.lower_bound('z') == frozen.end() ? "yes" : "no") << endl;
+
+#ifdef BST_INSTRUMENT
+    cout << "Counters so far: ";
+    TreeStats::total().writeJson(cout);
+    cout << endl;
+#endif
+
+    // Memory-mapped image of the frozen copy
+    MappedTree<char,int>::write(frozen, "bst-test.img");
+    {
+        MappedTree<char,int> mapped("bst-test.img");
+        cout << "Mapped image has " << mapped.size() << " keys, find('b'): " << mapped.find('b')->second
+             << ", first key: " << mapped.begin()->first << endl;
+    }
+    remove("bst-test.img");
+
+    // Binary round trip
+    std::stringstream stream;
+    letters.serialize(stream);
+    AVLTree<char,int> copied;
+    copied.deserialize(stream);
+    cout << "Deserialized " << copied.size() << " keys, balanced: " << (copied.isBalanced() ? "yes" : "no")
+         << ", find('b'): " << copied.find('b')->second << endl;
+
+    // Order statistics
+    AVLTree<char,int,std::less<char>,true> ranked;
+    for(char c = 'a'; c <= 'e'; ++c) ranked.insert(std::make_pair(c, c - 'a'));
+    cout << "\nMedian of " << ranked.size() << " keys: " << ranked.select(ranked.size() / 2)->first
+         << ", rank of d: " << ranked.rank('d') << endl;
+
+    // Split and join
+    AVLTree<char,int> upper;
+    letters.split('c', upper);
+    cout << "\nAfter split at c: " << letters.size() << " below, " << upper.size() << " from c up" << endl;
+    letters.join(upper);
+    cout << "Joined back: " << letters.size() << " keys, "
+         << (letters.isBalanced() ? "balanced" : "NOT balanced") << endl;
+
+    // Validation and shape statistics
+    TreeShape shape = letters.validate();
+    cout << "Validate: " << (shape.valid() ? "ok" : shape.problem) << ", height " << shape.height
+         << ", average depth " << shape.averageDepth << ", leaves by depth:";
+    for(size_t d = 0; d < shape.leafDepths.size(); ++d) cout << " " << shape.leafDepths[d];
+    cout << endl;
+
+    // Set operations
+    AVLTree<char,int> evens(letters.getPool());
+    for(char c = 'a'; c <= 'e'; c += 2) evens.insert(std::make_pair(c, 0));
+    letters.difference(evens);
+    cout << "Letters minus a, c, e:";
+    for(AVLTree<char,int>::iterator it = letters.begin(); it != letters.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
+
+    // Lock-free reads on a concurrent tree
+    ConcurrentAVLTree<char,int> shared;
+    for(char c = 'a'; c <= 'e'; ++c) shared.insert(std::make_pair(c, c - 'a'));
+    shared.remove('b');
+    int sharedValue = -1;
+    cout << "\nConcurrent tree has d: " << (shared.find('d', sharedValue) ? "yes" : "no")
+         << " (" << sharedValue << "), contents:";
+    for(ConcurrentAVLTree<char,int>::iterator it = shared.begin(); it != shared.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
+
+    // Persistent tree snapshots
+    PersistentAVLTree<char,int> versioned;
+    versioned.insert(std::make_pair('a', 1));
+    versioned.insert(std::make_pair('b', 2));
+    PersistentAVLTree<char,int> before = versioned.snapshot();
+    versioned.remove('a');
+    versioned.insert(std::make_pair('c', 3));
+    cout << "\nSnapshot:";
+    for(PersistentAVLTree<char,int>::iterator it = before.begin(); it != before.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << ", current:";
+    for(PersistentAVLTree<char,int>::iterator it = versioned.begin(); it != versioned.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
+
+    // Red-black tree
+    RBTree<char,int> redBlack;
+    for(char c = 'a'; c <= 'g'; ++c) redBlack.insert(std::make_pair(c, c - 'a'));
+    redBlack.remove('d');
+    cout << "\nRBTree:";
+    for(RBTree<char,int>::iterator it = redBlack.begin(); it != redBlack.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << ", " << (redBlack.isRedBlack() ? "valid" : "NOT valid") << endl;
+
+    // Splay tree: lookups bring keys to the root
+    SplayTree<char,int> splayed;
+    for(char c = 'a'; c <= 'e'; ++c) splayed.insert(std::make_pair(c, c - 'a'));
+    splayed.find('b');
+    splayed.remove('c');
+    cout << "\nSplayTree:";
+    for(SplayTree<char,int>::iterator it = splayed.begin(); it != splayed.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
+
+    // Index-linked compact tree
+    CompactAVLTree<char,int> compact;
+    for(char c = 'a'; c <= 'e'; ++c) compact.insert(std::make_pair(c, c - 'a'));
+    compact.remove('a');
+    cout << "\nCompact tree:";
+    for(CompactAVLTree<char,int>::iterator it = compact.begin(); it != compact.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << ", " << (compact.isBalanced() ? "balanced" : "NOT balanced") << endl;
+
+    // Bulk load from sorted input
+    std::map<char,int> sortedItems;
+    for(char c = 'a'; c <= 'g'; ++c) sortedItems[c] = c - 'a';
+    AVLTree<char,int> bulk;
+    bulk.buildFromSorted(sortedItems.begin(), sortedItems.end());
+    cout << "\nBulk loaded AVLTree is " << (bulk.isBalanced() ? "balanced" : "NOT balanced") << endl;
+
+    // Trees sharing one node pool
+    AVLTree<char,int> pooled(at.getPool());
+    pooled.insert(std::make_pair('c',3));
+    cout << "\nShared pool blocks in use: " << at.getPool()->blocksInUse() << endl;
+    pooled.clear();
+
+    // Clearing a tree that is one long path
+    BinarySearchTree<int,std::string> path;
+    for(int i = 0; i < 200000; ++i) path.insert(std::make_pair(i, std::string("node")));
+    path.clear();
+    cout << "Cleared a path of 200000 nodes: " << (path.empty() ? "empty" : "NOT empty") << endl;
+
     return 0;
 }
@@ -5,20 +5,92 @@
 #include <exception>
 #include <cstdlib>
 #include <utility>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <vector>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include "node_pool.h"
+#include "codec.h"
+#include "tree_stats.h"
+
+/**
+* Constructs a node's key/value pair in storage the node provides. The
+* variadic BinarySearchTree::makeNode() wraps its arguments in one of
+* these, so that the non-template constructNode() hook can still build
+* the item in place inside whatever node type a derived tree uses.
+*/
+template <typename Key, typename Value>
+class ItemBuilder
+{
+public:
+    template<typename F>
+    explicit ItemBuilder(F& build);
+
+    void operator()(void* where) const;
+
+private:
+    template<typename F>
+    static void call(void* build, void* where);
+
+    void* build_;
+    void (*call_)(void*, void*);
+};
+
+/**
+* Wraps build, a function object taking the address to construct at.
+* build must outlive the ItemBuilder.
+*/
+template<typename Key, typename Value>
+template<typename F>
+ItemBuilder<Key, Value>::ItemBuilder(F& build) :
+    build_(&build),
+    call_(&ItemBuilder<Key, Value>::template call<F>)
+{
+
+}
+
+/**
+* Constructs the std::pair<const Key, Value> at where.
+*/
+template<typename Key, typename Value>
+void ItemBuilder<Key, Value>::operator()(void* where) const
+{
+    call_(build_, where);
+}
+
+template<typename Key, typename Value>
+template<typename F>
+void ItemBuilder<Key, Value>::call(void* build, void* where)
+{
+    (*static_cast<F*>(build))(where);
+}
 
 /**
  * A templated class for a Node in a search tree.
- * The getters for parent/left/right are virtual so
- * that they can be overridden for future kinds of
- * search trees, such as Red Black trees, Splay trees,
- * and AVL trees.
+ * The getters for parent/left/right are deliberately
+ * NOT virtual: node types for other kinds of search
+ * trees (Red Black trees, Splay trees, AVL trees) hide
+ * them with versions that static_cast to their own type.
+ * Tree walks are then plain member loads that inline,
+ * and nodes carry no vtable pointer.
+ * The item sits in an anonymous union, which leaves its
+ * construction to the node's constructors, so that it can be
+ * built in place from any arguments (see ItemBuilder).
  */
 template <typename Key, typename Value>
 class Node
 {
 public:
     Node(const Key& key, const Value& value, Node<Key, Value>* parent);
-    virtual ~Node();
+    Node(const ItemBuilder<Key, Value>& build, Node<Key, Value>* parent);
+    ~Node();
 
     const std::pair<const Key, Value>& getItem() const;
     std::pair<const Key, Value>& getItem();
@@ -26,17 +98,21 @@ public:
     const Value& getValue() const;
     Value& getValue();
 
-    virtual Node<Key, Value>* getParent() const;
-    virtual Node<Key, Value>* getLeft() const;
-    virtual Node<Key, Value>* getRight() const;
+    Node<Key, Value>* getParent() const;
+    Node<Key, Value>* getLeft() const;
+    Node<Key, Value>* getRight() const;
 
     void setParent(Node<Key, Value>* parent);
     void setLeft(Node<Key, Value>* left);
     void setRight(Node<Key, Value>* right);
     void setValue(const Value &value);
+    void setValue(Value&& value);
 
 protected:
-    std::pair<const Key, Value> item_;
+    typedef std::pair<const Key, Value> Item;
+    union {
+        Item item_;
+    };
     Node<Key, Value>* parent_;
     Node<Key, Value>* left_;
     Node<Key, Value>* right_;
@@ -53,23 +129,35 @@ protected:
 */
 template<typename Key, typename Value>
 Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* parent) :
-    item_(key, value),
     parent_(parent),
     left_(NULL),
     right_(NULL)
 {
+    ::new (static_cast<void*>(&item_)) Item(key, value);
+}
 
+/**
+* Constructor that has build construct the key/value pair in place.
+* If that throws, the node is never constructed.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>::Node(const ItemBuilder<Key, Value>& build, Node<Key, Value>* parent) :
+    parent_(parent),
+    left_(NULL),
+    right_(NULL)
+{
+    build(&item_);
 }
 
 /**
-* Destructor, which does not need to do anything since the pointers inside of a node
+* Destructor, which only destroys the item since the pointers inside of a node
 * are only used as references to existing nodes. The nodes pointed to by parent/left/right
-* are freed by the BinarySearchTree.
+* are freed by the BinarySearchTree, which knows their most derived type.
 */
 template<typename Key, typename Value>
 Node<Key, Value>::~Node()
 {
-	
+	item_.~Item();
 }
 
 /**
@@ -118,7 +206,7 @@ Value& Node<Key, Value>::getValue()
 }
 
 /**
-* An implementation of the virtual function for retreiving the parent.
+* A getter for the parent.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getParent() const
@@ -127,7 +215,7 @@ Node<Key, Value>* Node<Key, Value>::getParent() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the left child.
+* A getter for the left child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getLeft() const
@@ -136,7 +224,7 @@ Node<Key, Value>* Node<Key, Value>::getLeft() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the right child.
+* A getter for the right child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getRight() const
@@ -180,30 +268,88 @@ void Node<Key, Value>::setValue(const Value& value)
     item_.second = value;
 }
 
+/**
+* A setter for the value of a node that moves instead of copying.
+*/
+template<typename Key, typename Value>
+void Node<Key, Value>::setValue(Value&& value)
+{
+    item_.second = std::move(value);
+}
+
 /*
   ---------------------------------------
   End implementations for the Node class.
   ---------------------------------------
 */
 
+/**
+* Detects comparators that declare is_transparent, i.e. ones that can
+* compare keys against other types (std::less<> comparing std::string
+* keys with std::string_view, for example).
+*/
+template<typename Compare, typename = void>
+struct IsTransparentCompare : std::false_type
+{
+};
+
+template<typename Compare>
+struct IsTransparentCompare<Compare,
+    typename std::conditional<true, void, typename Compare::is_transparent>::type> : std::true_type
+{
+};
+
+/**
+* What BinarySearchTree::validate() found. problem is NULL for a sound
+* tree, else a description of the first defect. Depths count edges from
+* the root (depth 0); height counts levels, so it is maxDepth + 1, or 0
+* for an empty tree. leafDepths[d] is the number of leaves at depth d.
+*/
+struct TreeShape
+{
+    TreeShape() : problem(NULL), heightBalanced(true), nodes(0), height(0), maxDepth(0), averageDepth(0) { }
+
+    bool valid() const { return problem == NULL; }
+
+    const char* problem;
+    bool heightBalanced;
+    std::size_t nodes;
+    int height;
+    int maxDepth;
+    double averageDepth;
+    std::vector<std::size_t> leafDepths;
+};
+
 /**
 * A templated unbalanced binary search tree.
+* Keys are ordered by Compare, a strict weak ordering like std::less.
 */
-template <typename Key, typename Value>
+template <typename Key, typename Value, typename Compare = std::less<Key> >
 class BinarySearchTree
 {
 public:
     BinarySearchTree(); //TODO
+    explicit BinarySearchTree(std::shared_ptr<NodePool> pool, const Compare& comp = Compare());
     virtual ~BinarySearchTree(); //TODO
     virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
     virtual void remove(const Key& key); //TODO
     void clear(); //TODO
+    template<typename ForwardIt>
+    void buildFromSorted(ForwardIt first, ForwardIt last);
+    template<typename KeyCodec = Codec<Key>, typename ValueCodec = Codec<Value> >
+    void serialize(std::ostream& out) const;
+    template<typename KeyCodec = Codec<Key>, typename ValueCodec = Codec<Value> >
+    void deserialize(std::istream& in);
     bool isBalanced() const; //TODO
+    TreeShape validate() const;
     void print() const;
     bool empty() const;
+    std::size_t size() const;
+    std::shared_ptr<NodePool> getPool() const;
+    Compare key_comp() const;
 
-    template<typename PPKey, typename PPValue>
-    friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
+    template<typename PPKey, typename PPValue, typename PPCompare>
+    friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue, PPCompare> & tree);
 public:
     /**
     * An internal iterator class for traversing the contents of the BST.
@@ -211,6 +357,12 @@ public:
     class iterator  // TODO
     {
     public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type* pointer;
+        typedef value_type& reference;
+
         iterator();
 
         std::pair<const Key,Value>& operator*() const;
@@ -220,25 +372,129 @@ public:
         bool operator!=(const iterator& rhs) const;
 
         iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
 
     protected:
-        friend class BinarySearchTree<Key, Value>;
-        iterator(Node<Key,Value>* ptr);
+        friend class BinarySearchTree<Key, Value, Compare>;
+        iterator(Node<Key,Value>* ptr, const BinarySearchTree<Key, Value, Compare>* tree);
         Node<Key, Value> *current_;
+        // needed to step back from end() to the largest item
+        const BinarySearchTree<Key, Value, Compare>* tree_;
     };
 
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+
 public:
     iterator begin() const;
     iterator end() const;
+    reverse_iterator rbegin() const;
+    reverse_iterator rend() const;
     iterator find(const Key& key) const;
+    template<typename K, typename C = Compare,
+        typename = typename std::enable_if<IsTransparentCompare<C>::value>::type>
+    iterator find(const K& key) const;
+    // Looks up every key in keys, interleaving the descents to hide cache misses
+    void findBatch(const std::vector<Key>& keys, std::vector<iterator>& out) const;
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
 
+    // Ordered lookups: each is a single descent from the root
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key) const;
+    template<typename Function>
+    std::size_t forEachInRange(const Key& lo, const Key& hi, Function fn) const;
+
+    // Move-aware insertion. All of these return the node holding the key and
+    // whether a new node was created. insert() and insert_or_assign() overwrite
+    // an existing value; emplace() and try_emplace() leave it alone.
+    template<typename P, typename = typename std::enable_if<
+        std::is_constructible<std::pair<Key, Value>, P&&>::value>::type>
+    std::pair<iterator, bool> insert(P&& keyValuePair);
+    // Hinted insert: O(1) comparisons when the key belongs just before hint
+    template<typename P, typename = typename std::enable_if<
+        std::is_constructible<std::pair<Key, Value>, P&&>::value>::type>
+    iterator insert(iterator hint, P&& keyValuePair);
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(Key&& key, Args&&... args);
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign(const Key& key, M&& obj);
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign(Key&& key, M&& obj);
+
 protected:
+    // Nodes have no virtual destructor, so the tree remembers how to destroy its node type
+    typedef void (*NodeDestroyer)(Node<Key, Value>*);
+
+    // Constructor for derived trees whose nodes are not plain Nodes
+    BinarySearchTree(std::size_t nodeSize, NodeDestroyer destroyer, std::shared_ptr<NodePool> pool,
+        const Compare& comp);
+
+    // Node allocation through the tree's NodePool
+    template<typename NodeT, typename... Args>
+    NodeT* createNode(Args&&... args);
+    template<typename NodeT>
+    static void destroyAs(Node<Key, Value>* node);
+    void destroyNode(Node<Key, Value>* node);
+    bool canReleaseSlabs() const;
+    iterator iteratorAt(Node<Key, Value>* node) const;
+
+    // Cached smallest/largest nodes
+    void resetBounds();
+    void boundsBeforeUnlink(Node<Key, Value>* node);
+
+    // Replaces the (already detached) contents with the subtree at root
+    static const std::size_t UNKNOWN_COUNT = static_cast<std::size_t>(-1);
+    void adoptSubtree(Node<Key, Value>* root, std::size_t count);
+    std::size_t knownCount() const;
+    void settleCount();
+
+    // Shared insertion path: find the slot, create the node, link it, fix up
+    Node<Key, Value>* findInsertPoint(const Key& key, Node<Key, Value>*& parent, bool& asLeft) const;
+    Node<Key, Value>* findInsertPointNear(Node<Key, Value>* hint, const Key& key, Node<Key, Value>*& parent,
+        bool& asLeft) const;
+    template<typename K, typename... Args>
+    std::pair<iterator, bool> tryEmplaceImpl(K&& key, Args&&... args);
+    template<typename K, typename M>
+    std::pair<iterator, bool> insertOrAssignImpl(K&& key, M&& obj);
+    void insertCopy(const std::pair<const Key, Value>& keyValuePair, std::true_type);
+    void insertCopy(const std::pair<const Key, Value>& keyValuePair, std::false_type);
+    template<typename K, typename M>
+    std::pair<iterator, bool> assignOrLink(Node<Key, Value>* found, Node<Key, Value>* parent, bool asLeft,
+        K&& key, M&& obj);
+    void linkNode(Node<Key, Value>* node, Node<Key, Value>* parent, bool asLeft);
+    // A node of the tree's own type with its item built in place from args
+    template<typename... Args>
+    Node<Key, Value>* makeNode(Node<Key, Value>* parent, Args&&... args);
+
+    // Hooks so derived trees get their own node type and rebalancing
+    virtual Node<Key, Value>* constructNode(const ItemBuilder<Key, Value>& build, Node<Key, Value>* parent);
+    virtual void insertFixup(Node<Key, Value>* node);
+    virtual void accessFixup(Node<Key, Value>* node);
+    virtual void builtSubtree(Node<Key, Value>* node, int leftHeight, int rightHeight);
+    virtual const char* checkNode(const Node<Key, Value>* node, int leftHeight, int rightHeight) const;
+    template<typename ForwardIt>
+    Node<Key, Value>* buildSubtree(ForwardIt& it, std::size_t count, int& height);
+
     // Mandatory helper functions
     Node<Key, Value>* internalFind(const Key& k) const; // TODO
+    template<typename K>
+    Node<Key, Value>* findNode(const K& key) const;
+    Node<Key, Value>* lowerBoundNode(const Key& key) const;
+    Node<Key, Value>* upperBoundNode(const Key& key) const;
+    // Searches findBatch() advances in lockstep, and the prefetch it issues
+    static const std::size_t BATCH_WIDTH = 16;
+    static void prefetchNode(const Node<Key, Value>* node);
     Node<Key, Value> *getSmallestNode() const;  // TODO
+    Node<Key, Value> *getLargestNode() const;
     static Node<Key, Value>* predecessor(Node<Key, Value>* current); // TODO
+    static Node<Key, Value>* successor(Node<Key, Value>* current);
     // Note:  static means these functions don't have a "this" pointer
     //        and instead just use the input argument.
 
@@ -247,37 +503,74 @@ protected:
     virtual void nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2) ;
 
     // Add helper functions here
-		int maxHeight(Node<Key, Value>* node_) const {
-			if (node_ == NULL) {
-				return 0;
+		// Destroys the subtree at curr without recursion. Each node is
+		// read and destroyed before its children: the left one is next and
+		// the right one waits on a fixed stack, which only the nodes with two
+		// children use, so a balanced tree never fills it. Should it fill
+		// up, the right subtree is torn down by rotations instead, which
+		// needs no stack at all. With returnBlocks false the storage is left
+		// for a pool release.
+		void clearHelper(Node<Key, Value>* curr, bool returnBlocks = true) {
+			Node<Key, Value>* pending[64];
+			std::size_t depth = 0;
+			while (curr != NULL || depth > 0) {
+				if (curr == NULL) {
+					curr = pending[--depth];
+				}
+				Node<Key, Value>* left = curr->getLeft();
+				Node<Key, Value>* right = curr->getRight();
+				releaseNode(curr, returnBlocks);
+				if (left != NULL && right != NULL) {
+					if (depth < sizeof(pending) / sizeof(pending[0])) {
+						pending[depth++] = right;
+					} else {
+						clearByRotation(right, returnBlocks);
+					}
+				}
+				curr = left != NULL ? left : right;
 			}
-
-			return std::max(maxHeight(node_->getLeft()), maxHeight(node_->getRight())) + 1;
 		}
 
-		bool balancedHelper(Node<Key, Value>* node_) const {
-			if (node_ == NULL) {
-				return true;
+		// Destroys the subtree at curr in O(1) space: while curr has a left
+		// child, that child is rotated above it; otherwise curr goes and its
+		// right subtree is next.
+		void clearByRotation(Node<Key, Value>* curr, bool returnBlocks) {
+			while (curr != NULL) {
+				Node<Key, Value>* left = curr->getLeft();
+				if (left != NULL) {
+					curr->setLeft(left->getRight());
+					left->setRight(curr);
+					curr = left;
+				} else {
+					Node<Key, Value>* right = curr->getRight();
+					releaseNode(curr, returnBlocks);
+					curr = right;
+				}
 			}
-
-			return std::abs(maxHeight(node_->getLeft()) - maxHeight(node_->getRight())) <= 1 && 
-			balancedHelper(node_->getLeft()) && balancedHelper(node_->getRight());
 		}
 
-		void clearHelper(Node<Key, Value>* curr) {
-			if (curr == NULL) {
-				return;
+		void releaseNode(Node<Key, Value>* node, bool returnBlock) {
+			if (returnBlock) {
+				destroyNode(node);
+			} else {
+				destroyer_(node);
 			}
-
-			clearHelper(curr->getLeft());
-			clearHelper(curr->getRight());
-			delete curr;
 		}
 
 
 protected:
     Node<Key, Value>* root_;
     // You should not need other data members
+    std::shared_ptr<NodePool> pool_;
+    NodeDestroyer destroyer_;
+    Compare comp_;
+    // unknown after a split without subtree sizes; countedSize_ then caches
+    // what size() counted until the tree next changes
+    std::size_t nodeCount_;
+    bool countValid_;
+    mutable std::atomic<std::size_t> countedSize_;
+    Node<Key, Value>* minNode_;
+    Node<Key, Value>* maxNode_;
 };
 
 /*
@@ -289,29 +582,32 @@ Begin implementations for the BinarySearchTree::iterator class.
 /**
 * Explicit constructor that initializes an iterator with a given node pointer.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr)
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::iterator::iterator(Node<Key,Value> *ptr,
+    const BinarySearchTree<Key, Value, Compare>* tree)
 {
     // TODO
 		current_ = ptr;
+		tree_ = tree;
 }
 
 /**
 * A default constructor that initializes the iterator to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator() 
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::iterator::iterator() 
 {
     // TODO
 		current_ = NULL;
+		tree_ = NULL;
 }
 
 /**
 * Provides access to the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 std::pair<const Key,Value> &
-BinarySearchTree<Key, Value>::iterator::operator*() const
+BinarySearchTree<Key, Value, Compare>::iterator::operator*() const
 {
     return current_->getItem();
 }
@@ -319,9 +615,9 @@ BinarySearchTree<Key, Value>::iterator::operator*() const
 /**
 * Provides access to the address of the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 std::pair<const Key,Value> *
-BinarySearchTree<Key, Value>::iterator::operator->() const
+BinarySearchTree<Key, Value, Compare>::iterator::operator->() const
 {
     return &(current_->getItem());
 }
@@ -330,10 +626,10 @@ BinarySearchTree<Key, Value>::iterator::operator->() const
 * Checks if 'this' iterator's internals have the same value
 * as 'rhs'
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 bool
-BinarySearchTree<Key, Value>::iterator::operator==(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare>::iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare>::iterator& rhs) const
 {
     // TODO
 		if (current_ == rhs.current_) {
@@ -347,10 +643,10 @@ BinarySearchTree<Key, Value>::iterator::operator==(
 * Checks if 'this' iterator's internals have a different value
 * as 'rhs'
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 bool
-BinarySearchTree<Key, Value>::iterator::operator!=(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare>::iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare>::iterator& rhs) const
 {
 	if (current_ != rhs.current_) {
 		return true;
@@ -363,35 +659,54 @@ BinarySearchTree<Key, Value>::iterator::operator!=(
 /**
 * Advances the iterator's location using an in-order sequencing
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator&
-BinarySearchTree<Key, Value>::iterator::operator++()
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator&
+BinarySearchTree<Key, Value, Compare>::iterator::operator++()
 {
-    if (current_ == NULL) {
-        return *this;
-    }
+    current_ = successor(current_);
+    return *this;
+}
+
+/**
+* Post-increment
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::iterator::operator++(int)
+{
+    iterator old(*this);
+    ++(*this);
+    return old;
+}
 
-    // go far left if right tree
-    if (current_->getRight()){
-        current_ = current_->getRight();
-        while (current_->getLeft() != NULL) {
-            current_ = current_->getLeft();
+/**
+* Moves the iterator back one item in order.
+* Stepping back from end() lands on the largest item.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator&
+BinarySearchTree<Key, Value, Compare>::iterator::operator--()
+{
+    if (current_ == NULL) {
+        if (tree_ != NULL) {
+            current_ = tree_->getLargestNode();
         }
+    } else {
+        current_ = predecessor(current_);
     }
-		
-    
-    // if on right subtree
-    else {
-			Node<Key, Value>* parent = current_->getParent();
-			while (parent != NULL && current_ == parent->getRight()) {
-				current_ = parent;
-				parent = parent->getParent();
-			}
-				
-			current_ = parent;
-		}
-	
-		return *this;
+    return *this;
+}
+
+/**
+* Post-decrement
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --(*this);
+    return old;
 }
 
 
@@ -410,14 +725,51 @@ Begin implementations for the BinarySearchTree class.
 /**
 * Default constructor for a BinarySearchTree, which sets the root to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::BinarySearchTree() 
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree() :
+    BinarySearchTree(sizeof(Node<Key, Value>), &destroyAs<Node<Key, Value> >, std::shared_ptr<NodePool>(), Compare())
 {
-    root_ = NULL;
+
 }
 
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::~BinarySearchTree()
+/**
+* Constructor that allocates nodes from the given pool, which may be shared
+* with other trees, and orders keys with comp. A NULL pool gives the tree
+* a private pool.
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree(std::shared_ptr<NodePool> pool, const Compare& comp) :
+    BinarySearchTree(sizeof(Node<Key, Value>), &destroyAs<Node<Key, Value> >, pool, comp)
+{
+
+}
+
+/**
+* Constructor used by derived trees to size the pool for their node type
+* and to say how those nodes are destroyed.
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree(std::size_t nodeSize, NodeDestroyer destroyer, std::shared_ptr<NodePool> pool,
+    const Compare& comp) :
+    root_(NULL),
+    pool_(pool),
+    destroyer_(destroyer),
+    comp_(comp),
+    nodeCount_(0),
+    countValid_(true),
+    countedSize_(UNKNOWN_COUNT),
+    minNode_(NULL),
+    maxNode_(NULL)
+{
+    if (!pool_) {
+        pool_ = std::make_shared<NodePool>(nodeSize);
+    } else if (pool_->blockSize() < nodeSize) {
+        throw std::invalid_argument("NodePool blocks are too small for this tree's nodes");
+    }
+}
+
+template<typename Key, typename Value, typename Compare>
+BinarySearchTree<Key, Value, Compare>::~BinarySearchTree()
 {
 	clear();
 }
@@ -425,14 +777,55 @@ BinarySearchTree<Key, Value>::~BinarySearchTree()
 /**
  * Returns true if tree is empty
 */
-template<class Key, class Value>
-bool BinarySearchTree<Key, Value>::empty() const
+template<class Key, class Value, class Compare>
+bool BinarySearchTree<Key, Value, Compare>::empty() const
 {
     return root_ == NULL;
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::print() const
+/**
+* Returns the number of items in the tree in O(1)
+* (except once after AVLTree::split, which has to count them). The count
+* is cached in an atomic, so concurrent calls on a const tree are safe.
+*/
+template<class Key, class Value, class Compare>
+std::size_t BinarySearchTree<Key, Value, Compare>::size() const
+{
+    if (countValid_) {
+        return nodeCount_;
+    }
+    std::size_t count = countedSize_.load(std::memory_order_relaxed);
+    if (count == UNKNOWN_COUNT) {
+        count = 0;
+        for (Node<Key, Value>* curr = minNode_; curr != NULL; curr = successor(curr)) {
+            ++count;
+        }
+        countedSize_.store(count, std::memory_order_relaxed);
+    }
+    return count;
+}
+
+/**
+* Returns the pool the tree allocates its nodes from, so that
+* other trees can be constructed to share it.
+*/
+template<class Key, class Value, class Compare>
+std::shared_ptr<NodePool> BinarySearchTree<Key, Value, Compare>::getPool() const
+{
+    return pool_;
+}
+
+/**
+* Returns a copy of the comparator used to order the keys.
+*/
+template<class Key, class Value, class Compare>
+Compare BinarySearchTree<Key, Value, Compare>::key_comp() const
+{
+    return comp_;
+}
+
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::print() const
 {
     printRoot(root_);
     std::cout << "\n";
@@ -441,51 +834,195 @@ void BinarySearchTree<Key, Value>::print() const
 /**
 * Returns an iterator to the "smallest" item in the tree
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::begin() const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::begin() const
 {
-    BinarySearchTree<Key, Value>::iterator begin(getSmallestNode());
+    BinarySearchTree<Key, Value, Compare>::iterator begin(getSmallestNode(), this);
     return begin;
 }
 
 /**
 * Returns an iterator whose value means INVALID
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::end() const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::end() const
 {
-    BinarySearchTree<Key, Value>::iterator end(NULL);
+    BinarySearchTree<Key, Value, Compare>::iterator end(NULL, this);
     return end;
 }
 
+/**
+* Returns a reverse iterator to the largest item
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::reverse_iterator
+BinarySearchTree<Key, Value, Compare>::rbegin() const
+{
+    return reverse_iterator(end());
+}
+
+/**
+* Returns the reverse iterator one before the smallest item
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::reverse_iterator
+BinarySearchTree<Key, Value, Compare>::rend() const
+{
+    return reverse_iterator(begin());
+}
+
 /**
 * Returns an iterator to the item with the given key, k
 * or the end iterator if k does not exist in the tree
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::find(const Key & k) const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::find(const Key & k) const
 {
     Node<Key, Value> *curr = internalFind(k);
-    BinarySearchTree<Key, Value>::iterator it(curr);
+    BinarySearchTree<Key, Value, Compare>::iterator it(curr, this);
     return it;
 }
 
+/**
+* Heterogeneous find, only available when Compare is transparent:
+* looks up a key given as any type Compare can order against Key.
+*/
+template<class Key, class Value, class Compare>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::find(const K& k) const
+{
+    return iteratorAt(findNode(k));
+}
+
+/**
+* Like calling find() for each key, with the answers written to out in
+* the same order. Up to BATCH_WIDTH descents advance one level at a time
+* in turn, and the next node of each is prefetched, so on a tree larger
+* than the cache their misses overlap instead of being waited on one by
+* one.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::findBatch(const std::vector<Key>& keys, std::vector<iterator>& out) const
+{
+    out.assign(keys.size(), end());
+    Node<Key, Value>* curr[BATCH_WIDTH];
+    Node<Key, Value>* candidate[BATCH_WIDTH];
+
+    for (std::size_t base = 0; base < keys.size(); base += BATCH_WIDTH) {
+        std::size_t count = keys.size() - base < BATCH_WIDTH ? keys.size() - base : BATCH_WIDTH;
+        for (std::size_t i = 0; i < count; ++i) {
+            curr[i] = root_;
+            candidate[i] = NULL;
+        }
+
+        // the same one-compare descent as findNode(), one level per pass
+        bool active = root_ != NULL;
+        while (active) {
+            active = false;
+            for (std::size_t i = 0; i < count; ++i) {
+                Node<Key, Value>* node = curr[i];
+                if (node == NULL) {
+                    continue;
+                }
+                BST_COUNT(NODE_VISITS);
+                BST_COUNT(COMPARISONS);
+                if (comp_(keys[base + i], node->getKey())) {
+                    node = node->getLeft();
+                } else {
+                    candidate[i] = node;
+                    node = node->getRight();
+                }
+                curr[i] = node;
+                if (node != NULL) {
+                    prefetchNode(node);
+                    active = true;
+                }
+            }
+        }
+
+        for (std::size_t i = 0; i < count; ++i) {
+            BST_COUNT(COMPARISONS);
+            if (candidate[i] != NULL && !comp_(candidate[i]->getKey(), keys[base + i])) {
+                out[base + i] = iteratorAt(candidate[i]);
+            }
+        }
+    }
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or end() if there is none
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    return iteratorAt(lowerBoundNode(key));
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key,
+* or end() if there is none
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::upper_bound(const Key& key) const
+{
+    return iteratorAt(upperBoundNode(key));
+}
+
+/**
+* Returns the [lower_bound, upper_bound) pair for key. Keys are unique,
+* so the upper end is one in-order step from the lower end when key is
+* present and equal to it otherwise.
+*/
+template<class Key, class Value, class Compare>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator,
+          typename BinarySearchTree<Key, Value, Compare>::iterator>
+BinarySearchTree<Key, Value, Compare>::equal_range(const Key& key) const
+{
+    iterator lower(iteratorAt(lowerBoundNode(key)));
+    iterator upper(lower);
+    if (upper != end() && !comp_(key, upper->first)) {
+        ++upper;
+    }
+    return std::make_pair(lower, upper);
+}
+
+/**
+* Calls fn on every item whose key is in [lo, hi), in order, and returns
+* how many items were visited. Costs O(log n + k) for k items in range.
+*/
+template<class Key, class Value, class Compare>
+template<typename Function>
+std::size_t BinarySearchTree<Key, Value, Compare>::forEachInRange(const Key& lo, const Key& hi, Function fn) const
+{
+    std::size_t visited = 0;
+    for (iterator it(iteratorAt(lowerBoundNode(lo))); it != end() && comp_(it->first, hi); ++it) {
+        fn(*it);
+        ++visited;
+    }
+    return visited;
+}
+
 /**
  * @precondition The key exists in the map
  * Returns the value associated with the key
  */
-template<class Key, class Value>
-Value& BinarySearchTree<Key, Value>::operator[](const Key& key)
+template<class Key, class Value, class Compare>
+Value& BinarySearchTree<Key, Value, Compare>::operator[](const Key& key)
 {
     Node<Key, Value> *curr = internalFind(key);
     if(curr == NULL) throw std::out_of_range("Invalid key");
+    accessFixup(curr);
     return curr->getValue();
 }
-template<class Key, class Value>
-Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
+template<class Key, class Value, class Compare>
+Value const & BinarySearchTree<Key, Value, Compare>::operator[](const Key& key) const
 {
     Node<Key, Value> *curr = internalFind(key);
     if(curr == NULL) throw std::out_of_range("Invalid key");
@@ -497,42 +1034,293 @@ Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
 * The tree will not remain balanced when inserting.
 * Recall: If key is already in the tree, you should 
 * overwrite the current value with the updated value.
+* This copies the value, so for values that cannot be copied (which only
+* emplace() and try_emplace() can store) it throws std::logic_error; being
+* virtual, it has to compile for them all the same.
 */
-template<class Key, class Value>
-void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::insert(const std::pair<const Key, Value> &keyValuePair)
 {
-    // TODO
-	if (root_ == NULL) {
-		root_ = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, NULL);
-		return;
+	insertCopy(keyValuePair, std::integral_constant<bool,
+		std::is_copy_constructible<Value>::value && std::is_copy_assignable<Value>::value>());
+}
+
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::insertCopy(const std::pair<const Key, Value>& keyValuePair,
+	std::true_type)
+{
+	insertOrAssignImpl(keyValuePair.first, keyValuePair.second);
+}
+
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::insertCopy(const std::pair<const Key, Value>&, std::false_type)
+{
+	throw std::logic_error("insert: the value type cannot be copied; use emplace() or try_emplace()");
+}
+
+/**
+* Inserts any pair a std::pair<Key, Value> can be built from, moving out of
+* rvalues. Like insert(const pair&), an existing value is overwritten (by move).
+* The key and value go straight from the argument into the node.
+*/
+template<class Key, class Value, class Compare>
+template<typename P, typename>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::insert(P&& keyValuePair)
+{
+	return insertOrAssignImpl(std::get<0>(std::forward<P>(keyValuePair)),
+		std::get<1>(std::forward<P>(keyValuePair)));
+}
+
+/**
+* Inserts (or overwrites) like insert(), starting from hint instead of the
+* root: if the key belongs right before hint (or after the largest key,
+* for end()) no descent is needed. A wrong hint only costs a few extra
+* comparisons. Returns an iterator to the key's node.
+*/
+template<class Key, class Value, class Compare>
+template<typename P, typename>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::insert(iterator hint, P&& keyValuePair)
+{
+	Node<Key, Value>* parent;
+	bool asLeft;
+	Node<Key, Value>* found = findInsertPointNear(hint.current_, std::get<0>(keyValuePair), parent, asLeft);
+	return assignOrLink(found, parent, asLeft, std::get<0>(std::forward<P>(keyValuePair)),
+		std::get<1>(std::forward<P>(keyValuePair))).first;
+}
+
+/**
+* Builds a key/value pair from args and inserts it if its key is new.
+* An existing value is left untouched, as with std::map::emplace. As
+* there, the key is only known once the pair exists, so the node is
+* built first (in place) and freed again if the key is already present.
+*/
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::emplace(Args&&... args)
+{
+	Node<Key, Value>* node = makeNode(NULL, std::forward<Args>(args)...);
+	Node<Key, Value>* parent;
+	bool asLeft;
+	Node<Key, Value>* found = findInsertPoint(node->getKey(), parent, asLeft);
+	if (found != NULL) {
+		destroyNode(node);
+		accessFixup(found);
+		return std::make_pair(iteratorAt(found), false);
+	}
+
+	node->setParent(parent);
+	linkNode(node, parent, asLeft);
+	return std::make_pair(iteratorAt(node), true);
+}
+
+/**
+* Inserts key with a value built from args, but only if key is new.
+* Nothing is constructed (or moved from) when the key already exists.
+*/
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::try_emplace(const Key& key, Args&&... args)
+{
+	return tryEmplaceImpl(key, std::forward<Args>(args)...);
+}
+
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::try_emplace(Key&& key, Args&&... args)
+{
+	return tryEmplaceImpl(std::move(key), std::forward<Args>(args)...);
+}
+
+/**
+* Inserts key with value obj, or assigns obj (moving it if it is an rvalue)
+* to the value already stored under key.
+*/
+template<class Key, class Value, class Compare>
+template<typename M>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::insert_or_assign(const Key& key, M&& obj)
+{
+	return insertOrAssignImpl(key, std::forward<M>(obj));
+}
+
+template<class Key, class Value, class Compare>
+template<typename M>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::insert_or_assign(Key&& key, M&& obj)
+{
+	return insertOrAssignImpl(std::move(key), std::forward<M>(obj));
+}
+
+/**
+* Walks down from the root looking for key. Returns its node if it is
+* already in the tree; otherwise returns NULL and sets parent/asLeft to
+* where a new node with that key has to be linked.
+* Like findNode(), this costs one comparison per level plus one at the end.
+* Keys past the largest one (timestamps, sequence numbers) skip the
+* descent and go straight under the cached maximum.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::findInsertPoint(const Key& key, Node<Key, Value>*& parent, bool& asLeft) const
+{
+	BST_COUNT(COMPARISONS);
+	if (maxNode_ != NULL && comp_(maxNode_->getKey(), key)) {
+		parent = maxNode_;
+		asLeft = false;
+		return NULL;
 	}
 
 	Node<Key, Value>* curr = root_;
-	Node<Key, Value>* parent = NULL;
+	Node<Key, Value>* candidate = NULL;
+	parent = NULL;
+	asLeft = false;
+
 	while (curr != NULL) {
+		BST_COUNT(NODE_VISITS);
+		BST_COUNT(COMPARISONS);
 		parent = curr;
-		if (keyValuePair.first < curr->getKey()) {
+		asLeft = comp_(key, curr->getKey());
+		if (asLeft) {
 			curr = curr->getLeft();
-		}
-
-		else if (keyValuePair.first > curr->getKey()) {
+		} else {
+			candidate = curr;
 			curr = curr->getRight();
 		}
+	}
+
+	BST_COUNT(COMPARISONS);
+	if (candidate != NULL && !comp_(candidate->getKey(), key)) {
+		return candidate;
+	}
+	return NULL;
+}
 
-		else {
-			curr->setValue(keyValuePair.second);
-			return;
+/**
+* findInsertPoint() for a key expected to go just before hint (NULL for
+* end()). When predecessor(hint) < key < hint, the new node hangs off
+* whichever of the two has a free slot on that side; otherwise this
+* falls back to the descent from the root. Prepending with a begin()
+* hint is O(1), like appending with end().
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::findInsertPointNear(Node<Key, Value>* hint,
+	const Key& key, Node<Key, Value>*& parent, bool& asLeft) const
+{
+	parent = NULL;
+	asLeft = false;
+	if (hint != NULL) {
+		BST_COUNT(NODE_VISITS);
+		BST_COUNT(COMPARISONS);
+		if (!comp_(key, hint->getKey())) {
+			BST_COUNT(COMPARISONS);
+			if (!comp_(hint->getKey(), key)) {
+				return hint;
+			}
+		} else {
+			// the smallest node has no predecessor, and walking up to find
+			// that out would cost the whole left spine
+			Node<Key, Value>* before = hint == minNode_ ? NULL : predecessor(hint);
+			if (before != NULL) {
+				BST_COUNT(NODE_VISITS);
+				BST_COUNT(COMPARISONS);
+			}
+			if (before == NULL || comp_(before->getKey(), key)) {
+				asLeft = hint->getLeft() == NULL;
+				parent = asLeft ? hint : before;
+				return NULL;
+			}
 		}
 	}
+	return findInsertPoint(key, parent, asLeft);
+}
 
-	// if left node of the node
-	if (keyValuePair.first < parent->getKey()) {
-		parent->setLeft(new Node<Key, Value>(keyValuePair.first, keyValuePair.second, parent));
+/**
+* Inserts key with a value built from args if key is new: the pair is
+* constructed piecewise, in place, inside a node of the tree's own type.
+*/
+template<class Key, class Value, class Compare>
+template<typename K, typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::tryEmplaceImpl(K&& key, Args&&... args)
+{
+	Node<Key, Value>* parent;
+	bool asLeft;
+	Node<Key, Value>* found = findInsertPoint(key, parent, asLeft);
+	if (found != NULL) {
+		accessFixup(found);
+		return std::make_pair(iteratorAt(found), false);
 	}
 
-	else {
-		parent->setRight(new Node<Key, Value>(keyValuePair.first, keyValuePair.second, parent));
+	Node<Key, Value>* node = makeNode(parent, std::piecewise_construct,
+		std::forward_as_tuple(std::forward<K>(key)),
+		std::forward_as_tuple(std::forward<Args>(args)...));
+	linkNode(node, parent, asLeft);
+	return std::make_pair(iteratorAt(node), true);
+}
+
+/**
+* Like tryEmplaceImpl(), but an existing value is overwritten by obj.
+*/
+template<class Key, class Value, class Compare>
+template<typename K, typename M>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::insertOrAssignImpl(K&& key, M&& obj)
+{
+	Node<Key, Value>* parent;
+	bool asLeft;
+	Node<Key, Value>* found = findInsertPoint(key, parent, asLeft);
+	return assignOrLink(found, parent, asLeft, std::forward<K>(key), std::forward<M>(obj));
+}
+
+/**
+* Finishes an insert-or-assign once the key has been looked up: overwrites
+* found's value, or links a new node at parent/asLeft.
+*/
+template<class Key, class Value, class Compare>
+template<typename K, typename M>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::assignOrLink(Node<Key, Value>* found, Node<Key, Value>* parent,
+	bool asLeft, K&& key, M&& obj)
+{
+	if (found != NULL) {
+		found->getValue() = std::forward<M>(obj);
+		accessFixup(found);
+		return std::make_pair(iteratorAt(found), false);
 	}
+
+	Node<Key, Value>* node = makeNode(parent, std::forward<K>(key), std::forward<M>(obj));
+	linkNode(node, parent, asLeft);
+	return std::make_pair(iteratorAt(node), true);
+}
+
+/**
+* Hangs a freshly made node under parent (or makes it the root) and lets
+* the derived tree rebalance.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::linkNode(Node<Key, Value>* node, Node<Key, Value>* parent, bool asLeft)
+{
+	if (parent == NULL) {
+		root_ = node;
+		minNode_ = node;
+		maxNode_ = node;
+	} else if (asLeft) {
+		parent->setLeft(node);
+		if (parent == minNode_) {
+			minNode_ = node;
+		}
+	} else {
+		parent->setRight(node);
+		if (parent == maxNode_) {
+			maxNode_ = node;
+		}
+	}
+
+	insertFixup(node);
 }
 
 
@@ -541,8 +1329,8 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
 * Recall: The writeup specifies that if a node has 2 children you
 * should swap with the predecessor and then remove.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::remove(const Key& key)
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::remove(const Key& key)
 {
 	// TODO
 	Node<Key, Value>* current_node = internalFind(key);
@@ -556,6 +1344,8 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
 		nodeSwap(current_node, predecessor(current_node));
 	}
 
+	boundsBeforeUnlink(current_node);
+
 	if (current_node->getLeft()) {
 		replacement_node = current_node->getLeft();
 	} else if (current_node->getRight()) {
@@ -590,16 +1380,16 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
 		}
 	}
 
-	delete current_node;
+	destroyNode(current_node);
 }
 
 /* 1 
   / \
   3 4
  */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
+BinarySearchTree<Key, Value, Compare>::predecessor(Node<Key, Value>* current)
 {	
     // TODO
 
@@ -644,42 +1434,465 @@ BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
 	return NULL;
 }
 
+/**
+* Returns the in-order successor of current, or NULL if current
+* is the largest node
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::successor(Node<Key, Value>* current)
+{
+	if (current == NULL) {
+		return NULL;
+	}
+
+	// leftmost node of the right subtree
+	if (current->getRight() != NULL) {
+		current = current->getRight();
+		while (current->getLeft() != NULL) {
+			current = current->getLeft();
+		}
+		return current;
+	}
+
+	// otherwise the first ancestor we reach from its left side
+	Node<Key, Value>* parent = current->getParent();
+	while (parent != NULL && current == parent->getRight()) {
+		current = parent;
+		parent = parent->getParent();
+	}
+	return parent;
+}
+
 
 /**
 * A method to remove all contents of the tree and
 * reset the values in the tree for use again.
+* Runs in O(n) time and O(1) extra space at any depth. A tree that is
+* the only user of its pool frees its memory in bulk by dropping the
+* slabs (after running the node destructors, if the item types have
+* any); a tree sharing its pool hands the blocks back one by one.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clear()
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::clear()
 {
 	if (root_ == NULL) {
 		return;
 	}
 
-	clearHelper(root_);
-	root_ = NULL;
+	if (canReleaseSlabs()) {
+		// nothing to destruct and nobody else using the slabs
+		pool_->release();
+	} else if (pool_.use_count() == 1) {
+		clearHelper(root_, false);
+		pool_->release();
+	} else {
+		clearHelper(root_);
+	}
+	adoptSubtree(NULL, 0);
 }
 
 /**
-* A helper function to find the smallest node in the tree.
+* Constructs a node of type NodeT in storage taken from the pool.
 */
-template<typename Key, typename Value>
-Node<Key, Value>*
-BinarySearchTree<Key, Value>::getSmallestNode() const
+template<typename Key, typename Value, typename Compare>
+template<typename NodeT, typename... Args>
+NodeT* BinarySearchTree<Key, Value, Compare>::createNode(Args&&... args)
 {
-    // TODO
-	if (root_ == NULL) {
+	void* block = pool_->allocate();
+	NodeT* node;
+	try {
+		node = new (block) NodeT(std::forward<Args>(args)...);
+	} catch (...) {
+		pool_->deallocate(block);
+		throw;
+	}
+	settleCount();
+	++nodeCount_;
+	BST_COUNT(ALLOCATIONS);
+	return node;
+}
+
+/**
+* Replaces the contents of the tree with the items in [first, last)
+* by building a perfectly balanced tree in O(n).
+* The items are expected in strictly increasing key order; anything else
+* is sorted first (O(n log n)), and for repeated keys the last value wins,
+* just like a sequence of insert() calls.
+* If copying an item or allocating a node throws, the tree is left empty
+* and none of the nodes built so far leak.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename ForwardIt>
+void BinarySearchTree<Key, Value, Compare>::buildFromSorted(ForwardIt first, ForwardIt last)
+{
+	clear();
+
+	bool sorted = true;
+	if (first != last) {
+		ForwardIt prev = first;
+		for (ForwardIt curr = std::next(first); curr != last; ++prev, ++curr) {
+			if (!comp_(prev->first, curr->first)) {
+				sorted = false;
+				break;
+			}
+		}
+	}
+
+	// root_ stays empty until the build is done, so a throw leaves an
+	// empty tree behind, not a half-linked one
+	int height;
+	if (sorted) {
+		Node<Key, Value>* root = buildSubtree(first, std::distance(first, last), height);
+		root_ = root;
+		resetBounds();
+		return;
+	}
+
+	std::vector<std::pair<Key, Value> > items(first, last);
+	const Compare& comp = comp_;
+	std::stable_sort(items.begin(), items.end(),
+		[&comp](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b) {
+			return comp(a.first, b.first);
+		});
+
+	// keep only the last item of each run of equal keys
+	std::size_t kept = 0;
+	for (std::size_t i = 0; i < items.size(); ++i) {
+		if (i + 1 < items.size() && !comp_(items[i].first, items[i + 1].first)) {
+			continue;
+		}
+		if (kept != i) {
+			items[kept] = std::move(items[i]);
+		}
+		++kept;
+	}
+	items.erase(items.begin() + kept, items.end());
+
+	std::move_iterator<typename std::vector<std::pair<Key, Value> >::iterator> it(items.begin());
+	Node<Key, Value>* root = buildSubtree(it, items.size(), height);
+	root_ = root;
+	resetBounds();
+}
+
+/**
+* Writes the items to out in key order: a header with the item count,
+* then one record per item, the key encoded by KeyCodec followed by the
+* value encoded by ValueCodec (see codec.h).
+* Throws std::runtime_error if out fails.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename KeyCodec, typename ValueCodec>
+void BinarySearchTree<Key, Value, Compare>::serialize(std::ostream& out) const
+{
+    writeTreeStreamHeader(out, size());
+    for (Node<Key, Value>* curr = minNode_; curr != NULL; curr = successor(curr)) {
+        KeyCodec::write(out, curr->getKey());
+        ValueCodec::write(out, curr->getValue());
+    }
+    if (!out) {
+        throw std::runtime_error("serialize: write failed");
+    }
+}
+
+/**
+* Replaces the contents of the tree with the items written by
+* serialize(), rebuilt by buildFromSorted() in O(n) rather than by n
+* inserts. The records are read in full before the tree is touched, so
+* a truncated or corrupt stream (std::runtime_error) leaves it as it was.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename KeyCodec, typename ValueCodec>
+void BinarySearchTree<Key, Value, Compare>::deserialize(std::istream& in)
+{
+    uint64_t count = readTreeStreamHeader(in);
+
+    // a corrupt count must not turn into a huge allocation up front
+    std::vector<std::pair<Key, Value> > items;
+    items.reserve(static_cast<std::size_t>(std::min<uint64_t>(count, 1 << 20)));
+    for (uint64_t i = 0; i < count; ++i) {
+        Key key = KeyCodec::read(in);
+        Value value = ValueCodec::read(in);
+        if (!in) {
+            throw std::runtime_error("deserialize: stream ended early");
+        }
+        if (!items.empty() && !comp_(items.back().first, key)) {
+            throw std::runtime_error("deserialize: keys are not in order");
+        }
+        items.push_back(std::make_pair(std::move(key), std::move(value)));
+    }
+
+    typedef std::move_iterator<typename std::vector<std::pair<Key, Value> >::iterator> MoveIt;
+    buildFromSorted(MoveIt(items.begin()), MoveIt(items.end()));
+}
+
+/**
+* Builds a balanced subtree out of the next count items of it, which is
+* advanced past them, and reports the subtree's height.
+* The middle item becomes the root so both halves differ by at most one.
+* If an item cannot be copied or a node allocated, the nodes built so
+* far are destroyed before the exception is passed on.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename ForwardIt>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::buildSubtree(ForwardIt& it, std::size_t count, int& height)
+{
+	if (count == 0) {
+		height = 0;
 		return NULL;
 	}
 
-	Node<Key, Value>* current_ = root_;
+	std::size_t leftCount = (count - 1) / 2;
+	int leftHeight, rightHeight;
+
+	Node<Key, Value>* left = buildSubtree(it, leftCount, leftHeight);
+	Node<Key, Value>* node;
+	try {
+		node = makeNode(NULL, *it);
+	} catch (...) {
+		if (left != NULL) {
+			clearHelper(left);
+		}
+		throw;
+	}
+	node->setLeft(left);
+	if (left != NULL) {
+		left->setParent(node);
+	}
+
+	Node<Key, Value>* right;
+	try {
+		++it;
+		right = buildSubtree(it, count - 1 - leftCount, rightHeight);
+	} catch (...) {
+		clearHelper(node);
+		throw;
+	}
+	node->setRight(right);
+	if (right != NULL) {
+		right->setParent(node);
+	}
+
+	height = std::max(leftHeight, rightHeight) + 1;
+	builtSubtree(node, leftHeight, rightHeight);
+	return node;
+}
+
+/**
+* Creates a node of the tree's own type under parent, with its item
+* constructed in place as std::pair<const Key, Value>(args...) would be.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename... Args>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::makeNode(Node<Key, Value>* parent, Args&&... args)
+{
+	auto build = [&](void* where) {
+		::new (where) std::pair<const Key, Value>(std::forward<Args>(args)...);
+	};
+	return constructNode(ItemBuilder<Key, Value>(build), parent);
+}
+
+/**
+* Creates a node of the tree's own type whose item build constructs;
+* AVLTree and friends override this.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::constructNode(const ItemBuilder<Key, Value>& build,
+	Node<Key, Value>* parent)
+{
+	return createNode<Node<Key, Value> >(build, parent);
+}
+
+/**
+* Called right after a new node is linked in.
+* The tree will not remain balanced, so there is nothing to do.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::insertFixup(Node<Key, Value>* /*node*/)
+{
+
+}
+
+/**
+* Called when an insert or operator[] lands on a key that is already in
+* the tree, so SplayTree can splay it. Other trees keep their shape.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::accessFixup(Node<Key, Value>* /*node*/)
+{
+
+}
+
+/**
+* Called once a node's subtrees are linked in by buildFromSorted().
+* A plain BST keeps no per-node bookkeeping, so there is nothing to do.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::builtSubtree(Node<Key, Value>* /*node*/,
+	int /*leftHeight*/, int /*rightHeight*/)
+{
+
+}
+
+/**
+* Called by validate() for every node with its subtree heights; returns
+* NULL if the node is consistent, else what is wrong with it.
+* A plain BST keeps no per-node bookkeeping to check.
+*/
+template<typename Key, typename Value, typename Compare>
+const char* BinarySearchTree<Key, Value, Compare>::checkNode(const Node<Key, Value>* /*node*/,
+    int /*leftHeight*/, int /*rightHeight*/) const
+{
+    return NULL;
+}
+
+/**
+* Lets derived trees hand out iterators to their own nodes.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::iteratorAt(Node<Key, Value>* node) const
+{
+	return iterator(node, this);
+}
+
+/**
+* Recomputes the cached smallest and largest nodes by walking
+* both spines. Used after the tree is rebuilt wholesale.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::resetBounds()
+{
+	minNode_ = root_;
+	maxNode_ = root_;
+	if (root_ == NULL) {
+		return;
+	}
+	while (minNode_->getLeft() != NULL) {
+		minNode_ = minNode_->getLeft();
+	}
+	while (maxNode_->getRight() != NULL) {
+		maxNode_ = maxNode_->getRight();
+	}
+}
+
+template<typename Key, typename Value, typename Compare>
+const std::size_t BinarySearchTree<Key, Value, Compare>::UNKNOWN_COUNT;
+
+/**
+* Makes the subtree at root the whole tree. The caller has already taken
+* the old nodes elsewhere; count may be UNKNOWN_COUNT, in which case
+* size() counts the nodes the next time it is asked.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::adoptSubtree(Node<Key, Value>* root, std::size_t count)
+{
+	root_ = root;
+	if (root_ != NULL) {
+		root_->setParent(NULL);
+	}
+	nodeCount_ = count;
+	countValid_ = (count != UNKNOWN_COUNT);
+	countedSize_.store(UNKNOWN_COUNT, std::memory_order_relaxed);
+	resetBounds();
+}
 
-	// smallest node will be at the leftmost node on the bst
-	while (current_->getLeft() != NULL) {
-		current_ = current_->getLeft();
+/**
+* Returns the item count if it is known without walking the tree, and
+* UNKNOWN_COUNT otherwise, so that O(log n) operations can pass it along.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t BinarySearchTree<Key, Value, Compare>::knownCount() const
+{
+	if (countValid_) {
+		return nodeCount_;
 	}
+	return countedSize_.load(std::memory_order_relaxed);
+}
+
+/**
+* Takes over a count that size() has made since the count was lost, before
+* the tree changes; if there is none the count simply stays unknown.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::settleCount()
+{
+	if (!countValid_) {
+		nodeCount_ = countedSize_.load(std::memory_order_relaxed);
+		countValid_ = (nodeCount_ != UNKNOWN_COUNT);
+	}
+}
+
+/**
+* Keeps the cached bounds valid when node (which has at most one
+* child) is about to be unlinked from the tree.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::boundsBeforeUnlink(Node<Key, Value>* node)
+{
+	if (node == minNode_) {
+		minNode_ = successor(node);
+	}
+	if (node == maxNode_) {
+		maxNode_ = predecessor(node);
+	}
+}
+
+/**
+* Runs the destructor of a node whose most derived type is NodeT.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename NodeT>
+void BinarySearchTree<Key, Value, Compare>::destroyAs(Node<Key, Value>* node)
+{
+	static_cast<NodeT*>(node)->~NodeT();
+}
+
+/**
+* Destroys a node and hands its storage back to the pool.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::destroyNode(Node<Key, Value>* node)
+{
+	destroyer_(node);
+	pool_->deallocate(node);
+	settleCount();
+	--nodeCount_;
+	BST_COUNT(DEALLOCATIONS);
+}
 
-	return current_;
+/**
+* Returns true if clear() may drop the pool's slabs without visiting
+* every node: no destructors need to run and no other tree shares the pool.
+*/
+template<typename Key, typename Value, typename Compare>
+bool BinarySearchTree<Key, Value, Compare>::canReleaseSlabs() const
+{
+	return pool_.use_count() == 1 &&
+		std::is_trivially_destructible<Key>::value &&
+		std::is_trivially_destructible<Value>::value;
+}
+
+/**
+* A helper function to find the smallest node in the tree.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::getSmallestNode() const
+{
+    // TODO
+	// the leftmost node is cached as the tree changes
+	return minNode_;
+}
+
+/**
+* Returns the largest node in O(1) (the cached rightmost node)
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::getLargestNode() const
+{
+	return maxNode_;
 }
 
 /**
@@ -687,55 +1900,228 @@ BinarySearchTree<Key, Value>::getSmallestNode() const
 * return a pointer to it or NULL if no item with that key
 * exists
 */
-template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalFind(const Key& key) const
 {
     // TODO
-	if (root_ == NULL) {
-		return NULL;
-	}
+	return findNode(key);
+}
 
+/**
+* The lookup behind internalFind() and the heterogeneous find().
+* Only "key < node" is asked on the way down: going right remembers the
+* node as the last one not greater than key, and a single check at the
+* bottom tells whether that node is equal. That is one comparison per
+* level instead of up to three.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::findNode(const K& key) const
+{
 	Node<Key, Value>* current_ = root_;
+	Node<Key, Value>* candidate = NULL;
 
 	while (current_ != NULL) {
-		if (key < current_->getKey()) {
+		BST_COUNT(NODE_VISITS);
+		BST_COUNT(COMPARISONS);
+		if (comp_(key, current_->getKey())) {
 			current_ = current_->getLeft();
+		} else {
+			candidate = current_;
+			current_ = current_->getRight();
 		}
+	}
+
+	// if nothing found, return NULL
+	BST_COUNT(COMPARISONS);
+	if (candidate != NULL && !comp_(candidate->getKey(), key)) {
+		return candidate;
+	}
+	return NULL;
+}
+
+/**
+* Starts loading node into the cache. A node can straddle two cache
+* lines, so both ends are touched.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::prefetchNode(const Node<Key, Value>* node)
+{
+    const char* bytes = reinterpret_cast<const char*>(node);
+    __builtin_prefetch(bytes);
+    __builtin_prefetch(bytes + sizeof(Node<Key, Value>) - 1);
+}
 
-		else if (key > current_->getKey()) {
+/**
+* Finds the first node whose key is not less than key, or NULL.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::lowerBoundNode(const Key& key) const
+{
+	Node<Key, Value>* current_ = root_;
+	Node<Key, Value>* result = NULL;
+
+	while (current_ != NULL) {
+		BST_COUNT(NODE_VISITS);
+		BST_COUNT(COMPARISONS);
+		if (comp_(current_->getKey(), key)) {
 			current_ = current_->getRight();
+		} else {
+			result = current_;
+			current_ = current_->getLeft();
 		}
+	}
+	return result;
+}
+
+/**
+* Finds the first node whose key is greater than key, or NULL.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::upperBoundNode(const Key& key) const
+{
+	Node<Key, Value>* current_ = root_;
+	Node<Key, Value>* result = NULL;
 
-		else if (key == current_->getKey()) {
-			return current_;
+	while (current_ != NULL) {
+		BST_COUNT(NODE_VISITS);
+		BST_COUNT(COMPARISONS);
+		if (comp_(key, current_->getKey())) {
+			result = current_;
+			current_ = current_->getLeft();
+		} else {
+			current_ = current_->getRight();
 		}
 	}
-
-	// if nothing found, return NULL
-	return NULL;
+	return result;
 }
 
 /**
  * Return true if the BST is balanced.
+ * Subtree heights come from one O(n) pass (see validate()).
  */
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalanced() const
+template<typename Key, typename Value, typename Compare>
+bool BinarySearchTree<Key, Value, Compare>::isBalanced() const
 {
-	if (root_ == NULL) {
-		return true;
-	}
+	return validate().heightBalanced;
+}
 
-	return balancedHelper(root_);
+/**
+* Checks the whole tree in one iterative O(n) pass: keys strictly
+* increase in order, every child points back at its parent, the cached
+* count and bounds match, and checkNode() accepts every node (AVLTree
+* checks its balance factors there). Gathers the shape statistics along
+* the way. The walk keeps one frame per level on the heap, so degenerate
+* trees cannot overflow the call stack. It stops early only if a parent
+* link is wrong, since the child links may then not form a tree.
+*/
+template<typename Key, typename Value, typename Compare>
+TreeShape BinarySearchTree<Key, Value, Compare>::validate() const
+{
+    struct Frame
+    {
+        const Node<Key, Value>* node;
+        int leftHeight;
+        int stage;
+    };
+
+    TreeShape shape;
+    if (root_ != NULL && root_->getParent() != NULL) {
+        shape.problem = "the root has a parent";
+        return shape;
+    }
+
+    std::vector<Frame> frames;
+    const Node<Key, Value>* first = NULL;
+    const Node<Key, Value>* prev = NULL;
+    double depthSum = 0;
+    int childHeight = 0;
+    if (root_ != NULL) {
+        Frame rootFrame = { root_, 0, 0 };
+        frames.push_back(rootFrame);
+    }
+
+    while (!frames.empty()) {
+        Frame& frame = frames.back();
+        const Node<Key, Value>* node = frame.node;
+        const Node<Key, Value>* child = NULL;
+
+        if (frame.stage == 0) {
+            // entering node, one level below its parent
+            int depth = static_cast<int>(frames.size()) - 1;
+            ++shape.nodes;
+            depthSum += depth;
+            shape.maxDepth = std::max(shape.maxDepth, depth);
+            if (node->getLeft() == NULL && node->getRight() == NULL) {
+                if (shape.leafDepths.size() <= static_cast<std::size_t>(depth)) {
+                    shape.leafDepths.resize(depth + 1, 0);
+                }
+                ++shape.leafDepths[depth];
+            }
+            frame.stage = 1;
+            child = node->getLeft();
+            childHeight = 0;
+        } else if (frame.stage == 1) {
+            // left subtree done: visit node in order
+            frame.leftHeight = childHeight;
+            if (first == NULL) {
+                first = node;
+            }
+            if (prev != NULL && !comp_(prev->getKey(), node->getKey()) && shape.problem == NULL) {
+                shape.problem = "keys are not in increasing order";
+            }
+            prev = node;
+            frame.stage = 2;
+            child = node->getRight();
+            childHeight = 0;
+        } else {
+            // both subtrees done
+            int leftHeight = frame.leftHeight;
+            int rightHeight = childHeight;
+            if (std::abs(leftHeight - rightHeight) > 1) {
+                shape.heightBalanced = false;
+            }
+            const char* problem = checkNode(node, leftHeight, rightHeight);
+            if (problem != NULL && shape.problem == NULL) {
+                shape.problem = problem;
+            }
+            childHeight = std::max(leftHeight, rightHeight) + 1;
+            frames.pop_back();
+            continue;
+        }
+
+        if (child != NULL) {
+            if (child->getParent() != node) {
+                shape.problem = "a child does not point back at its parent";
+                return shape;
+            }
+            Frame childFrame = { child, 0, 0 };
+            frames.push_back(childFrame);
+        }
+    }
+
+    shape.height = childHeight;
+    if (shape.nodes > 0) {
+        shape.averageDepth = depthSum / shape.nodes;
+    }
+    if (shape.problem == NULL && (first != minNode_ || prev != maxNode_)) {
+        shape.problem = "the cached smallest or largest node is stale";
+    }
+    if (shape.problem == NULL && countValid_ && nodeCount_ != shape.nodes) {
+        shape.problem = "the cached node count is wrong";
+    }
+    return shape;
 }
 
 
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
 {
     if((n1 == n2) || (n1 == NULL) || (n2 == NULL) ) {
         return;
     }
+    BST_COUNT(NODE_SWAPS);
     Node<Key, Value>* n1p = n1->getParent();
     Node<Key, Value>* n1r = n1->getRight();
     Node<Key, Value>* n1lt = n1->getLeft();
@@ -0,0 +1,103 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+/**
+* Encodes one key or value for BinarySearchTree::serialize() and decodes
+* it again for deserialize(). A codec is any type with
+*
+*     static void write(std::ostream& out, const T& value);
+*     static T read(std::istream& in);
+*
+* read() reports a short or malformed record by failing the stream. The
+* default codec copies the bytes of trivially copyable types, so such
+* streams are only readable on machines with the same layout and byte
+* order. Other types need a specialization of Codec<T> (std::string has
+* one below) or a codec passed to serialize()/deserialize() explicitly.
+*/
+template <typename T>
+struct Codec
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+        "no default Codec for this type: specialize Codec<T> or pass a codec");
+
+    static void write(std::ostream& out, const T& value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    static T read(std::istream& in)
+    {
+        T value;
+        in.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return value;
+    }
+};
+
+/**
+* Strings are a 64-bit length followed by the characters. Long strings
+* are read a chunk at a time, so a corrupt length fails on the short
+* stream instead of allocating it all up front.
+*/
+template <>
+struct Codec<std::string>
+{
+    static void write(std::ostream& out, const std::string& value)
+    {
+        Codec<uint64_t>::write(out, value.size());
+        out.write(value.data(), value.size());
+    }
+
+    static std::string read(std::istream& in)
+    {
+        uint64_t length = Codec<uint64_t>::read(in);
+        std::string value;
+        while (in && value.size() < length) {
+            char chunk[4096];
+            std::size_t want = length - value.size() < sizeof(chunk) ? length - value.size() : sizeof(chunk);
+            in.read(chunk, want);
+            value.append(chunk, static_cast<std::size_t>(in.gcount()));
+        }
+        return value;
+    }
+};
+
+/**
+* The header in front of a serialized tree: a magic string, the format
+* version and the number of records that follow.
+*/
+inline void writeTreeStreamHeader(std::ostream& out, uint64_t count)
+{
+    out.write("BSTSTRM", 8);
+    Codec<uint32_t>::write(out, 1);
+    Codec<uint64_t>::write(out, count);
+}
+
+/**
+* Reads the header written by writeTreeStreamHeader() and returns the
+* record count. Throws std::runtime_error if it is missing or unknown.
+*/
+inline uint64_t readTreeStreamHeader(std::istream& in)
+{
+    char magic[8];
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, "BSTSTRM", 8) != 0) {
+        throw std::runtime_error("deserialize: not a serialized tree");
+    }
+    uint32_t version = Codec<uint32_t>::read(in);
+    uint64_t count = Codec<uint64_t>::read(in);
+    if (!in || version != 1) {
+        throw std::runtime_error("deserialize: unsupported stream version");
+    }
+    return count;
+}
+
+#endif
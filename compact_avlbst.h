@@ -0,0 +1,761 @@
+#ifndef COMPACT_AVLBST_H
+#define COMPACT_AVLBST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/**
+* A node of a CompactAVLTree. Children are 31-bit indices into the
+* tree's node vector and there is no parent link. The top bit of each
+* child index says whether that side is the taller one, so the balance
+* costs no space at all: with 8 byte keys and values a node is 24 bytes,
+* against 48 for an AVLNode.
+*/
+template <typename Key, typename Value>
+class CompactAVLNode
+{
+public:
+    static const uint32_t NIL = 0x7fffffff;
+
+    explicit CompactAVLNode(const std::pair<const Key, Value>& item);
+    CompactAVLNode(CompactAVLNode<Key, Value>&& other);
+
+    const std::pair<const Key, Value>& getItem() const;
+    std::pair<const Key, Value>& getItem();
+    const Key& getKey() const;
+
+    uint32_t getLeft() const;
+    uint32_t getRight() const;
+    void setLeft(uint32_t left);
+    void setRight(uint32_t right);
+
+    int8_t getBalance() const;
+    void setBalance(int8_t balance);
+
+protected:
+    static const uint32_t TALLER = 0x80000000;
+
+    std::pair<const Key, Value> item_;
+    uint32_t left_;
+    uint32_t right_;
+};
+
+/*
+  ---------------------------------------------------
+  Begin implementations for the CompactAVLNode class.
+  ---------------------------------------------------
+*/
+
+/**
+* Explicit constructor for a balanced leaf.
+*/
+template<typename Key, typename Value>
+CompactAVLNode<Key, Value>::CompactAVLNode(const std::pair<const Key, Value>& item) :
+    item_(item),
+    left_(NIL),
+    right_(NIL)
+{
+
+}
+
+/**
+* Move constructor, used when the node vector grows or a node is
+* relocated to fill a hole.
+*/
+template<typename Key, typename Value>
+CompactAVLNode<Key, Value>::CompactAVLNode(CompactAVLNode<Key, Value>&& other) :
+    item_(std::move(other.item_)),
+    left_(other.left_),
+    right_(other.right_)
+{
+
+}
+
+/**
+* A const getter for the item.
+*/
+template<typename Key, typename Value>
+const std::pair<const Key, Value>& CompactAVLNode<Key, Value>::getItem() const
+{
+    return item_;
+}
+
+/**
+* A non-const getter for the item.
+*/
+template<typename Key, typename Value>
+std::pair<const Key, Value>& CompactAVLNode<Key, Value>::getItem()
+{
+    return item_;
+}
+
+/**
+* A const getter for the key.
+*/
+template<typename Key, typename Value>
+const Key& CompactAVLNode<Key, Value>::getKey() const
+{
+    return item_.first;
+}
+
+/**
+* A getter for the index of the left child (NIL if none).
+*/
+template<typename Key, typename Value>
+uint32_t CompactAVLNode<Key, Value>::getLeft() const
+{
+    return left_ & NIL;
+}
+
+/**
+* A getter for the index of the right child (NIL if none).
+*/
+template<typename Key, typename Value>
+uint32_t CompactAVLNode<Key, Value>::getRight() const
+{
+    return right_ & NIL;
+}
+
+/**
+* A setter for the left child that keeps the balance bit.
+*/
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setLeft(uint32_t left)
+{
+    left_ = (left_ & TALLER) | left;
+}
+
+/**
+* A setter for the right child that keeps the balance bit.
+*/
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setRight(uint32_t right)
+{
+    right_ = (right_ & TALLER) | right;
+}
+
+/**
+* A getter for the balance (right height - left height).
+*/
+template<typename Key, typename Value>
+int8_t CompactAVLNode<Key, Value>::getBalance() const
+{
+    return static_cast<int8_t>((right_ >> 31) - (left_ >> 31));
+}
+
+/**
+* A setter for the balance, which must be -1, 0 or 1.
+*/
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setBalance(int8_t balance)
+{
+    left_ = (left_ & NIL) | (balance < 0 ? TALLER : 0);
+    right_ = (right_ & NIL) | (balance > 0 ? TALLER : 0);
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the CompactAVLNode class.
+  -------------------------------------------------
+*/
+
+
+/**
+* An AVL tree whose nodes live in one std::vector and link to each other
+* by 32-bit index (see CompactAVLNode). Nodes are packed: a removed node's
+* slot is filled by moving the last node into it, so the vector holds
+* exactly size() nodes and clear() or destruction frees them in one go.
+* Searches walk a dense array of small nodes instead of pool slabs of
+* large ones.
+*
+* There are no parent links, so the iterator keeps the path of nodes
+* still to come, in a fixed array since the height is bounded. Both
+* insert() and remove() invalidate iterators. At most 2^31 - 1 items.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class CompactAVLTree
+{
+public:
+    class iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type* pointer;
+        typedef value_type& reference;
+
+        iterator();
+
+        std::pair<const Key, Value>& operator*() const;
+        std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class CompactAVLTree<Key, Value, Compare>;
+        void pushLeftSpine(uint32_t node);
+
+        const CompactAVLTree<Key, Value, Compare>* tree_;
+        // an AVL tree of 2^31 nodes is at most 45 levels tall
+        uint32_t path_[48];
+        uint32_t depth_;
+    };
+
+    CompactAVLTree();
+    explicit CompactAVLTree(const Compare& comp);
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    void reserve(std::size_t count);
+
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator begin() const;
+    iterator end() const;
+    std::size_t size() const;
+    bool empty() const;
+    bool isBalanced() const;
+
+protected:
+    typedef CompactAVLNode<Key, Value> CNode;
+    static const uint32_t NIL = CNode::NIL;
+
+    std::pair<const Key, Value>& itemAt(uint32_t node) const;
+
+    uint32_t rotateLeft(uint32_t node);
+    uint32_t rotateRight(uint32_t node);
+    uint32_t rotateTwice(uint32_t node, bool leftTaller);
+    uint32_t grewOn(uint32_t node, bool left, bool& grew);
+    uint32_t shrankOn(uint32_t node, bool left, bool& shrank);
+
+    uint32_t insertNode(uint32_t node, const std::pair<const Key, Value>& item, bool& grew);
+    uint32_t removeNode(uint32_t node, const Key& key, bool& shrank, uint32_t& removed);
+    uint32_t removeMin(uint32_t node, uint32_t& min, bool& shrank);
+    void releaseSlot(uint32_t slot);
+    int heightHelper(uint32_t node) const;
+
+    std::vector<CNode> nodes_;
+    uint32_t root_;
+    Compare comp_;
+};
+
+/*
+  ---------------------------------------------------
+  Begin implementations for the CompactAVLTree class.
+  ---------------------------------------------------
+*/
+
+/**
+* Default constructor for an end() iterator.
+*/
+template<class Key, class Value, class Compare>
+CompactAVLTree<Key, Value, Compare>::iterator::iterator() :
+    tree_(NULL),
+    depth_(0)
+{
+
+}
+
+/**
+* Provides access to the item.
+*/
+template<class Key, class Value, class Compare>
+std::pair<const Key, Value>&
+CompactAVLTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return tree_->itemAt(path_[depth_ - 1]);
+}
+
+/**
+* Provides access to the address of the item.
+*/
+template<class Key, class Value, class Compare>
+std::pair<const Key, Value>*
+CompactAVLTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &(tree_->itemAt(path_[depth_ - 1]));
+}
+
+/**
+* Checks if 'this' iterator's internals have the same value as 'rhs'
+*/
+template<class Key, class Value, class Compare>
+bool CompactAVLTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    if (depth_ == 0 || rhs.depth_ == 0) {
+        return depth_ == rhs.depth_;
+    }
+    return path_[depth_ - 1] == rhs.path_[rhs.depth_ - 1];
+}
+
+/**
+* Checks if 'this' iterator's internals have a different value as 'rhs'
+*/
+template<class Key, class Value, class Compare>
+bool CompactAVLTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Advances the iterator to the next item in order.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator&
+CompactAVLTree<Key, Value, Compare>::iterator::operator++()
+{
+    --depth_;
+    pushLeftSpine(tree_->nodes_[path_[depth_]].getRight());
+    return *this;
+}
+
+/**
+* Pushes node and its chain of left children onto the path.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::iterator::pushLeftSpine(uint32_t node)
+{
+    while (node != NIL) {
+        path_[depth_++] = node;
+        node = tree_->nodes_[node].getLeft();
+    }
+}
+
+/**
+* Default constructor
+*/
+template<class Key, class Value, class Compare>
+CompactAVLTree<Key, Value, Compare>::CompactAVLTree() :
+    root_(NIL),
+    comp_()
+{
+
+}
+
+/**
+* Constructor that orders keys with comp.
+*/
+template<class Key, class Value, class Compare>
+CompactAVLTree<Key, Value, Compare>::CompactAVLTree(const Compare& comp) :
+    root_(NIL),
+    comp_(comp)
+{
+
+}
+
+/**
+* Inserts key/value, overwriting the value if the key exists.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    bool grew = false;
+    root_ = insertNode(root_, keyValuePair, grew);
+}
+
+/**
+* Removes the item with key, if any, and moves the last node into its
+* slot.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+    bool shrank = false;
+    uint32_t removed = NIL;
+    root_ = removeNode(root_, key, shrank, removed);
+    if (removed != NIL) {
+        releaseSlot(removed);
+    }
+}
+
+/**
+* Deletes every item at once.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::clear()
+{
+    nodes_.clear();
+    root_ = NIL;
+}
+
+/**
+* Makes room for count items, so inserting that many never reallocates.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::reserve(std::size_t count)
+{
+    nodes_.reserve(count);
+}
+
+/**
+* Returns an iterator to the item with key, or end().
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::find(const Key& key) const
+{
+    iterator it = lower_bound(key);
+    if (it.depth_ != 0 && comp_(key, it->first)) {
+        return end();
+    }
+    return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    iterator it;
+    it.tree_ = this;
+    uint32_t node = root_;
+    while (node != NIL) {
+        const CNode& curr = nodes_[node];
+        if (comp_(curr.getKey(), key)) {
+            node = curr.getRight();
+        } else {
+            it.path_[it.depth_++] = node;
+            node = curr.getLeft();
+        }
+    }
+    return it;
+}
+
+/**
+* Returns an iterator to the smallest item.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::begin() const
+{
+    iterator it;
+    it.tree_ = this;
+    it.pushLeftSpine(root_);
+    return it;
+}
+
+/**
+* Returns the end iterator.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::end() const
+{
+    return iterator();
+}
+
+/**
+* Returns the number of items.
+*/
+template<class Key, class Value, class Compare>
+std::size_t CompactAVLTree<Key, Value, Compare>::size() const
+{
+    return nodes_.size();
+}
+
+/**
+* Returns true if there are no items.
+*/
+template<class Key, class Value, class Compare>
+bool CompactAVLTree<Key, Value, Compare>::empty() const
+{
+    return nodes_.empty();
+}
+
+/**
+* Return true iff every node's subtrees differ in height by at most one
+* and every stored balance is right.
+*/
+template<class Key, class Value, class Compare>
+bool CompactAVLTree<Key, Value, Compare>::isBalanced() const
+{
+    return heightHelper(root_) >= 0;
+}
+
+/**
+* The item of a node. Like BinarySearchTree, a const tree hands out
+* iterators through which values may be changed.
+*/
+template<class Key, class Value, class Compare>
+std::pair<const Key, Value>& CompactAVLTree<Key, Value, Compare>::itemAt(uint32_t node) const
+{
+    return const_cast<CNode&>(nodes_[node]).getItem();
+}
+
+/**
+* Rotates node's right child above it; returns the new subtree root.
+* Balances are left to the caller.
+*/
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::rotateLeft(uint32_t node)
+{
+    uint32_t child = nodes_[node].getRight();
+    nodes_[node].setRight(nodes_[child].getLeft());
+    nodes_[child].setLeft(node);
+    return child;
+}
+
+/**
+* Rotates node's left child above it; returns the new subtree root.
+* Balances are left to the caller.
+*/
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::rotateRight(uint32_t node)
+{
+    uint32_t child = nodes_[node].getLeft();
+    nodes_[node].setLeft(nodes_[child].getRight());
+    nodes_[child].setRight(node);
+    return child;
+}
+
+/**
+* The double rotation for a node whose taller child leans the other way.
+* Fixes all three balances and returns the new subtree root.
+*/
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::rotateTwice(uint32_t node, bool leftTaller)
+{
+    uint32_t child = leftTaller ? nodes_[node].getLeft() : nodes_[node].getRight();
+    uint32_t grandchild = leftTaller ? nodes_[child].getRight() : nodes_[child].getLeft();
+    int8_t balance = nodes_[grandchild].getBalance();
+
+    if (leftTaller) {
+        nodes_[node].setLeft(rotateLeft(child));
+        rotateRight(node);
+        nodes_[child].setBalance(balance > 0 ? -1 : 0);
+        nodes_[node].setBalance(balance < 0 ? 1 : 0);
+    } else {
+        nodes_[node].setRight(rotateRight(child));
+        rotateLeft(node);
+        nodes_[child].setBalance(balance < 0 ? 1 : 0);
+        nodes_[node].setBalance(balance > 0 ? -1 : 0);
+    }
+    nodes_[grandchild].setBalance(0);
+    return grandchild;
+}
+
+/**
+* Retrace after node's left (or right) subtree grew by one level.
+* Returns the subtree root and sets grew if node's subtree grew too.
+*/
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::grewOn(uint32_t node, bool left, bool& grew)
+{
+    int8_t side = left ? -1 : 1;
+    int8_t balance = nodes_[node].getBalance();
+    if (balance != side) {
+        nodes_[node].setBalance(balance + side);
+        grew = (balance == 0);
+        return node;
+    }
+
+    grew = false;
+    uint32_t child = left ? nodes_[node].getLeft() : nodes_[node].getRight();
+    if (nodes_[child].getBalance() == side) {
+        uint32_t top = left ? rotateRight(node) : rotateLeft(node);
+        nodes_[node].setBalance(0);
+        nodes_[top].setBalance(0);
+        return top;
+    }
+    return rotateTwice(node, left);
+}
+
+/**
+* Retrace after node's left (or right) subtree shrank by one level.
+* Returns the subtree root and sets shrank if node's subtree shrank too.
+*/
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::shrankOn(uint32_t node, bool left, bool& shrank)
+{
+    // the side that is now relatively taller
+    int8_t side = left ? 1 : -1;
+    int8_t balance = nodes_[node].getBalance();
+    if (balance != side) {
+        nodes_[node].setBalance(balance + side);
+        shrank = (balance != 0);
+        return node;
+    }
+
+    uint32_t child = left ? nodes_[node].getRight() : nodes_[node].getLeft();
+    int8_t childBalance = nodes_[child].getBalance();
+    if (childBalance == -side) {
+        shrank = true;
+        return rotateTwice(node, !left);
+    }
+
+    uint32_t top = left ? rotateLeft(node) : rotateRight(node);
+    if (childBalance == 0) {
+        nodes_[node].setBalance(side);
+        nodes_[top].setBalance(-side);
+        shrank = false;
+    } else {
+        nodes_[node].setBalance(0);
+        nodes_[top].setBalance(0);
+        shrank = true;
+    }
+    return top;
+}
+
+/**
+* Inserts item below node and returns the new subtree root.
+* Note that nodes_ may reallocate, so no references are held across
+* the recursion. The index NIL means "no child", so a new node that
+* would get it throws std::length_error before anything changes.
+*/
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::insertNode(uint32_t node,
+    const std::pair<const Key, Value>& item, bool& grew)
+{
+    if (node == NIL) {
+        if (nodes_.size() >= NIL) {
+            throw std::length_error("CompactAVLTree: too many items");
+        }
+        nodes_.push_back(CNode(item));
+        grew = true;
+        return static_cast<uint32_t>(nodes_.size() - 1);
+    }
+
+    if (comp_(item.first, nodes_[node].getKey())) {
+        uint32_t left = insertNode(nodes_[node].getLeft(), item, grew);
+        nodes_[node].setLeft(left);
+        return grew ? grewOn(node, true, grew) : node;
+    }
+    if (comp_(nodes_[node].getKey(), item.first)) {
+        uint32_t right = insertNode(nodes_[node].getRight(), item, grew);
+        nodes_[node].setRight(right);
+        return grew ? grewOn(node, false, grew) : node;
+    }
+    nodes_[node].getItem().second = item.second;
+    grew = false;
+    return node;
+}
+
+/**
+* Unlinks key from below node and returns the new subtree root. The
+* unlinked node's slot is reported in removed; it still holds the item.
+*/
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::removeNode(uint32_t node, const Key& key,
+    bool& shrank, uint32_t& removed)
+{
+    if (node == NIL) {
+        shrank = false;
+        return NIL;
+    }
+
+    if (comp_(key, nodes_[node].getKey())) {
+        nodes_[node].setLeft(removeNode(nodes_[node].getLeft(), key, shrank, removed));
+        return shrank ? shrankOn(node, true, shrank) : node;
+    }
+    if (comp_(nodes_[node].getKey(), key)) {
+        nodes_[node].setRight(removeNode(nodes_[node].getRight(), key, shrank, removed));
+        return shrank ? shrankOn(node, false, shrank) : node;
+    }
+
+    removed = node;
+    uint32_t left = nodes_[node].getLeft();
+    uint32_t right = nodes_[node].getRight();
+    if (left == NIL || right == NIL) {
+        shrank = true;
+        return left == NIL ? right : left;
+    }
+
+    // two children: the successor node takes this node's place
+    uint32_t min = NIL;
+    right = removeMin(right, min, shrank);
+    nodes_[min].setLeft(left);
+    nodes_[min].setRight(right);
+    nodes_[min].setBalance(nodes_[node].getBalance());
+    return shrank ? shrankOn(min, false, shrank) : min;
+}
+
+/**
+* Unlinks the smallest node below node, reporting it in min, and
+* returns the new subtree root.
+*/
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::removeMin(uint32_t node, uint32_t& min, bool& shrank)
+{
+    if (nodes_[node].getLeft() == NIL) {
+        min = node;
+        shrank = true;
+        return nodes_[node].getRight();
+    }
+    nodes_[node].setLeft(removeMin(nodes_[node].getLeft(), min, shrank));
+    return shrank ? shrankOn(node, true, shrank) : node;
+}
+
+/**
+* Destroys the unlinked node in slot and moves the last node into the
+* hole, relinking it from its parent (found by searching for its key),
+* so that the vector stays packed.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::releaseSlot(uint32_t slot)
+{
+    uint32_t last = static_cast<uint32_t>(nodes_.size() - 1);
+    if (slot != last) {
+        const Key& key = nodes_[last].getKey();
+        if (root_ == last) {
+            root_ = slot;
+        } else {
+            uint32_t parent = root_;
+            for (;;) {
+                CNode& curr = nodes_[parent];
+                bool goLeft = comp_(key, curr.getKey());
+                uint32_t child = goLeft ? curr.getLeft() : curr.getRight();
+                if (child == last) {
+                    if (goLeft) {
+                        curr.setLeft(slot);
+                    } else {
+                        curr.setRight(slot);
+                    }
+                    break;
+                }
+                parent = child;
+            }
+        }
+        nodes_[slot].~CNode();
+        new (&nodes_[slot]) CNode(std::move(nodes_[last]));
+    }
+    nodes_.pop_back();
+}
+
+/**
+* Returns the height below node, or -1 if the subtree is not a valid
+* AVL tree.
+*/
+template<class Key, class Value, class Compare>
+int CompactAVLTree<Key, Value, Compare>::heightHelper(uint32_t node) const
+{
+    if (node == NIL) {
+        return 0;
+    }
+    int leftHeight = heightHelper(nodes_[node].getLeft());
+    int rightHeight = heightHelper(nodes_[node].getRight());
+    if (leftHeight < 0 || rightHeight < 0 || rightHeight - leftHeight != nodes_[node].getBalance()) {
+        return -1;
+    }
+    return 1 + (leftHeight > rightHeight ? leftHeight : rightHeight);
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the CompactAVLTree class.
+  -------------------------------------------------
+*/
+
+#endif
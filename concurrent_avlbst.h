@@ -0,0 +1,747 @@
+#ifndef CONCURRENT_AVLBST_H
+#define CONCURRENT_AVLBST_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include "avlbst.h"
+
+/**
+* The node type of a ConcurrentAVLTree. Writers relink nodes through the
+* plain links every AVLNode has, so the shared AVLTree code runs as is;
+* lock-free readers follow a second pair of links, which are atomics and
+* are only brought up to date by publishLinks(). That keeps the atomics
+* (and their ordering constraints) out of every other tree.
+*/
+template <typename Key, typename Value>
+class ConcurrentAVLNode : public AVLNode<Key, Value>
+{
+public:
+    ConcurrentAVLNode(const ItemBuilder<Key, Value>& build, AVLNode<Key, Value>* parent);
+    ~ConcurrentAVLNode();
+
+    // The children readers see, as of the last publishLinks()
+    ConcurrentAVLNode<Key, Value>* getReadLeft() const;
+    ConcurrentAVLNode<Key, Value>* getReadRight() const;
+    void publishLinks();
+
+protected:
+    std::atomic<ConcurrentAVLNode<Key, Value>*> readLeft_;
+    std::atomic<ConcurrentAVLNode<Key, Value>*> readRight_;
+};
+
+/*
+  ------------------------------------------------------
+  Begin implementations for the ConcurrentAVLNode class.
+  ------------------------------------------------------
+*/
+
+/**
+* Constructor for a node whose readers see no children yet.
+*/
+template<class Key, class Value>
+ConcurrentAVLNode<Key, Value>::ConcurrentAVLNode(const ItemBuilder<Key, Value>& build, AVLNode<Key, Value>* parent) :
+    AVLNode<Key, Value>(build, parent),
+    readLeft_(NULL),
+    readRight_(NULL)
+{
+
+}
+
+/**
+* Destructor.
+*/
+template<class Key, class Value>
+ConcurrentAVLNode<Key, Value>::~ConcurrentAVLNode()
+{
+
+}
+
+/**
+* A getter for the left child as readers see it.
+*/
+template<class Key, class Value>
+ConcurrentAVLNode<Key, Value>* ConcurrentAVLNode<Key, Value>::getReadLeft() const
+{
+    return readLeft_.load(std::memory_order_acquire);
+}
+
+/**
+* A getter for the right child as readers see it.
+*/
+template<class Key, class Value>
+ConcurrentAVLNode<Key, Value>* ConcurrentAVLNode<Key, Value>::getReadRight() const
+{
+    return readRight_.load(std::memory_order_acquire);
+}
+
+/**
+* Copies the writer's links to the reader links. Only the writer stores
+* to them, so unchanged links are left alone without a store.
+*/
+template<class Key, class Value>
+void ConcurrentAVLNode<Key, Value>::publishLinks()
+{
+    ConcurrentAVLNode<Key, Value>* left = static_cast<ConcurrentAVLNode<Key, Value>*>(this->left_);
+    ConcurrentAVLNode<Key, Value>* right = static_cast<ConcurrentAVLNode<Key, Value>*>(this->right_);
+    if (readLeft_.load(std::memory_order_relaxed) != left) {
+        readLeft_.store(left, std::memory_order_release);
+    }
+    if (readRight_.load(std::memory_order_relaxed) != right) {
+        readRight_.store(right, std::memory_order_release);
+    }
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the ConcurrentAVLNode class.
+  ----------------------------------------------------
+*/
+
+/**
+* An AVLTree that many threads can read while one thread at a time writes.
+*
+* Writers (insert, remove, clear) are serialized by a mutex and bump a
+* sequence number to an odd value while they rotate and relink nodes.
+* Readers take no locks. They note the sequence number, walk the tree and
+* copy out what they found, then retry if a writer ran in the meantime
+* (the usual seqlock protocol). Since a walk may overlap a write, all it
+* reads is either atomic or fixed for as long as the walk can reach it:
+* readers follow the atomic reader links of ConcurrentAVLNode, which each
+* write publishes for the nodes it may have relinked, they find the root
+* through an atomic of their own, and items are never written in place, because
+* giving a key a new value swaps in a new node. Walks are also cut off
+* after MAX_READ_STEPS steps, in case a rotation briefly forms a cycle.
+*
+* A removed node may still be on a reader's path, so its memory is not
+* reused straight away. The pool holds it back (deferred reuse) and a
+* writer recycles it once every reader that could have seen it is done.
+* For that, each lookup holds one of READER_SLOTS slots stamped with the
+* sequence number it started from.
+*
+* Removed nodes are still destroyed at once, so Key and Value must be
+* trivially copyable. Results are returned by value.
+* Iteration is weakly consistent: each step is a separate lock-free
+* upper_bound, so it sees every item that is present throughout the walk,
+* and it may or may not see concurrent changes.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class ConcurrentAVLTree : private AVLTree<Key, Value, Compare>
+{
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+        "ConcurrentAVLTree readers copy items optimistically, so Key and Value must be trivially copyable");
+
+public:
+    class iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type* pointer;
+        typedef const value_type& reference;
+
+        iterator();
+
+        const std::pair<Key, Value>& operator*() const;
+        const std::pair<Key, Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class ConcurrentAVLTree<Key, Value, Compare>;
+        iterator(const ConcurrentAVLTree<Key, Value, Compare>* tree);
+        const ConcurrentAVLTree<Key, Value, Compare>* tree_;
+        std::pair<Key, Value> item_;
+        bool atEnd_;
+    };
+
+    ConcurrentAVLTree();
+
+    // Writers, serialized with each other
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+
+    // Lock-free readers
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    bool lower_bound(const Key& key, std::pair<Key, Value>& item) const;
+    bool upper_bound(const Key& key, std::pair<Key, Value>& item) const;
+    std::size_t size() const;
+    bool empty() const;
+    iterator begin() const;
+    iterator end() const;
+
+protected:
+    // a valid AVL tree in memory is far shallower than this
+    static const int MAX_READ_STEPS = 128;
+    // lookups running at once beyond this many wait for a slot
+    static const std::size_t READER_SLOTS = 64;
+    // removed nodes to collect before a writer tries to recycle them
+    static const std::size_t RECYCLE_BATCH = 64;
+
+    // Marks the tree as changing while it is alive
+    class WriteSection
+    {
+    public:
+        explicit WriteSection(ConcurrentAVLTree<Key, Value, Compare>& tree);
+        ~WriteSection();
+    private:
+        ConcurrentAVLTree<Key, Value, Compare>& tree_;
+        std::lock_guard<std::mutex> lock_;
+        std::size_t waitingBefore_;
+    };
+
+    // Holds a reader slot while alive
+    class ReadSection
+    {
+    public:
+        explicit ReadSection(const ConcurrentAVLTree<Key, Value, Compare>& tree);
+        ~ReadSection();
+    private:
+        std::atomic<uint64_t>* slot_;
+    };
+
+    // 0 while free, else 1 + the sequence number its reader started from;
+    // padded to a cache line so readers do not share one
+    struct ReaderSlot
+    {
+        std::atomic<uint64_t> since;
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    bool findBound(const Key& key, bool strictlyGreater, std::pair<Key, Value>& item) const;
+    bool smallest(std::pair<Key, Value>& item) const;
+    virtual Node<Key, Value>* constructNode(const ItemBuilder<Key, Value>& build, Node<Key, Value>* parent);
+    void publishPath(Node<Key, Value>* node);
+    void replaceNode(Node<Key, Value>* old, const std::pair<const Key, Value>& item);
+    void recycleNodes();
+    static std::size_t homeSlot();
+
+    mutable std::mutex writeMutex_;
+    std::atomic<uint64_t> sequence_;
+    std::atomic<std::size_t> count_;
+    // the root as of the last finished write, for readers
+    std::atomic<ConcurrentAVLNode<Key, Value>*> readRoot_;
+    mutable ReaderSlot readers_[READER_SLOTS];
+    // per write that removed nodes: its sequence number and how many
+    std::deque<std::pair<uint64_t, std::size_t> > retired_;
+};
+
+/*
+  -------------------------------------------------------
+  Begin implementations for the ConcurrentAVLTree class.
+  -------------------------------------------------------
+*/
+
+/**
+* Default constructor for an end() iterator.
+*/
+template<class Key, class Value, class Compare>
+ConcurrentAVLTree<Key, Value, Compare>::iterator::iterator() :
+    tree_(NULL),
+    item_(),
+    atEnd_(true)
+{
+
+}
+
+/**
+* Constructor for an iterator at the smallest item in tree (or end()).
+*/
+template<class Key, class Value, class Compare>
+ConcurrentAVLTree<Key, Value, Compare>::iterator::iterator(const ConcurrentAVLTree<Key, Value, Compare>* tree) :
+    tree_(tree),
+    item_(),
+    atEnd_(!tree->smallest(item_))
+{
+
+}
+
+/**
+* Provides access to the copy of the current item.
+*/
+template<class Key, class Value, class Compare>
+const std::pair<Key, Value>&
+ConcurrentAVLTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return item_;
+}
+
+/**
+* Provides access to the address of the copy of the current item.
+*/
+template<class Key, class Value, class Compare>
+const std::pair<Key, Value>*
+ConcurrentAVLTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &item_;
+}
+
+/**
+* Iterators are equal when both are at the end or at the same key.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    if (atEnd_ || rhs.atEnd_) {
+        return atEnd_ == rhs.atEnd_;
+    }
+    return !tree_->comp_(item_.first, rhs.item_.first) && !tree_->comp_(rhs.item_.first, item_.first);
+}
+
+/**
+* Inverse of operator==.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Moves to the smallest key greater than the current one, as the tree is now.
+*/
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::iterator&
+ConcurrentAVLTree<Key, Value, Compare>::iterator::operator++()
+{
+    if (!atEnd_) {
+        Key current = item_.first;
+        atEnd_ = !tree_->upper_bound(current, item_);
+    }
+    return *this;
+}
+
+/**
+* Starts writing: takes the writer lock, makes the sequence number odd and
+* recycles the removed nodes no reader can reach any more.
+*/
+template<class Key, class Value, class Compare>
+ConcurrentAVLTree<Key, Value, Compare>::WriteSection::WriteSection(ConcurrentAVLTree<Key, Value, Compare>& tree) :
+    tree_(tree),
+    lock_(tree.writeMutex_),
+    waitingBefore_(0)
+{
+    // Reader link changes are release stores, so a reader that sees one
+    // sees the odd number too. seq_cst pairs it with the slot stamps read next.
+    tree_.sequence_.store(tree_.sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+    tree_.recycleNodes();
+    waitingBefore_ = tree_.pool_->waitingBlocks();
+}
+
+/**
+* Finishes writing: notes the nodes it removed, publishes the root and the
+* count, and makes the sequence number even.
+*/
+template<class Key, class Value, class Compare>
+ConcurrentAVLTree<Key, Value, Compare>::WriteSection::~WriteSection()
+{
+    uint64_t sequence = tree_.sequence_.load(std::memory_order_relaxed);
+    std::size_t removed = tree_.pool_->waitingBlocks() - waitingBefore_;
+    if (removed > 0) {
+        tree_.retired_.push_back(std::make_pair(sequence, removed));
+    }
+    tree_.count_.store(tree_.AVLTree<Key, Value, Compare>::size(), std::memory_order_relaxed);
+    tree_.readRoot_.store(static_cast<ConcurrentAVLNode<Key, Value>*>(tree_.root_), std::memory_order_release);
+    tree_.sequence_.store(sequence + 1, std::memory_order_release);
+}
+
+/**
+* Takes a free reader slot, stamped with the current sequence number.
+* Each thread starts looking at a slot of its own.
+*/
+template<class Key, class Value, class Compare>
+ConcurrentAVLTree<Key, Value, Compare>::ReadSection::ReadSection(const ConcurrentAVLTree<Key, Value, Compare>& tree) :
+    slot_(NULL)
+{
+    uint64_t since = tree.sequence_.load(std::memory_order_relaxed) + 1;
+    for (std::size_t i = homeSlot(); ; ++i) {
+        std::atomic<uint64_t>& slot = tree.readers_[i % READER_SLOTS].since;
+        uint64_t free = 0;
+        // seq_cst pairs with the writer's: if its scan missed this slot,
+        // the walk will see that writer's odd sequence number
+        if (slot.load(std::memory_order_relaxed) == 0 &&
+            slot.compare_exchange_strong(free, since, std::memory_order_seq_cst)) {
+            slot_ = &slot;
+            return;
+        }
+        if (i % READER_SLOTS == READER_SLOTS - 1) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+/**
+* Frees the slot. The release orders the lookup's reads before any reuse
+* of the nodes it saw.
+*/
+template<class Key, class Value, class Compare>
+ConcurrentAVLTree<Key, Value, Compare>::ReadSection::~ReadSection()
+{
+    slot_->store(0, std::memory_order_release);
+}
+
+/**
+* Default constructor
+*/
+template<class Key, class Value, class Compare>
+ConcurrentAVLTree<Key, Value, Compare>::ConcurrentAVLTree() :
+    AVLTree<Key, Value, Compare>(sizeof(ConcurrentAVLNode<Key, Value>),
+        &BinarySearchTree<Key, Value, Compare>::template destroyAs<ConcurrentAVLNode<Key, Value> >,
+        std::shared_ptr<NodePool>(), Compare()),
+    sequence_(0),
+    count_(0),
+    readRoot_(NULL)
+{
+    for (std::size_t i = 0; i < READER_SLOTS; ++i) {
+        readers_[i].since.store(0, std::memory_order_relaxed);
+    }
+    this->pool_->setDeferredReuse(true);
+}
+
+/**
+* Inserts or overwrites an item, blocking other writers (not readers).
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    WriteSection section(*this);
+    Node<Key, Value>* parent;
+    bool asLeft;
+    Node<Key, Value>* found = this->findInsertPoint(keyValuePair.first, parent, asLeft);
+    if (found != NULL) {
+        replaceNode(found, keyValuePair);
+    } else {
+        Node<Key, Value>* node = this->makeNode(parent, keyValuePair);
+        this->linkNode(node, parent, asLeft);
+        publishPath(node);
+    }
+}
+
+/**
+* Removes the item with key, if any, blocking other writers (not readers).
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+    WriteSection section(*this);
+    Node<Key, Value>* node = this->internalFind(key);
+    if (node == NULL) {
+        return;
+    }
+
+    // AVLTree::remove() swaps a node with two children with its
+    // predecessor and unlinks it from the predecessor's old spot, so the
+    // rebalancing starts from the parent of that spot
+    Node<Key, Value>* start = node->getParent();
+    if (node->getLeft() != NULL && node->getRight() != NULL) {
+        Node<Key, Value>* pred = this->predecessor(node);
+        start = pred->getParent() == node ? pred : pred->getParent();
+    }
+    AVLTree<Key, Value, Compare>::remove(key);
+    publishPath(start);
+}
+
+/**
+* Removes every item. The nodes go back to the pool one by one to wait for
+* recycling, rather than dropping the slabs, since readers may still be
+* walking them.
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::clear()
+{
+    WriteSection section(*this);
+    this->clearHelper(this->root_);
+    this->adoptSubtree(NULL, 0);
+}
+
+/**
+* Copies the value stored under key into value.
+* Returns false (leaving value alone) if there is no such key.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::find(const Key& key, Value& value) const
+{
+    std::pair<Key, Value> item;
+    if (!findBound(key, false, item) || this->comp_(key, item.first)) {
+        return false;
+    }
+    value = item.second;
+    return true;
+}
+
+/**
+* Returns whether key is in the tree.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::contains(const Key& key) const
+{
+    Value value;
+    return find(key, value);
+}
+
+/**
+* Copies the first item whose key is not less than key into item.
+* Returns false if there is none.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::lower_bound(const Key& key, std::pair<Key, Value>& item) const
+{
+    return findBound(key, false, item);
+}
+
+/**
+* Copies the first item whose key is greater than key into item.
+* Returns false if there is none.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::upper_bound(const Key& key, std::pair<Key, Value>& item) const
+{
+    return findBound(key, true, item);
+}
+
+/**
+* Returns the number of items as of the last finished write.
+*/
+template<class Key, class Value, class Compare>
+std::size_t ConcurrentAVLTree<Key, Value, Compare>::size() const
+{
+    return count_.load(std::memory_order_relaxed);
+}
+
+/**
+* Returns true if there were no items as of the last finished write.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::empty() const
+{
+    return size() == 0;
+}
+
+/**
+* Returns an iterator at the smallest item
+*/
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::iterator
+ConcurrentAVLTree<Key, Value, Compare>::begin() const
+{
+    return iterator(this);
+}
+
+/**
+* Returns the end iterator
+*/
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::iterator
+ConcurrentAVLTree<Key, Value, Compare>::end() const
+{
+    return iterator();
+}
+
+/**
+* The optimistic descent behind every reader: finds the first item whose
+* key is greater than key (strictlyGreater) or not less than key, and
+* retries until no writer ran during the walk.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::findBound(const Key& key, bool strictlyGreater,
+    std::pair<Key, Value>& item) const
+{
+    ReadSection section(*this);
+    for (;;) {
+        uint64_t before = sequence_.load(std::memory_order_seq_cst);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        bool found = false;
+        std::pair<Key, Value> candidate;
+        ConcurrentAVLNode<Key, Value>* curr = readRoot_.load(std::memory_order_acquire);
+        int steps = 0;
+        while (curr != NULL && steps < MAX_READ_STEPS) {
+            Key currKey = curr->getKey();
+            bool goLeft = strictlyGreater ? this->comp_(key, currKey) : !this->comp_(currKey, key);
+            if (goLeft) {
+                candidate = curr->getItem();
+                found = true;
+                curr = curr->getReadLeft();
+            } else {
+                curr = curr->getReadRight();
+            }
+            ++steps;
+        }
+
+        // the links were acquire loads, so this load cannot move above them
+        if (curr == NULL && sequence_.load(std::memory_order_acquire) == before) {
+            if (found) {
+                item = candidate;
+            }
+            return found;
+        }
+    }
+}
+
+/**
+* Copies the smallest item into item; returns false if the tree is empty.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::smallest(std::pair<Key, Value>& item) const
+{
+    ReadSection section(*this);
+    for (;;) {
+        uint64_t before = sequence_.load(std::memory_order_seq_cst);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        ConcurrentAVLNode<Key, Value>* curr = readRoot_.load(std::memory_order_acquire);
+        ConcurrentAVLNode<Key, Value>* last = NULL;
+        std::pair<Key, Value> candidate;
+        int steps = 0;
+        while (curr != NULL && steps < MAX_READ_STEPS) {
+            last = curr;
+            curr = curr->getReadLeft();
+            ++steps;
+        }
+        if (last != NULL) {
+            candidate = last->getItem();
+        }
+
+        if (curr == NULL && sequence_.load(std::memory_order_acquire) == before) {
+            if (last != NULL) {
+                item = candidate;
+            }
+            return last != NULL;
+        }
+    }
+}
+
+/**
+* Gives an existing key a new value without writing to a node readers may
+* be copying from: a new node takes over old's place, links and balance,
+* and old is removed.
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::replaceNode(Node<Key, Value>* old,
+    const std::pair<const Key, Value>& item)
+{
+    AVLNode<Key, Value>* oldNode = static_cast<AVLNode<Key, Value>*>(old);
+    AVLNode<Key, Value>* parent = oldNode->getParent();
+    AVLNode<Key, Value>* node = static_cast<AVLNode<Key, Value>*>(
+        this->makeNode(parent, item));
+    node->setBalance(oldNode->getBalance());
+    node->setSize(oldNode->getSize());
+    node->setLeft(oldNode->getLeft());
+    node->setRight(oldNode->getRight());
+    if (node->getLeft() != NULL) {
+        node->getLeft()->setParent(node);
+    }
+    if (node->getRight() != NULL) {
+        node->getRight()->setParent(node);
+    }
+
+    if (parent == NULL) {
+        this->root_ = node;
+    } else if (parent->getLeft() == oldNode) {
+        parent->setLeft(node);
+    } else {
+        parent->setRight(node);
+    }
+    if (this->minNode_ == oldNode) {
+        this->minNode_ = node;
+    }
+    if (this->maxNode_ == oldNode) {
+        this->maxNode_ = node;
+    }
+    this->destroyNode(oldNode);
+    publishPath(node);
+}
+
+/**
+* Nodes of a ConcurrentAVLTree carry the reader links.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* ConcurrentAVLTree<Key, Value, Compare>::constructNode(const ItemBuilder<Key, Value>& build,
+    Node<Key, Value>* parent)
+{
+    return this->template createNode<ConcurrentAVLNode<Key, Value> >(build,
+        static_cast<AVLNode<Key, Value>*>(parent));
+}
+
+/**
+* Publishes the reader links of node, its ancestors and their children.
+* An insert or remove only relinks nodes on the path from where it
+* started rebalancing (node) to the root, and the nodes a rotation there
+* moves down, which end up as children of that path. O(log n).
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::publishPath(Node<Key, Value>* node)
+{
+    for (; node != NULL; node = node->getParent()) {
+        static_cast<ConcurrentAVLNode<Key, Value>*>(node)->publishLinks();
+        if (node->getLeft() != NULL) {
+            static_cast<ConcurrentAVLNode<Key, Value>*>(node->getLeft())->publishLinks();
+        }
+        if (node->getRight() != NULL) {
+            static_cast<ConcurrentAVLNode<Key, Value>*>(node->getRight())->publishLinks();
+        }
+    }
+}
+
+/**
+* Recycles removed nodes no reader can still be on. Nodes removed by the
+* write at sequence number w are safe once every slot in use was stamped
+* after it finished. The slots are only read once enough nodes wait.
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::recycleNodes()
+{
+    if (this->pool_->waitingBlocks() < RECYCLE_BATCH) {
+        return;
+    }
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    for (std::size_t i = 0; i < READER_SLOTS; ++i) {
+        uint64_t since = readers_[i].since.load(std::memory_order_seq_cst);
+        if (since != 0 && since < oldest) {
+            oldest = since;
+        }
+    }
+
+    std::size_t ready = 0;
+    while (!retired_.empty() && retired_.front().first + 1 < oldest) {
+        ready += retired_.front().second;
+        retired_.pop_front();
+    }
+    this->pool_->recycle(ready);
+}
+
+/**
+* The slot each thread tries first, spreading threads over the slots.
+*/
+template<class Key, class Value, class Compare>
+std::size_t ConcurrentAVLTree<Key, Value, Compare>::homeSlot()
+{
+    static std::atomic<std::size_t> threads(0);
+    static thread_local std::size_t home = threads.fetch_add(1, std::memory_order_relaxed);
+    return home;
+}
+
+/*
+  -----------------------------------------------------
+  End implementations for the ConcurrentAVLTree class.
+  -----------------------------------------------------
+*/
+
+#endif
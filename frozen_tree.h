@@ -0,0 +1,309 @@
+#ifndef FROZEN_TREE_H
+#define FROZEN_TREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "simd_search.h"
+
+/**
+* A minimal allocator whose blocks start on a cache line, so that every
+* FrozenTree key block is exactly one line.
+*/
+template <typename T>
+class CacheAlignedAllocator
+{
+public:
+    typedef T value_type;
+    static const std::size_t ALIGNMENT = 64;
+
+    CacheAlignedAllocator() { }
+    template<typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U>&) { }
+
+    T* allocate(std::size_t n);
+    void deallocate(T* p, std::size_t n);
+};
+
+/**
+* Over-allocates by one cache line and stores the offset to the real
+* block just in front of the aligned pointer.
+*/
+template<typename T>
+T* CacheAlignedAllocator<T>::allocate(std::size_t n)
+{
+    char* raw = static_cast<char*>(::operator new(n * sizeof(T) + ALIGNMENT));
+    std::size_t offset = ALIGNMENT - reinterpret_cast<std::uintptr_t>(raw) % ALIGNMENT;
+    char* aligned = raw + offset;
+    aligned[-1] = static_cast<char>(offset);
+    return reinterpret_cast<T*>(aligned);
+}
+
+/**
+* Frees a block handed out by allocate().
+*/
+template<typename T>
+void CacheAlignedAllocator<T>::deallocate(T* p, std::size_t)
+{
+    char* aligned = reinterpret_cast<char*>(p);
+    ::operator delete(aligned - static_cast<unsigned char>(aligned[-1]));
+}
+
+template<typename T, typename U>
+bool operator==(const CacheAlignedAllocator<T>&, const CacheAlignedAllocator<U>&) { return true; }
+template<typename T, typename U>
+bool operator!=(const CacheAlignedAllocator<T>&, const CacheAlignedAllocator<U>&) { return false; }
+
+
+template <class Key, class Value, class Compare>
+class MappedTree;
+
+/**
+* An immutable ordered map laid out for lookups, built once from sorted
+* items (see AVLTree::freeze()).
+*
+* The items are kept in key order in one array, so iterators are plain
+* random access iterators into it. Searches run over a separate copy of
+* the keys laid out as a static B-tree: blocks of WIDTH keys (one cache
+* line, see BlockSearch) in Eytzinger (BFS) order, so block b's children
+* are blocks b * (WIDTH + 1) + 1 ... b * (WIDTH + 1) + WIDTH + 1 and
+* every level of the descent costs a single cache line. Arithmetic keys
+* compare a whole block with SIMD instructions. The last block is padded
+* with copies of the largest key, and ranks_ maps each slot back to its
+* item (padding maps to end()). With keys of 64 bytes or more a block is
+* one key and this is plain Eytzinger order.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class FrozenTree
+{
+public:
+    typedef typename std::vector<std::pair<const Key, Value> >::const_iterator iterator;
+
+    FrozenTree();
+    template<typename InputIt>
+    FrozenTree(InputIt first, InputIt last, const Compare& comp = Compare());
+
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    iterator begin() const;
+    iterator end() const;
+    std::size_t size() const;
+    bool empty() const;
+
+protected:
+    template<class K, class V, class C>
+    friend class MappedTree;
+
+    typedef BlockSearch<Key, Compare> Search;
+    static const std::size_t WIDTH = Search::WIDTH;
+
+    void fillBlock(std::size_t block, std::size_t& rank);
+    template<bool Strict>
+    std::size_t searchSlot(const Key& key) const;
+    template<bool Strict>
+    static std::size_t searchBlocks(const Key* keys, std::size_t blocks, const Key& key, const Compare& comp);
+    iterator itemAt(std::size_t slot) const;
+
+    // key order
+    std::vector<std::pair<const Key, Value> > items_;
+    // WIDTH keys per block, blocks in Eytzinger order
+    std::vector<Key, CacheAlignedAllocator<Key> > keys_;
+    std::vector<uint32_t> ranks_;
+    std::size_t blocks_;
+    Compare comp_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the FrozenTree class.
+  -----------------------------------------------
+*/
+
+/**
+* Default constructor for an empty map.
+*/
+template<class Key, class Value, class Compare>
+FrozenTree<Key, Value, Compare>::FrozenTree() :
+    blocks_(0),
+    comp_()
+{
+
+}
+
+/**
+* Builds the map from items in strictly increasing key order.
+*/
+template<class Key, class Value, class Compare>
+template<typename InputIt>
+FrozenTree<Key, Value, Compare>::FrozenTree(InputIt first, InputIt last, const Compare& comp) :
+    items_(first, last),
+    blocks_(0),
+    comp_(comp)
+{
+    std::size_t n = items_.size();
+    if (n > std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("FrozenTree: too many items");
+    }
+    if (n == 0) {
+        return;
+    }
+
+    blocks_ = (n + WIDTH - 1) / WIDTH;
+    keys_.assign(blocks_ * WIDTH, items_[n - 1].first);
+    ranks_.assign(blocks_ * WIDTH, static_cast<uint32_t>(n));
+    std::size_t rank = 0;
+    fillBlock(0, rank);
+}
+
+/**
+* Hands out the next ranks to the slots of block and its subtrees, in
+* order. Slots left over once every item is placed stay padding.
+*/
+template<class Key, class Value, class Compare>
+void FrozenTree<Key, Value, Compare>::fillBlock(std::size_t block, std::size_t& rank)
+{
+    if (block >= blocks_) {
+        return;
+    }
+    for (std::size_t i = 0; i <= WIDTH; ++i) {
+        fillBlock(block * (WIDTH + 1) + i + 1, rank);
+        if (i < WIDTH && rank < items_.size()) {
+            keys_[block * WIDTH + i] = items_[rank].first;
+            ranks_[block * WIDTH + i] = static_cast<uint32_t>(rank);
+            ++rank;
+        }
+    }
+}
+
+/**
+* Returns an iterator to the item with key, or end().
+*/
+template<class Key, class Value, class Compare>
+typename FrozenTree<Key, Value, Compare>::iterator
+FrozenTree<Key, Value, Compare>::find(const Key& key) const
+{
+    std::size_t slot = searchSlot<false>(key);
+    if (slot == keys_.size() || comp_(key, keys_[slot])) {
+        return end();
+    }
+    return itemAt(slot);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key.
+*/
+template<class Key, class Value, class Compare>
+typename FrozenTree<Key, Value, Compare>::iterator
+FrozenTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    return itemAt(searchSlot<false>(key));
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key.
+*/
+template<class Key, class Value, class Compare>
+typename FrozenTree<Key, Value, Compare>::iterator
+FrozenTree<Key, Value, Compare>::upper_bound(const Key& key) const
+{
+    return itemAt(searchSlot<true>(key));
+}
+
+/**
+* Returns an iterator to the smallest item
+*/
+template<class Key, class Value, class Compare>
+typename FrozenTree<Key, Value, Compare>::iterator
+FrozenTree<Key, Value, Compare>::begin() const
+{
+    return items_.begin();
+}
+
+/**
+* Returns the end iterator
+*/
+template<class Key, class Value, class Compare>
+typename FrozenTree<Key, Value, Compare>::iterator
+FrozenTree<Key, Value, Compare>::end() const
+{
+    return items_.end();
+}
+
+/**
+* Returns the number of items
+*/
+template<class Key, class Value, class Compare>
+std::size_t FrozenTree<Key, Value, Compare>::size() const
+{
+    return items_.size();
+}
+
+/**
+* Returns true if there are no items
+*/
+template<class Key, class Value, class Compare>
+bool FrozenTree<Key, Value, Compare>::empty() const
+{
+    return items_.empty();
+}
+
+/**
+* Returns the slot of the first key not less than key (greater than key
+* if Strict), or keys_.size() if there is none.
+*/
+template<class Key, class Value, class Compare>
+template<bool Strict>
+std::size_t FrozenTree<Key, Value, Compare>::searchSlot(const Key& key) const
+{
+    return searchBlocks<Strict>(keys_.data(), blocks_, key, comp_);
+}
+
+/**
+* The block descent over blocks * WIDTH keys laid out as in keys_
+* (shared with MappedTree). Returns blocks * WIDTH if no slot matches.
+*/
+template<class Key, class Value, class Compare>
+template<bool Strict>
+std::size_t FrozenTree<Key, Value, Compare>::searchBlocks(const Key* keys, std::size_t blocks,
+    const Key& key, const Compare& comp)
+{
+    std::size_t answer = blocks * WIDTH;
+    std::size_t block = 0;
+    while (block < blocks) {
+        std::size_t before = Search::countBefore(keys + block * WIDTH, key, Strict, comp);
+        if (before < WIDTH) {
+            answer = block * WIDTH + before;
+        }
+        block = block * (WIDTH + 1) + before + 1;
+    }
+    return answer;
+}
+
+/**
+* Converts a slot from searchSlot into an iterator.
+*/
+template<class Key, class Value, class Compare>
+typename FrozenTree<Key, Value, Compare>::iterator
+FrozenTree<Key, Value, Compare>::itemAt(std::size_t slot) const
+{
+    if (slot == keys_.size()) {
+        return end();
+    }
+    return items_.begin() + ranks_[slot];
+}
+
+/*
+  ---------------------------------------------
+  End implementations for the FrozenTree class.
+  ---------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,392 @@
+#ifndef MAPPED_TREE_H
+#define MAPPED_TREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "frozen_tree.h"
+
+/**
+* A read-only ordered map served straight out of a memory-mapped image
+* file, so a new process can answer lookups as soon as it has mapped the
+* file: there is no deserialization, and the kernel pages the image in
+* on demand as lookups touch it.
+*
+* An image is a FrozenTree written out by write(): a header, then the
+* items in key order, the key blocks and the slot ranks, each section at
+* a 64 byte aligned offset from the start of the file. Everything is
+* addressed by offset, so the image works wherever it is mapped, and the
+* lookups run the same block descent as FrozenTree. Keys and values must
+* be trivially copyable (no pointers into the writer's heap), and an
+* image is only readable by a build with the same key and value layout
+* and byte order; the header records enough to reject anything else.
+* Compare must order keys the same way it did for the writer.
+*
+* Iterators are plain pointers into the mapping and stay valid for the
+* life of the MappedTree.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class MappedTree
+{
+public:
+    typedef const std::pair<const Key, Value>* iterator;
+
+    explicit MappedTree(const std::string& path, const Compare& comp = Compare());
+    ~MappedTree();
+
+    static void write(const FrozenTree<Key, Value, Compare>& tree, std::ostream& out);
+    static void write(const FrozenTree<Key, Value, Compare>& tree, const std::string& path);
+
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    iterator begin() const;
+    iterator end() const;
+    std::size_t size() const;
+    bool empty() const;
+
+private:
+    typedef std::pair<const Key, Value> Item;
+    typedef FrozenTree<Key, Value, Compare> Frozen;
+
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+        "MappedTree needs trivially copyable keys and values");
+
+    static const uint32_t VERSION = 1;
+    static const std::size_t ALIGNMENT = 64;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t width;
+        uint32_t keySize;
+        uint32_t valueSize;
+        uint32_t itemSize;
+        uint32_t byteOrder;
+        uint64_t count;
+        uint64_t blocks;
+        uint64_t itemsOffset;
+        uint64_t keysOffset;
+        uint64_t ranksOffset;
+        uint64_t fileSize;
+    };
+
+    // Non-copyable: the mapping belongs to exactly one tree
+    MappedTree(const MappedTree& other);
+    MappedTree& operator=(const MappedTree& other);
+
+    static void writeItems(const Frozen& tree, std::ostream& out);
+    static Header layout(std::size_t count, std::size_t blocks);
+    static uint64_t alignUp(uint64_t offset);
+    void check(bool ok, const char* what) const;
+    iterator itemAt(std::size_t slot) const;
+
+    void* base_;
+    std::size_t length_;
+    const Item* items_;
+    const Key* keys_;
+    const uint32_t* ranks_;
+    std::size_t size_;
+    std::size_t blocks_;
+    Compare comp_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the MappedTree class.
+  -----------------------------------------------
+*/
+
+/**
+* Maps the image at path and checks that its header matches this
+* instantiation. Throws std::runtime_error if the file cannot be mapped
+* or is not a valid image.
+*/
+template<class Key, class Value, class Compare>
+MappedTree<Key, Value, Compare>::MappedTree(const std::string& path, const Compare& comp) :
+    base_(NULL),
+    length_(0),
+    items_(NULL),
+    keys_(NULL),
+    ranks_(NULL),
+    size_(0),
+    blocks_(0),
+    comp_(comp)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("MappedTree: cannot open " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < sizeof(Header)) {
+        ::close(fd);
+        throw std::runtime_error("MappedTree: not a tree image: " + path);
+    }
+    length_ = static_cast<std::size_t>(st.st_size);
+    void* base = ::mmap(NULL, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("MappedTree: cannot map " + path);
+    }
+    base_ = base;
+
+    Header header;
+    std::memcpy(&header, base_, sizeof(Header));
+    Header expected = layout(header.count, header.blocks);
+    check(std::memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0, "not a tree image");
+    check(header.version == VERSION, "unsupported image version");
+    check(header.byteOrder == expected.byteOrder, "image has the wrong byte order");
+    check(header.width == expected.width && header.keySize == expected.keySize &&
+        header.valueSize == expected.valueSize && header.itemSize == expected.itemSize,
+        "image was written for another key or value type");
+    check(header.count <= std::numeric_limits<uint32_t>::max() &&
+        header.blocks == (header.count + Frozen::WIDTH - 1) / Frozen::WIDTH,
+        "image counts are inconsistent");
+    check(header.itemsOffset == expected.itemsOffset && header.keysOffset == expected.keysOffset &&
+        header.ranksOffset == expected.ranksOffset && header.fileSize == expected.fileSize &&
+        header.fileSize <= length_, "image is truncated or corrupt");
+
+    const char* bytes = static_cast<const char*>(base_);
+    items_ = reinterpret_cast<const Item*>(bytes + header.itemsOffset);
+    keys_ = reinterpret_cast<const Key*>(bytes + header.keysOffset);
+    ranks_ = reinterpret_cast<const uint32_t*>(bytes + header.ranksOffset);
+    size_ = static_cast<std::size_t>(header.count);
+    blocks_ = static_cast<std::size_t>(header.blocks);
+}
+
+/**
+* Destructor: unmaps the image
+*/
+template<class Key, class Value, class Compare>
+MappedTree<Key, Value, Compare>::~MappedTree()
+{
+    if (base_ != NULL) {
+        ::munmap(base_, length_);
+    }
+}
+
+/**
+* Writes tree as an image to out. Throws std::runtime_error if the
+* stream fails.
+*/
+template<class Key, class Value, class Compare>
+void MappedTree<Key, Value, Compare>::write(const FrozenTree<Key, Value, Compare>& tree, std::ostream& out)
+{
+    const Header header = layout(tree.items_.size(), tree.blocks_);
+    const char zeros[ALIGNMENT] = {};
+    uint64_t written = 0;
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    written += sizeof(Header);
+
+    out.write(zeros, header.itemsOffset - written);
+    writeItems(tree, out);
+    written = header.itemsOffset + tree.items_.size() * sizeof(Item);
+
+    out.write(zeros, header.keysOffset - written);
+    out.write(reinterpret_cast<const char*>(tree.keys_.data()), tree.keys_.size() * sizeof(Key));
+    written = header.keysOffset + tree.keys_.size() * sizeof(Key);
+
+    out.write(zeros, header.ranksOffset - written);
+    out.write(reinterpret_cast<const char*>(tree.ranks_.data()), tree.ranks_.size() * sizeof(uint32_t));
+
+    if (!out) {
+        throw std::runtime_error("MappedTree::write: write failed");
+    }
+}
+
+/**
+* Writes the items in the image's item layout. Each one is copied field
+* by field into a zeroed record, so the padding of std::pair (between
+* the key and the value, and at the end) is written as zeros rather than
+* whatever happened to be in memory.
+*/
+template<class Key, class Value, class Compare>
+void MappedTree<Key, Value, Compare>::writeItems(const Frozen& tree, std::ostream& out)
+{
+    const std::size_t BATCH = 256;
+    char records[BATCH * sizeof(Item)];
+    for (std::size_t first = 0; first < tree.items_.size(); first += BATCH) {
+        std::size_t count = std::min(BATCH, tree.items_.size() - first);
+        std::memset(records, 0, count * sizeof(Item));
+        for (std::size_t i = 0; i < count; ++i) {
+            const Item& item = tree.items_[first + i];
+            const char* start = reinterpret_cast<const char*>(&item);
+            char* record = records + i * sizeof(Item);
+            std::memcpy(record + (reinterpret_cast<const char*>(&item.first) - start), &item.first, sizeof(Key));
+            std::memcpy(record + (reinterpret_cast<const char*>(&item.second) - start), &item.second, sizeof(Value));
+        }
+        out.write(records, count * sizeof(Item));
+    }
+}
+
+/**
+* Writes tree as an image to the file at path, replacing it.
+*/
+template<class Key, class Value, class Compare>
+void MappedTree<Key, Value, Compare>::write(const FrozenTree<Key, Value, Compare>& tree, const std::string& path)
+{
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("MappedTree::write: cannot create " + path);
+    }
+    write(tree, out);
+    out.close();
+    if (!out) {
+        throw std::runtime_error("MappedTree::write: write failed");
+    }
+}
+
+/**
+* Returns an iterator to the item with key, or end().
+*/
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator
+MappedTree<Key, Value, Compare>::find(const Key& key) const
+{
+    std::size_t slot = Frozen::template searchBlocks<false>(keys_, blocks_, key, comp_);
+    if (slot == blocks_ * Frozen::WIDTH || comp_(key, keys_[slot])) {
+        return end();
+    }
+    return itemAt(slot);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key.
+*/
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator
+MappedTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    return itemAt(Frozen::template searchBlocks<false>(keys_, blocks_, key, comp_));
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key.
+*/
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator
+MappedTree<Key, Value, Compare>::upper_bound(const Key& key) const
+{
+    return itemAt(Frozen::template searchBlocks<true>(keys_, blocks_, key, comp_));
+}
+
+/**
+* Returns an iterator to the smallest item
+*/
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator
+MappedTree<Key, Value, Compare>::begin() const
+{
+    return items_;
+}
+
+/**
+* Returns the end iterator
+*/
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator
+MappedTree<Key, Value, Compare>::end() const
+{
+    return items_ + size_;
+}
+
+/**
+* Returns the number of items
+*/
+template<class Key, class Value, class Compare>
+std::size_t MappedTree<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+/**
+* Returns true if there are no items
+*/
+template<class Key, class Value, class Compare>
+bool MappedTree<Key, Value, Compare>::empty() const
+{
+    return size_ == 0;
+}
+
+/**
+* The header of an image with count items in the given number of key
+* blocks, with every section offset worked out.
+*/
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::Header
+MappedTree<Key, Value, Compare>::layout(std::size_t count, std::size_t blocks)
+{
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(header.magic, "BSTIMG\0\0", sizeof(header.magic));
+    header.version = VERSION;
+    header.width = static_cast<uint32_t>(Frozen::WIDTH);
+    header.keySize = static_cast<uint32_t>(sizeof(Key));
+    header.valueSize = static_cast<uint32_t>(sizeof(Value));
+    header.itemSize = static_cast<uint32_t>(sizeof(Item));
+    header.byteOrder = 0x01020304;
+    header.count = count;
+    header.blocks = blocks;
+    header.itemsOffset = alignUp(sizeof(Header));
+    header.keysOffset = alignUp(header.itemsOffset + header.count * sizeof(Item));
+    header.ranksOffset = alignUp(header.keysOffset + header.blocks * Frozen::WIDTH * sizeof(Key));
+    header.fileSize = header.ranksOffset + header.blocks * Frozen::WIDTH * sizeof(uint32_t);
+    return header;
+}
+
+/**
+* Rounds offset up to the next section boundary.
+*/
+template<class Key, class Value, class Compare>
+uint64_t MappedTree<Key, Value, Compare>::alignUp(uint64_t offset)
+{
+    return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+/**
+* Unmaps the image and throws std::runtime_error unless ok.
+*/
+template<class Key, class Value, class Compare>
+void MappedTree<Key, Value, Compare>::check(bool ok, const char* what) const
+{
+    if (!ok) {
+        ::munmap(base_, length_);
+        throw std::runtime_error(std::string("MappedTree: ") + what);
+    }
+}
+
+/**
+* Converts a slot from the block search into an iterator.
+*/
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator
+MappedTree<Key, Value, Compare>::itemAt(std::size_t slot) const
+{
+    if (slot == blocks_ * Frozen::WIDTH) {
+        return end();
+    }
+    return items_ + ranks_[slot];
+}
+
+/*
+  ---------------------------------------------
+  End implementations for the MappedTree class.
+  ---------------------------------------------
+*/
+
+#endif
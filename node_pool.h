@@ -0,0 +1,238 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <cstddef>
+#include <deque>
+#include <new>
+#include <vector>
+
+/**
+* A slab allocator for fixed-size tree nodes.
+* Nodes are carved out of contiguous slabs, and freed nodes are pushed
+* onto an intrusive free list so later inserts can reuse them. Since
+* every node lives inside one of the slabs, the whole pool can be
+* dropped in O(slabs) without visiting individual nodes.
+*
+* A pool may be shared by several trees (see BinarySearchTree's pool
+* constructor) as long as its block size fits their node type.
+* The pool is not thread-safe.
+*/
+class NodePool
+{
+public:
+    explicit NodePool(std::size_t blockSize, std::size_t firstSlabBlocks = 32);
+    ~NodePool();
+
+    void* allocate();
+    void deallocate(void* block);
+    void release();
+
+    void setDeferredReuse(bool deferred);
+    std::size_t waitingBlocks() const;
+    void recycle(std::size_t count);
+
+    std::size_t blockSize() const;
+    std::size_t slabCount() const;
+    std::size_t blocksInUse() const;
+
+private:
+    // Non-copyable: the slabs are owned by exactly one pool
+    NodePool(const NodePool& other);
+    NodePool& operator=(const NodePool& other);
+
+    void addSlab();
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    // largest slab we will grow to, in blocks
+    static const std::size_t MAX_SLAB_BLOCKS = 4096;
+
+    std::size_t blockSize_;
+    std::size_t firstSlabBlocks_;
+    std::size_t nextSlabBlocks_;
+    std::vector<char*> slabs_;
+    FreeBlock* freeList_;
+    char* bumpCurr_;
+    char* bumpEnd_;
+    std::size_t blocksInUse_;
+    bool deferReuse_;
+    // freed blocks waiting for recycle(), oldest first
+    std::deque<void*> waiting_;
+};
+
+/*
+  ---------------------------------------------
+  Begin implementations for the NodePool class.
+  ---------------------------------------------
+*/
+
+/**
+* Creates an empty pool handing out blocks of (at least) blockSize bytes.
+* Slabs start at firstSlabBlocks blocks and double up to MAX_SLAB_BLOCKS.
+*/
+inline NodePool::NodePool(std::size_t blockSize, std::size_t firstSlabBlocks) :
+    blockSize_(blockSize),
+    firstSlabBlocks_(firstSlabBlocks == 0 ? 1 : firstSlabBlocks),
+    nextSlabBlocks_(firstSlabBlocks_),
+    freeList_(NULL),
+    bumpCurr_(NULL),
+    bumpEnd_(NULL),
+    blocksInUse_(0),
+    deferReuse_(false)
+{
+    // every block must be able to hold a free list link and keep the
+    // alignment of anything a node might contain
+    const std::size_t align = alignof(std::max_align_t);
+    if (blockSize_ < sizeof(FreeBlock)) {
+        blockSize_ = sizeof(FreeBlock);
+    }
+    blockSize_ = (blockSize_ + align - 1) / align * align;
+}
+
+/**
+* Destructor, which gives every slab back to the system.
+* Objects still living in the pool are NOT destroyed.
+*/
+inline NodePool::~NodePool()
+{
+    release();
+}
+
+/**
+* Returns uninitialized storage for one node.
+* Freed blocks are reused first, then the current slab is bump allocated.
+*/
+inline void* NodePool::allocate()
+{
+    void* block;
+    if (freeList_ != NULL) {
+        block = freeList_;
+        freeList_ = freeList_->next;
+    } else {
+        if (bumpCurr_ == bumpEnd_) {
+            addSlab();
+        }
+        block = bumpCurr_;
+        bumpCurr_ += blockSize_;
+    }
+    ++blocksInUse_;
+    return block;
+}
+
+/**
+* Returns a block (whose object was already destroyed) to the free list.
+*/
+inline void NodePool::deallocate(void* block)
+{
+    if (block == NULL) {
+        return;
+    }
+    if (deferReuse_) {
+        waiting_.push_back(block);
+    } else {
+        FreeBlock* freed = static_cast<FreeBlock*>(block);
+        freed->next = freeList_;
+        freeList_ = freed;
+    }
+    --blocksInUse_;
+}
+
+/**
+* Drops every slab at once. Any objects still in the pool must either
+* have been destroyed already or be trivially destructible.
+*/
+inline void NodePool::release()
+{
+    for (std::size_t i = 0; i < slabs_.size(); ++i) {
+        ::operator delete(slabs_[i]);
+    }
+    slabs_.clear();
+    waiting_.clear();
+    freeList_ = NULL;
+    bumpCurr_ = NULL;
+    bumpEnd_ = NULL;
+    blocksInUse_ = 0;
+    nextSlabBlocks_ = firstSlabBlocks_;
+}
+
+/**
+* Turns deferred reuse on or off. Blocks already waiting stay queued
+* until recycle().
+*/
+inline void NodePool::setDeferredReuse(bool deferred)
+{
+    deferReuse_ = deferred;
+}
+
+/**
+* A getter for the number of freed blocks waiting for recycle().
+*/
+inline std::size_t NodePool::waitingBlocks() const
+{
+    return waiting_.size();
+}
+
+/**
+* Moves the count longest-waiting blocks onto the free list.
+*/
+inline void NodePool::recycle(std::size_t count)
+{
+    for (; count > 0 && !waiting_.empty(); --count) {
+        FreeBlock* freed = static_cast<FreeBlock*>(waiting_.front());
+        waiting_.pop_front();
+        freed->next = freeList_;
+        freeList_ = freed;
+    }
+}
+
+/**
+* A getter for the (aligned) size of the blocks handed out.
+*/
+inline std::size_t NodePool::blockSize() const
+{
+    return blockSize_;
+}
+
+/**
+* A getter for the number of slabs currently held.
+*/
+inline std::size_t NodePool::slabCount() const
+{
+    return slabs_.size();
+}
+
+/**
+* A getter for the number of blocks allocated and not yet freed.
+*/
+inline std::size_t NodePool::blocksInUse() const
+{
+    return blocksInUse_;
+}
+
+/**
+* Grabs a new slab, doubling the slab size each time up to MAX_SLAB_BLOCKS.
+*/
+inline void NodePool::addSlab()
+{
+    std::size_t bytes = blockSize_ * nextSlabBlocks_;
+    slabs_.reserve(slabs_.size() + 1);
+    char* slab = static_cast<char*>(::operator new(bytes));
+    slabs_.push_back(slab);
+    bumpCurr_ = slab;
+    bumpEnd_ = slab + bytes;
+
+    if (nextSlabBlocks_ < MAX_SLAB_BLOCKS) {
+        nextSlabBlocks_ *= 2;
+    }
+}
+
+/*
+  -------------------------------------------
+  End implementations for the NodePool class.
+  -------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,687 @@
+#ifndef PERSISTENT_AVLBST_H
+#define PERSISTENT_AVLBST_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/**
+* An immutable node of a PersistentAVLTree.
+* Nodes are shared between versions of a tree, so they have no parent
+* pointer and never change once built; instead of a balance they store
+* their height. Every link to a node (a child pointer or a tree's root)
+* holds one reference, and the node is freed when the last one goes.
+*/
+template <typename Key, typename Value>
+class PersistentAVLNode
+{
+public:
+    PersistentAVLNode(const std::pair<const Key, Value>& item,
+        const PersistentAVLNode<Key, Value>* left, const PersistentAVLNode<Key, Value>* right);
+
+    const std::pair<const Key, Value>& getItem() const;
+    const Key& getKey() const;
+    const Value& getValue() const;
+    const PersistentAVLNode<Key, Value>* getLeft() const;
+    const PersistentAVLNode<Key, Value>* getRight() const;
+    int getHeight() const;
+
+    static int height(const PersistentAVLNode<Key, Value>* node);
+    static const PersistentAVLNode<Key, Value>* retain(const PersistentAVLNode<Key, Value>* node);
+    static void release(const PersistentAVLNode<Key, Value>* node);
+
+protected:
+    std::pair<const Key, Value> item_;
+    const PersistentAVLNode<Key, Value>* left_;
+    const PersistentAVLNode<Key, Value>* right_;
+    int height_;
+    mutable std::atomic<uint32_t> refs_;
+};
+
+/*
+  ------------------------------------------------------
+  Begin implementations for the PersistentAVLNode class.
+  ------------------------------------------------------
+*/
+
+/**
+* Explicit constructor for a node. It takes over one reference to each
+* child and starts out with the single reference its creator holds.
+*/
+template<typename Key, typename Value>
+PersistentAVLNode<Key, Value>::PersistentAVLNode(const std::pair<const Key, Value>& item,
+    const PersistentAVLNode<Key, Value>* left, const PersistentAVLNode<Key, Value>* right) :
+    item_(item),
+    left_(left),
+    right_(right),
+    height_(1 + std::max(height(left), height(right))),
+    refs_(1)
+{
+
+}
+
+/**
+* A const getter for the item.
+*/
+template<typename Key, typename Value>
+const std::pair<const Key, Value>& PersistentAVLNode<Key, Value>::getItem() const
+{
+    return item_;
+}
+
+/**
+* A const getter for the key.
+*/
+template<typename Key, typename Value>
+const Key& PersistentAVLNode<Key, Value>::getKey() const
+{
+    return item_.first;
+}
+
+/**
+* A const getter for the value.
+*/
+template<typename Key, typename Value>
+const Value& PersistentAVLNode<Key, Value>::getValue() const
+{
+    return item_.second;
+}
+
+/**
+* A getter for the left child.
+*/
+template<typename Key, typename Value>
+const PersistentAVLNode<Key, Value>* PersistentAVLNode<Key, Value>::getLeft() const
+{
+    return left_;
+}
+
+/**
+* A getter for the right child.
+*/
+template<typename Key, typename Value>
+const PersistentAVLNode<Key, Value>* PersistentAVLNode<Key, Value>::getRight() const
+{
+    return right_;
+}
+
+/**
+* A getter for the height of the subtree rooted here (a leaf is 1).
+*/
+template<typename Key, typename Value>
+int PersistentAVLNode<Key, Value>::getHeight() const
+{
+    return height_;
+}
+
+/**
+* Height of a possibly empty subtree.
+*/
+template<typename Key, typename Value>
+int PersistentAVLNode<Key, Value>::height(const PersistentAVLNode<Key, Value>* node)
+{
+    return node == NULL ? 0 : node->height_;
+}
+
+/**
+* Adds a reference to node (for a new link to it) and returns it.
+*/
+template<typename Key, typename Value>
+const PersistentAVLNode<Key, Value>* PersistentAVLNode<Key, Value>::retain(const PersistentAVLNode<Key, Value>* node)
+{
+    if (node != NULL) {
+        node->refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return node;
+}
+
+/**
+* Drops a reference to node, freeing it (and dropping its own links)
+* if that was the last one. Any thread may drop references.
+*/
+template<typename Key, typename Value>
+void PersistentAVLNode<Key, Value>::release(const PersistentAVLNode<Key, Value>* node)
+{
+    while (node != NULL && node->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        release(node->left_);
+        const PersistentAVLNode<Key, Value>* right = node->right_;
+        delete node;
+        // the right spine is walked in the loop rather than recursing
+        node = right;
+    }
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the PersistentAVLNode class.
+  ----------------------------------------------------
+*/
+
+
+/**
+* A fully persistent AVL tree. insert() and remove() copy the O(log n)
+* nodes on the path they change and share everything else with the
+* previous version, so copying a tree, and snapshot(), are O(1).
+*
+* A snapshot never changes, whatever happens to the tree it was taken
+* from, and different trees (snapshots included) can be used from
+* different threads even when they share nodes: shared nodes are
+* immutable and their reference counts are atomic. As with the other
+* trees, one tree object must not be written while anything else uses
+* it, so take snapshot() on the writer's thread and hand it over.
+*
+* Nodes are allocated with new rather than from a NodePool because the
+* last reference to a node may be dropped on any thread.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class PersistentAVLTree
+{
+public:
+    class iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type* pointer;
+        typedef const value_type& reference;
+
+        iterator();
+
+        const std::pair<const Key, Value>& operator*() const;
+        const std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class PersistentAVLTree<Key, Value, Compare>;
+        // nodes have no parent pointers, so the iterator keeps the path
+        // of nodes whose items are still to come
+        std::vector<const PersistentAVLNode<Key, Value>*> path_;
+    };
+
+    PersistentAVLTree();
+    explicit PersistentAVLTree(const Compare& comp);
+    PersistentAVLTree(const PersistentAVLTree& other);
+    PersistentAVLTree& operator=(const PersistentAVLTree& other);
+    ~PersistentAVLTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    PersistentAVLTree snapshot() const;
+
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator begin() const;
+    iterator end() const;
+    std::size_t size() const;
+    bool empty() const;
+    bool isBalanced() const;
+
+protected:
+    typedef const PersistentAVLNode<Key, Value>* NodePtr;
+
+    NodePtr makeNode(const std::pair<const Key, Value>& item, NodePtr left, NodePtr right) const;
+    NodePtr rebalance(const std::pair<const Key, Value>& item, NodePtr left, NodePtr right) const;
+    NodePtr insertNode(NodePtr node, const std::pair<const Key, Value>& item, bool& added) const;
+    NodePtr removeNode(NodePtr node, const Key& key, bool& removed) const;
+    NodePtr removeMin(NodePtr node, NodePtr& min) const;
+    bool balancedHelper(NodePtr node) const;
+
+    NodePtr root_;
+    Compare comp_;
+    std::size_t count_;
+};
+
+/*
+  ------------------------------------------------------
+  Begin implementations for the PersistentAVLTree class.
+  ------------------------------------------------------
+*/
+
+/**
+* Default constructor for an end() iterator.
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::iterator::iterator()
+{
+
+}
+
+/**
+* Provides access to the item.
+*/
+template<class Key, class Value, class Compare>
+const std::pair<const Key, Value>&
+PersistentAVLTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return path_.back()->getItem();
+}
+
+/**
+* Provides access to the address of the item.
+*/
+template<class Key, class Value, class Compare>
+const std::pair<const Key, Value>*
+PersistentAVLTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &(path_.back()->getItem());
+}
+
+/**
+* Checks if 'this' iterator's internals have the same value as 'rhs'
+*/
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    if (path_.empty() || rhs.path_.empty()) {
+        return path_.empty() == rhs.path_.empty();
+    }
+    return path_.back() == rhs.path_.back();
+}
+
+/**
+* Checks if 'this' iterator's internals have a different value as 'rhs'
+*/
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Advances the iterator to the next item in order.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator&
+PersistentAVLTree<Key, Value, Compare>::iterator::operator++()
+{
+    NodePtr node = path_.back()->getRight();
+    path_.pop_back();
+    while (node != NULL) {
+        path_.push_back(node);
+        node = node->getLeft();
+    }
+    return *this;
+}
+
+/**
+* Default constructor
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::PersistentAVLTree() :
+    root_(NULL),
+    comp_(),
+    count_(0)
+{
+
+}
+
+/**
+* Constructor that orders keys with comp.
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::PersistentAVLTree(const Compare& comp) :
+    root_(NULL),
+    comp_(comp),
+    count_(0)
+{
+
+}
+
+/**
+* Copy constructor, which shares every node with other in O(1).
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::PersistentAVLTree(const PersistentAVLTree& other) :
+    root_(PersistentAVLNode<Key, Value>::retain(other.root_)),
+    comp_(other.comp_),
+    count_(other.count_)
+{
+
+}
+
+/**
+* Assignment, which shares every node with other in O(1) and drops
+* this tree's old version.
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>&
+PersistentAVLTree<Key, Value, Compare>::operator=(const PersistentAVLTree& other)
+{
+    NodePtr old = root_;
+    root_ = PersistentAVLNode<Key, Value>::retain(other.root_);
+    comp_ = other.comp_;
+    count_ = other.count_;
+    PersistentAVLNode<Key, Value>::release(old);
+    return *this;
+}
+
+/**
+* Destructor, which frees every node no other version still uses.
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::~PersistentAVLTree()
+{
+    PersistentAVLNode<Key, Value>::release(root_);
+}
+
+/**
+* Inserts key/value, overwriting the value if the key exists.
+* Copies only the nodes on the path to the key.
+*/
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    bool added = false;
+    NodePtr old = root_;
+    root_ = insertNode(root_, keyValuePair, added);
+    PersistentAVLNode<Key, Value>::release(old);
+    if (added) {
+        ++count_;
+    }
+}
+
+/**
+* Removes the item with key, if any.
+* Copies only the nodes on the path to the key.
+*/
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+    bool removed = false;
+    NodePtr old = root_;
+    root_ = removeNode(root_, key, removed);
+    PersistentAVLNode<Key, Value>::release(old);
+    if (removed) {
+        --count_;
+    }
+}
+
+/**
+* Empties this version; snapshots keep their nodes.
+*/
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::clear()
+{
+    PersistentAVLNode<Key, Value>::release(root_);
+    root_ = NULL;
+    count_ = 0;
+}
+
+/**
+* Returns an O(1) copy of the current version, which later changes to
+* this tree do not affect.
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare> PersistentAVLTree<Key, Value, Compare>::snapshot() const
+{
+    return PersistentAVLTree(*this);
+}
+
+/**
+* Returns an iterator to the item with key, or end().
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::find(const Key& key) const
+{
+    iterator it = lower_bound(key);
+    if (it != end() && comp_(key, it->first)) {
+        return end();
+    }
+    return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    iterator it;
+    NodePtr node = root_;
+    while (node != NULL) {
+        if (comp_(node->getKey(), key)) {
+            node = node->getRight();
+        } else {
+            it.path_.push_back(node);
+            node = node->getLeft();
+        }
+    }
+    return it;
+}
+
+/**
+* Returns an iterator to the smallest item.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::begin() const
+{
+    iterator it;
+    for (NodePtr node = root_; node != NULL; node = node->getLeft()) {
+        it.path_.push_back(node);
+    }
+    return it;
+}
+
+/**
+* Returns the end iterator.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::end() const
+{
+    return iterator();
+}
+
+/**
+* Returns the number of items in this version.
+*/
+template<class Key, class Value, class Compare>
+std::size_t PersistentAVLTree<Key, Value, Compare>::size() const
+{
+    return count_;
+}
+
+/**
+* Returns true if this version has no items.
+*/
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::empty() const
+{
+    return root_ == NULL;
+}
+
+/**
+* Return true iff every node's subtrees differ in height by at most one
+* and every stored height is right.
+*/
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::isBalanced() const
+{
+    return balancedHelper(root_);
+}
+
+/**
+* Builds a new node, which takes over the references to left and right.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::NodePtr
+PersistentAVLTree<Key, Value, Compare>::makeNode(const std::pair<const Key, Value>& item,
+    NodePtr left, NodePtr right) const
+{
+    return new PersistentAVLNode<Key, Value>(item, left, right);
+}
+
+/**
+* makeNode for subtrees whose heights may differ by two, doing the
+* rotation by building new nodes. Rotated-away nodes are released, so
+* the fresh copies on the path get freed right away.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::NodePtr
+PersistentAVLTree<Key, Value, Compare>::rebalance(const std::pair<const Key, Value>& item,
+    NodePtr left, NodePtr right) const
+{
+    typedef PersistentAVLNode<Key, Value> PNode;
+    int leftHeight = PNode::height(left);
+    int rightHeight = PNode::height(right);
+
+    if (leftHeight > rightHeight + 1) {
+        NodePtr result;
+        // zig-zig
+        if (PNode::height(left->getLeft()) >= PNode::height(left->getRight())) {
+            result = makeNode(left->getItem(), PNode::retain(left->getLeft()),
+                makeNode(item, PNode::retain(left->getRight()), right));
+        }
+        // zig-zag
+        else {
+            NodePtr leftRight = left->getRight();
+            result = makeNode(leftRight->getItem(),
+                makeNode(left->getItem(), PNode::retain(left->getLeft()), PNode::retain(leftRight->getLeft())),
+                makeNode(item, PNode::retain(leftRight->getRight()), right));
+        }
+        PNode::release(left);
+        return result;
+    }
+
+    if (rightHeight > leftHeight + 1) {
+        NodePtr result;
+        if (PNode::height(right->getRight()) >= PNode::height(right->getLeft())) {
+            result = makeNode(right->getItem(),
+                makeNode(item, left, PNode::retain(right->getLeft())), PNode::retain(right->getRight()));
+        } else {
+            NodePtr rightLeft = right->getLeft();
+            result = makeNode(rightLeft->getItem(),
+                makeNode(item, left, PNode::retain(rightLeft->getLeft())),
+                makeNode(right->getItem(), PNode::retain(rightLeft->getRight()), PNode::retain(right->getRight())));
+        }
+        PNode::release(right);
+        return result;
+    }
+
+    return makeNode(item, left, right);
+}
+
+/**
+* Returns a new version of the subtree at node with item inserted
+* (the caller owns the returned reference; node itself is untouched).
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::NodePtr
+PersistentAVLTree<Key, Value, Compare>::insertNode(NodePtr node, const std::pair<const Key, Value>& item,
+    bool& added) const
+{
+    typedef PersistentAVLNode<Key, Value> PNode;
+    if (node == NULL) {
+        added = true;
+        return makeNode(item, NULL, NULL);
+    }
+
+    if (comp_(item.first, node->getKey())) {
+        return rebalance(node->getItem(), insertNode(node->getLeft(), item, added), PNode::retain(node->getRight()));
+    }
+    if (comp_(node->getKey(), item.first)) {
+        return rebalance(node->getItem(), PNode::retain(node->getLeft()), insertNode(node->getRight(), item, added));
+    }
+    return makeNode(item, PNode::retain(node->getLeft()), PNode::retain(node->getRight()));
+}
+
+/**
+* Returns a new version of the subtree at node without key.
+* If key is not there the subtree is shared as is.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::NodePtr
+PersistentAVLTree<Key, Value, Compare>::removeNode(NodePtr node, const Key& key, bool& removed) const
+{
+    typedef PersistentAVLNode<Key, Value> PNode;
+    if (node == NULL) {
+        return NULL;
+    }
+
+    if (comp_(key, node->getKey())) {
+        NodePtr left = removeNode(node->getLeft(), key, removed);
+        if (!removed) {
+            PNode::release(left);
+            return PNode::retain(node);
+        }
+        return rebalance(node->getItem(), left, PNode::retain(node->getRight()));
+    }
+    if (comp_(node->getKey(), key)) {
+        NodePtr right = removeNode(node->getRight(), key, removed);
+        if (!removed) {
+            PNode::release(right);
+            return PNode::retain(node);
+        }
+        return rebalance(node->getItem(), PNode::retain(node->getLeft()), right);
+    }
+
+    removed = true;
+    if (node->getLeft() == NULL) {
+        return PNode::retain(node->getRight());
+    }
+    if (node->getRight() == NULL) {
+        return PNode::retain(node->getLeft());
+    }
+
+    // two children: the successor takes this node's place
+    NodePtr min = NULL;
+    NodePtr right = removeMin(node->getRight(), min);
+    NodePtr result = rebalance(min->getItem(), PNode::retain(node->getLeft()), right);
+    PNode::release(min);
+    return result;
+}
+
+/**
+* Returns a new version of the subtree at node without its smallest
+* node, which is handed back (with a reference) in min.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::NodePtr
+PersistentAVLTree<Key, Value, Compare>::removeMin(NodePtr node, NodePtr& min) const
+{
+    typedef PersistentAVLNode<Key, Value> PNode;
+    if (node->getLeft() == NULL) {
+        min = PNode::retain(node);
+        return PNode::retain(node->getRight());
+    }
+    return rebalance(node->getItem(), removeMin(node->getLeft(), min), PNode::retain(node->getRight()));
+}
+
+/**
+* Checks the AVL property and the stored heights below node.
+*/
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::balancedHelper(NodePtr node) const
+{
+    typedef PersistentAVLNode<Key, Value> PNode;
+    if (node == NULL) {
+        return true;
+    }
+    int leftHeight = PNode::height(node->getLeft());
+    int rightHeight = PNode::height(node->getRight());
+    return std::abs(leftHeight - rightHeight) <= 1 &&
+        node->getHeight() == 1 + std::max(leftHeight, rightHeight) &&
+        balancedHelper(node->getLeft()) && balancedHelper(node->getRight());
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the PersistentAVLTree class.
+  ----------------------------------------------------
+*/
+
+#endif
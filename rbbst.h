@@ -0,0 +1,491 @@
+#ifndef RBBST_H
+#define RBBST_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include "bst.h"
+
+/**
+* A node of a red-black tree: a Node plus its color.
+*/
+template <typename Key, typename Value>
+class RBNode : public Node<Key, Value>
+{
+public:
+    enum Color { BLACK, RED };
+
+    // New nodes start out red, as an insert needs them
+    RBNode(const Key& key, const Value& value, RBNode<Key, Value>* parent);
+    RBNode(const ItemBuilder<Key, Value>& build, RBNode<Key, Value>* parent);
+    ~RBNode();
+
+    Color getColor() const;
+    void setColor(Color color);
+
+    // Getters for parent, left, and right that return RBNodes, as in AVLNode
+    RBNode<Key, Value>* getParent() const;
+    RBNode<Key, Value>* getLeft() const;
+    RBNode<Key, Value>* getRight() const;
+
+protected:
+    uint8_t color_;
+};
+
+/*
+  -------------------------------------------
+  Begin implementations for the RBNode class.
+  -------------------------------------------
+*/
+
+/**
+* An explicit constructor to initialize the elements by calling the base class constructor
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::RBNode(const Key& key, const Value& value, RBNode<Key, Value>* parent) :
+    Node<Key, Value>(key, value, parent), color_(RED)
+{
+
+}
+
+/**
+* A constructor whose key/value pair build constructs in place.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::RBNode(const ItemBuilder<Key, Value>& build, RBNode<Key, Value>* parent) :
+    Node<Key, Value>(build, parent), color_(RED)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::~RBNode()
+{
+
+}
+
+/**
+* A getter for the color.
+*/
+template<class Key, class Value>
+typename RBNode<Key, Value>::Color RBNode<Key, Value>::getColor() const
+{
+    return static_cast<Color>(color_);
+}
+
+/**
+* A setter for the color.
+*/
+template<class Key, class Value>
+void RBNode<Key, Value>::setColor(Color color)
+{
+    color_ = static_cast<uint8_t>(color);
+}
+
+/**
+* A getter for the parent. Every node in an RBTree is an RBNode, so a
+* static_cast is enough.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>* RBNode<Key, Value>::getParent() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->parent_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>* RBNode<Key, Value>::getLeft() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->left_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>* RBNode<Key, Value>::getRight() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------
+  End implementations for the RBNode class.
+  -----------------------------------------
+*/
+
+
+/**
+* A red-black tree. It is less strictly balanced than an AVLTree (up to
+* twice the minimum height), but an insert does at most two rotations and
+* a remove at most three, however far up the recoloring goes. Inserts,
+* lookups and iteration all come from BinarySearchTree.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class RBTree : public BinarySearchTree<Key, Value, Compare>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value, Compare>::iterator iterator;
+
+    RBTree();
+    explicit RBTree(std::shared_ptr<NodePool> pool, const Compare& comp = Compare());
+    virtual void remove(const Key& key);
+
+    bool isRedBlack() const;
+
+protected:
+    virtual void nodeSwap(RBNode<Key, Value>* n1, RBNode<Key, Value>* n2);
+    virtual Node<Key, Value>* constructNode(const ItemBuilder<Key, Value>& build, Node<Key, Value>* parent);
+    virtual void insertFixup(Node<Key, Value>* node);
+    virtual void builtSubtree(Node<Key, Value>* node, int leftHeight, int rightHeight);
+
+    void rotateLeft(RBNode<Key, Value>* node);
+    void rotateRight(RBNode<Key, Value>* node);
+    void removeFixup(RBNode<Key, Value>* node, RBNode<Key, Value>* parent);
+
+    static bool isRed(const RBNode<Key, Value>* node);
+    static int leftSpineLength(const RBNode<Key, Value>* node);
+    static int blackHeight(const RBNode<Key, Value>* node);
+};
+
+/*
+  -------------------------------------------
+  Begin implementations for the RBTree class.
+  -------------------------------------------
+*/
+
+/**
+* Default constructor, which sizes the node pool for RBNodes.
+*/
+template<class Key, class Value, class Compare>
+RBTree<Key, Value, Compare>::RBTree() :
+    BinarySearchTree<Key, Value, Compare>(sizeof(RBNode<Key, Value>),
+        &BinarySearchTree<Key, Value, Compare>::template destroyAs<RBNode<Key, Value> >,
+        std::shared_ptr<NodePool>(), Compare())
+{
+
+}
+
+/**
+* Constructor that allocates nodes from a (possibly shared) pool and
+* orders keys with comp.
+*/
+template<class Key, class Value, class Compare>
+RBTree<Key, Value, Compare>::RBTree(std::shared_ptr<NodePool> pool, const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare>(sizeof(RBNode<Key, Value>),
+        &BinarySearchTree<Key, Value, Compare>::template destroyAs<RBNode<Key, Value> >,
+        pool, comp)
+{
+
+}
+
+/**
+* Removes key, if present. As in AVLTree, a node with two children is
+* first swapped with its predecessor, so the node unlinked has at most
+* one child. Taking out a black node leaves its side one black short,
+* which removeFixup() repairs.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::remove(const Key& key)
+{
+    RBNode<Key, Value>* node = static_cast<RBNode<Key, Value>*>(this->internalFind(key));
+    if (node == NULL) {
+        return;
+    }
+
+    if (node->getLeft() != NULL && node->getRight() != NULL) {
+        nodeSwap(node, static_cast<RBNode<Key, Value>*>(this->predecessor(node)));
+    }
+
+    this->boundsBeforeUnlink(node);
+
+    RBNode<Key, Value>* parent = node->getParent();
+    RBNode<Key, Value>* child = node->getLeft() != NULL ? node->getLeft() : node->getRight();
+    if (child != NULL) {
+        child->setParent(parent);
+    }
+    if (parent == NULL) {
+        this->root_ = child;
+    } else if (parent->getLeft() == node) {
+        parent->setLeft(child);
+    } else {
+        parent->setRight(child);
+    }
+
+    bool wasBlack = !isRed(node);
+    this->destroyNode(node);
+
+    if (wasBlack) {
+        removeFixup(child, parent);
+    }
+}
+
+/**
+* Return true iff the root is black, no red node has a red child and
+* every path down to a NULL passes the same number of black nodes.
+*/
+template<class Key, class Value, class Compare>
+bool RBTree<Key, Value, Compare>::isRedBlack() const
+{
+    RBNode<Key, Value>* root = static_cast<RBNode<Key, Value>*>(this->root_);
+    return !isRed(root) && blackHeight(root) >= 0;
+}
+
+/**
+* Swaps the positions of two nodes like the BinarySearchTree version, and
+* their colors with them, so the colors stay with the tree positions.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::nodeSwap(RBNode<Key, Value>* n1, RBNode<Key, Value>* n2)
+{
+    BinarySearchTree<Key, Value, Compare>::nodeSwap(n1, n2);
+    typename RBNode<Key, Value>::Color temp = n1->getColor();
+    n1->setColor(n2->getColor());
+    n2->setColor(temp);
+}
+
+/**
+* Nodes of an RBTree are RBNodes, for both inserts and bulk loads.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* RBTree<Key, Value, Compare>::constructNode(const ItemBuilder<Key, Value>& build,
+    Node<Key, Value>* parent)
+{
+    return this->template createNode<RBNode<Key, Value> >(build, static_cast<RBNode<Key, Value>*>(parent));
+}
+
+/**
+* Restores the red-black rules after a red leaf was linked in: while the
+* parent is red too, recolor if the uncle is red (and move the problem
+* two levels up), else rotate once or twice and stop.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::insertFixup(Node<Key, Value>* linked)
+{
+    RBNode<Key, Value>* node = static_cast<RBNode<Key, Value>*>(linked);
+    while (isRed(node->getParent())) {
+        RBNode<Key, Value>* parent = node->getParent();
+        // a red parent is never the root, so there is a grandparent
+        RBNode<Key, Value>* grandparent = parent->getParent();
+        bool parentIsLeft = grandparent->getLeft() == parent;
+        RBNode<Key, Value>* uncle = parentIsLeft ? grandparent->getRight() : grandparent->getLeft();
+
+        if (isRed(uncle)) {
+            parent->setColor(RBNode<Key, Value>::BLACK);
+            uncle->setColor(RBNode<Key, Value>::BLACK);
+            grandparent->setColor(RBNode<Key, Value>::RED);
+            node = grandparent;
+            continue;
+        }
+
+        // zig-zag
+        if (parentIsLeft && node == parent->getRight()) {
+            rotateLeft(parent);
+            parent = node;
+        } else if (!parentIsLeft && node == parent->getLeft()) {
+            rotateRight(parent);
+            parent = node;
+        }
+        // zig-zig
+        parent->setColor(RBNode<Key, Value>::BLACK);
+        grandparent->setColor(RBNode<Key, Value>::RED);
+        if (parentIsLeft) {
+            rotateRight(grandparent);
+        } else {
+            rotateLeft(grandparent);
+        }
+        break;
+    }
+    static_cast<RBNode<Key, Value>*>(this->root_)->setColor(RBNode<Key, Value>::BLACK);
+}
+
+/**
+* Bulk-load hook. buildSubtree() puts the smaller half on the left, so
+* the left spine is a subtree's shortest path and, with every node on it
+* black, its length is the black height. The two halves only disagree
+* when the right one is perfect (so all black) and one level deeper;
+* making its root red evens them out.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::builtSubtree(Node<Key, Value>* built, int, int)
+{
+    RBNode<Key, Value>* node = static_cast<RBNode<Key, Value>*>(built);
+    node->setColor(RBNode<Key, Value>::BLACK);
+    if (leftSpineLength(node->getRight()) > leftSpineLength(node->getLeft())) {
+        node->getRight()->setColor(RBNode<Key, Value>::RED);
+    }
+}
+
+/**
+* Rotates node's right child above it, updating root_ if needed.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::rotateLeft(RBNode<Key, Value>* node)
+{
+    RBNode<Key, Value>* child = node->getRight();
+    BST_COUNT(ROTATIONS);
+    RBNode<Key, Value>* parent = node->getParent();
+
+    node->setRight(child->getLeft());
+    if (child->getLeft() != NULL) {
+        child->getLeft()->setParent(node);
+    }
+    child->setLeft(node);
+    node->setParent(child);
+
+    child->setParent(parent);
+    if (parent == NULL) {
+        this->root_ = child;
+    } else if (parent->getLeft() == node) {
+        parent->setLeft(child);
+    } else {
+        parent->setRight(child);
+    }
+}
+
+/**
+* Rotates node's left child above it, updating root_ if needed.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::rotateRight(RBNode<Key, Value>* node)
+{
+    RBNode<Key, Value>* child = node->getLeft();
+    BST_COUNT(ROTATIONS);
+    RBNode<Key, Value>* parent = node->getParent();
+
+    node->setLeft(child->getRight());
+    if (child->getRight() != NULL) {
+        child->getRight()->setParent(node);
+    }
+    child->setRight(node);
+    node->setParent(child);
+
+    child->setParent(parent);
+    if (parent == NULL) {
+        this->root_ = child;
+    } else if (parent->getLeft() == node) {
+        parent->setLeft(child);
+    } else {
+        parent->setRight(child);
+    }
+}
+
+/**
+* The subtree at node (possibly NULL, under parent) is one black short
+* after a remove. A red node absorbs the missing black; otherwise borrow
+* from the sibling's side with at most three rotations, or, when the
+* sibling and its children are all black, recolor it and move the
+* shortage up to parent.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::removeFixup(RBNode<Key, Value>* node, RBNode<Key, Value>* parent)
+{
+    while (parent != NULL && !isRed(node)) {
+        bool isLeft = parent->getLeft() == node;
+        // node is short a black, so its sibling subtree has at least one
+        RBNode<Key, Value>* sibling = isLeft ? parent->getRight() : parent->getLeft();
+
+        if (isRed(sibling)) {
+            sibling->setColor(RBNode<Key, Value>::BLACK);
+            parent->setColor(RBNode<Key, Value>::RED);
+            if (isLeft) {
+                rotateLeft(parent);
+            } else {
+                rotateRight(parent);
+            }
+            sibling = isLeft ? parent->getRight() : parent->getLeft();
+        }
+
+        RBNode<Key, Value>* nearNephew = isLeft ? sibling->getLeft() : sibling->getRight();
+        RBNode<Key, Value>* farNephew = isLeft ? sibling->getRight() : sibling->getLeft();
+        if (!isRed(nearNephew) && !isRed(farNephew)) {
+            sibling->setColor(RBNode<Key, Value>::RED);
+            node = parent;
+            parent = node->getParent();
+            continue;
+        }
+
+        if (!isRed(farNephew)) {
+            nearNephew->setColor(RBNode<Key, Value>::BLACK);
+            sibling->setColor(RBNode<Key, Value>::RED);
+            if (isLeft) {
+                rotateRight(sibling);
+            } else {
+                rotateLeft(sibling);
+            }
+            farNephew = sibling;
+            sibling = nearNephew;
+        }
+
+        sibling->setColor(parent->getColor());
+        parent->setColor(RBNode<Key, Value>::BLACK);
+        farNephew->setColor(RBNode<Key, Value>::BLACK);
+        if (isLeft) {
+            rotateLeft(parent);
+        } else {
+            rotateRight(parent);
+        }
+        return;
+    }
+
+    if (node != NULL) {
+        node->setColor(RBNode<Key, Value>::BLACK);
+    }
+}
+
+/**
+* NULL children count as black.
+*/
+template<class Key, class Value, class Compare>
+bool RBTree<Key, Value, Compare>::isRed(const RBNode<Key, Value>* node)
+{
+    return node != NULL && node->getColor() == RBNode<Key, Value>::RED;
+}
+
+/**
+* Number of nodes from node down its chain of left children.
+*/
+template<class Key, class Value, class Compare>
+int RBTree<Key, Value, Compare>::leftSpineLength(const RBNode<Key, Value>* node)
+{
+    int length = 0;
+    for (; node != NULL; node = node->getLeft()) {
+        ++length;
+    }
+    return length;
+}
+
+/**
+* Returns the black height below node, or -1 if the subtree breaks a
+* red-black rule.
+*/
+template<class Key, class Value, class Compare>
+int RBTree<Key, Value, Compare>::blackHeight(const RBNode<Key, Value>* node)
+{
+    if (node == NULL) {
+        return 0;
+    }
+    if (isRed(node) && (isRed(node->getLeft()) || isRed(node->getRight()))) {
+        return -1;
+    }
+    int left = blackHeight(node->getLeft());
+    int right = blackHeight(node->getRight());
+    if (left < 0 || left != right) {
+        return -1;
+    }
+    return left + (isRed(node) ? 0 : 1);
+}
+
+/*
+  -----------------------------------------
+  End implementations for the RBTree class.
+  -----------------------------------------
+*/
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef SIMD_SEARCH_H
+#define SIMD_SEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
+/**
+* Searching within one block of sorted keys, as used by FrozenTree and
+* BlockTree. A block is (about) one cache line: WIDTH keys.
+*
+* countBefore(block, probe, strict, comp) returns how many keys in the
+* block sort before probe: the keys less than probe, or with strict set
+* the keys not greater than probe. The generic version compares one key
+* at a time with comp.
+*/
+template <typename Key, typename Compare>
+struct GenericBlockSearch
+{
+    static const std::size_t WIDTH = sizeof(Key) >= 64 ? 1 : 64 / sizeof(Key);
+
+    static std::size_t countBefore(const Key* block, const Key& probe, bool strict, const Compare& comp)
+    {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < WIDTH; ++i) {
+            count += strict ? !comp(probe, block[i]) : comp(block[i], probe);
+        }
+        return count;
+    }
+};
+
+template <typename Key, typename Compare>
+struct BlockSearch : GenericBlockSearch<Key, Compare>
+{
+};
+
+/**
+* Arithmetic keys in ascending order compare the whole block against the
+* probe at once: AVX2 when the compiler targets it, else SSE4.2, else the
+* generic loop. The per-lane results become a bit mask whose popcount is
+* the answer, so there are no branches on the key data.
+*/
+template <typename Key>
+struct SimdBlockSearch : GenericBlockSearch<Key, std::less<Key> >
+{
+};
+
+template <typename Key>
+struct BlockSearch<Key, std::less<Key> > : SimdBlockSearch<Key>
+{
+};
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+
+/**
+* Shared body for 64-bit integers. Unsigned keys are biased into signed
+* order since there is no unsigned 64-bit compare.
+*/
+template <bool Unsigned>
+inline std::size_t countBefore64(const void* block, uint64_t probe, bool strict)
+{
+    const long long bias = Unsigned ? static_cast<long long>(0x8000000000000000ULL) : 0;
+    const long long* keys = static_cast<const long long*>(block);
+    unsigned mask;
+#if defined(__AVX2__)
+    const __m256i biasVec = _mm256_set1_epi64x(bias);
+    __m256i p = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(probe)), biasVec);
+    __m256i lo = _mm256_xor_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(keys)), biasVec);
+    __m256i hi = _mm256_xor_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(keys + 4)), biasVec);
+    if (strict) {
+        // not greater than probe = 8 - (greater than probe)
+        mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(lo, p))) |
+            _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(hi, p))) << 4;
+        return 8 - __builtin_popcount(mask);
+    }
+    mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(p, lo))) |
+        _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(p, hi))) << 4;
+    return __builtin_popcount(mask);
+#else
+    const __m128i biasVec = _mm_set1_epi64x(bias);
+    __m128i p = _mm_xor_si128(_mm_set1_epi64x(static_cast<long long>(probe)), biasVec);
+    mask = 0;
+    for (int i = 0; i < 4; ++i) {
+        __m128i k = _mm_xor_si128(_mm_load_si128(reinterpret_cast<const __m128i*>(keys + 2 * i)), biasVec);
+        __m128i cmp = strict ? _mm_cmpgt_epi64(k, p) : _mm_cmpgt_epi64(p, k);
+        mask |= _mm_movemask_pd(_mm_castsi128_pd(cmp)) << (2 * i);
+    }
+    return strict ? 8 - __builtin_popcount(mask) : __builtin_popcount(mask);
+#endif
+}
+
+/**
+* Shared body for 32-bit integers, biased the same way when unsigned.
+*/
+template <bool Unsigned>
+inline std::size_t countBefore32(const void* block, uint32_t probe, bool strict)
+{
+    const int bias = Unsigned ? static_cast<int>(0x80000000U) : 0;
+    const int* keys = static_cast<const int*>(block);
+    unsigned mask = 0;
+#if defined(__AVX2__)
+    const __m256i biasVec = _mm256_set1_epi32(bias);
+    __m256i p = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int>(probe)), biasVec);
+    for (int i = 0; i < 2; ++i) {
+        __m256i k = _mm256_xor_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(keys + 8 * i)), biasVec);
+        __m256i cmp = strict ? _mm256_cmpgt_epi32(k, p) : _mm256_cmpgt_epi32(p, k);
+        mask |= _mm256_movemask_ps(_mm256_castsi256_ps(cmp)) << (8 * i);
+    }
+#else
+    const __m128i biasVec = _mm_set1_epi32(bias);
+    __m128i p = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(probe)), biasVec);
+    for (int i = 0; i < 4; ++i) {
+        __m128i k = _mm_xor_si128(_mm_load_si128(reinterpret_cast<const __m128i*>(keys + 4 * i)), biasVec);
+        __m128i cmp = strict ? _mm_cmpgt_epi32(k, p) : _mm_cmpgt_epi32(p, k);
+        mask |= _mm_movemask_ps(_mm_castsi128_ps(cmp)) << (4 * i);
+    }
+#endif
+    return strict ? 16 - __builtin_popcount(mask) : __builtin_popcount(mask);
+}
+
+template <>
+struct SimdBlockSearch<uint64_t>
+{
+    static const std::size_t WIDTH = 8;
+    static std::size_t countBefore(const uint64_t* block, uint64_t probe, bool strict, const std::less<uint64_t>&)
+    {
+        return countBefore64<true>(block, probe, strict);
+    }
+};
+
+template <>
+struct SimdBlockSearch<int64_t>
+{
+    static const std::size_t WIDTH = 8;
+    static std::size_t countBefore(const int64_t* block, int64_t probe, bool strict, const std::less<int64_t>&)
+    {
+        return countBefore64<false>(block, static_cast<uint64_t>(probe), strict);
+    }
+};
+
+template <>
+struct SimdBlockSearch<uint32_t>
+{
+    static const std::size_t WIDTH = 16;
+    static std::size_t countBefore(const uint32_t* block, uint32_t probe, bool strict, const std::less<uint32_t>&)
+    {
+        return countBefore32<true>(block, probe, strict);
+    }
+};
+
+template <>
+struct SimdBlockSearch<int32_t>
+{
+    static const std::size_t WIDTH = 16;
+    static std::size_t countBefore(const int32_t* block, int32_t probe, bool strict, const std::less<int32_t>&)
+    {
+        return countBefore32<false>(block, static_cast<uint32_t>(probe), strict);
+    }
+};
+
+template <>
+struct SimdBlockSearch<double>
+{
+    static const std::size_t WIDTH = 8;
+    static std::size_t countBefore(const double* block, double probe, bool strict, const std::less<double>&)
+    {
+        unsigned mask = 0;
+#if defined(__AVX2__)
+        __m256d p = _mm256_set1_pd(probe);
+        for (int i = 0; i < 2; ++i) {
+            __m256d k = _mm256_load_pd(block + 4 * i);
+            __m256d cmp = strict ? _mm256_cmp_pd(k, p, _CMP_LE_OQ) : _mm256_cmp_pd(k, p, _CMP_LT_OQ);
+            mask |= _mm256_movemask_pd(cmp) << (4 * i);
+        }
+#else
+        __m128d p = _mm_set1_pd(probe);
+        for (int i = 0; i < 4; ++i) {
+            __m128d k = _mm_load_pd(block + 2 * i);
+            __m128d cmp = strict ? _mm_cmple_pd(k, p) : _mm_cmplt_pd(k, p);
+            mask |= _mm_movemask_pd(cmp) << (2 * i);
+        }
+#endif
+        return __builtin_popcount(mask);
+    }
+};
+
+template <>
+struct SimdBlockSearch<float>
+{
+    static const std::size_t WIDTH = 16;
+    static std::size_t countBefore(const float* block, float probe, bool strict, const std::less<float>&)
+    {
+        unsigned mask = 0;
+#if defined(__AVX2__)
+        __m256 p = _mm256_set1_ps(probe);
+        for (int i = 0; i < 2; ++i) {
+            __m256 k = _mm256_load_ps(block + 8 * i);
+            __m256 cmp = strict ? _mm256_cmp_ps(k, p, _CMP_LE_OQ) : _mm256_cmp_ps(k, p, _CMP_LT_OQ);
+            mask |= _mm256_movemask_ps(cmp) << (8 * i);
+        }
+#else
+        __m128 p = _mm_set1_ps(probe);
+        for (int i = 0; i < 4; ++i) {
+            __m128 k = _mm_load_ps(block + 4 * i);
+            __m128 cmp = strict ? _mm_cmple_ps(k, p) : _mm_cmplt_ps(k, p);
+            mask |= _mm_movemask_ps(cmp) << (4 * i);
+        }
+#endif
+        return __builtin_popcount(mask);
+    }
+};
+
+#endif
+
+#endif
@@ -0,0 +1,281 @@
+#ifndef SPLAYBST_H
+#define SPLAYBST_H
+
+#include <functional>
+#include <memory>
+#include "bst.h"
+
+/**
+* A splay tree: every access moves the node it touched up to the root
+* with zig-zig / zig-zag rotations, so recently and frequently used keys
+* sit a few hops from the root. Operations are O(log n) amortized, and
+* skewed (e.g. Zipfian) lookups get much cheaper than in a balanced tree
+* of fixed shape. Nodes are plain Nodes: a splay tree stores no balance.
+*
+* find() splays, and so do inserts, try_emplace() and the mutable
+* operator[] that land on a key already in the tree; remove() and
+* inserts of new keys always fully splay. With SEMI_SPLAY those lookups
+* only semi-splay: a zig-zig rotates the parent instead of the
+* node, roughly halving the node's depth per lookup with fewer rotations
+* and less reshuffling of the rest of the path. Repeated hot lookups
+* still converge on the top of the tree. Lookups through a const tree,
+* and lower_bound()/upper_bound(), leave the shape alone.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class SplayTree : public BinarySearchTree<Key, Value, Compare>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value, Compare>::iterator iterator;
+    enum LookupSplay { FULL_SPLAY, SEMI_SPLAY };
+
+    SplayTree();
+    explicit SplayTree(std::shared_ptr<NodePool> pool, const Compare& comp = Compare());
+    virtual void remove(const Key& key);
+
+    using BinarySearchTree<Key, Value, Compare>::find;
+    iterator find(const Key& key);
+
+    LookupSplay getLookupSplay() const;
+    void setLookupSplay(LookupSplay mode);
+
+protected:
+    virtual void insertFixup(Node<Key, Value>* node);
+    virtual void accessFixup(Node<Key, Value>* node);
+
+    void rotateUp(Node<Key, Value>* node);
+    void splay(Node<Key, Value>* node, Node<Key, Value>* stop);
+    void semiSplay(Node<Key, Value>* node);
+
+    LookupSplay lookupSplay_;
+};
+
+/*
+  ----------------------------------------------
+  Begin implementations for the SplayTree class.
+  ----------------------------------------------
+*/
+
+/**
+* Default constructor
+*/
+template<class Key, class Value, class Compare>
+SplayTree<Key, Value, Compare>::SplayTree() :
+    BinarySearchTree<Key, Value, Compare>(),
+    lookupSplay_(FULL_SPLAY)
+{
+
+}
+
+/**
+* Constructor that allocates nodes from a (possibly shared) pool and
+* orders keys with comp.
+*/
+template<class Key, class Value, class Compare>
+SplayTree<Key, Value, Compare>::SplayTree(std::shared_ptr<NodePool> pool, const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare>(pool, comp),
+    lookupSplay_(FULL_SPLAY)
+{
+
+}
+
+/**
+* Removes key, if present: it is splayed to the root, then its
+* predecessor is splayed up to be its left child, which has no right
+* child and so can take over the right subtree and the root.
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::remove(const Key& key)
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    if (node == NULL) {
+        return;
+    }
+    splay(node, NULL);
+    this->boundsBeforeUnlink(node);
+
+    Node<Key, Value>* right = node->getRight();
+    Node<Key, Value>* top = node->getLeft();
+    if (top == NULL) {
+        top = right;
+    } else {
+        Node<Key, Value>* pred = this->predecessor(node);
+        splay(pred, node);
+        pred->setRight(right);
+        if (right != NULL) {
+            right->setParent(pred);
+        }
+        top = pred;
+    }
+
+    if (top != NULL) {
+        top->setParent(NULL);
+    }
+    this->root_ = top;
+    this->destroyNode(node);
+}
+
+/**
+* Returns an iterator to the item with key, or end(), and splays the
+* last node visited (the match, or where the search ended) upwards as
+* set by setLookupSplay(). The descent stops as soon as it meets key,
+* so a key that was just splayed to the root costs one visit; the
+* base class's one-compare walk would always go down to a leaf.
+*/
+template<class Key, class Value, class Compare>
+typename SplayTree<Key, Value, Compare>::iterator
+SplayTree<Key, Value, Compare>::find(const Key& key)
+{
+    Node<Key, Value>* curr = this->root_;
+    Node<Key, Value>* last = NULL;
+    while (curr != NULL) {
+        BST_COUNT(NODE_VISITS);
+        BST_COUNT(COMPARISONS);
+        last = curr;
+        if (this->comp_(key, curr->getKey())) {
+            curr = curr->getLeft();
+            continue;
+        }
+        BST_COUNT(COMPARISONS);
+        if (this->comp_(curr->getKey(), key)) {
+            curr = curr->getRight();
+        } else {
+            break;
+        }
+    }
+
+    if (last != NULL) {
+        accessFixup(last);
+    }
+    return this->iteratorAt(curr);
+}
+
+/**
+* A getter for how lookups restructure the tree.
+*/
+template<class Key, class Value, class Compare>
+typename SplayTree<Key, Value, Compare>::LookupSplay
+SplayTree<Key, Value, Compare>::getLookupSplay() const
+{
+    return lookupSplay_;
+}
+
+/**
+* A setter for how lookups restructure the tree.
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::setLookupSplay(LookupSplay mode)
+{
+    lookupSplay_ = mode;
+}
+
+/**
+* A newly linked node is splayed to the root.
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::insertFixup(Node<Key, Value>* node)
+{
+    splay(node, NULL);
+}
+
+/**
+* An accessed node is splayed (or semi-splayed) as set by setLookupSplay().
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::accessFixup(Node<Key, Value>* node)
+{
+    if (lookupSplay_ == SEMI_SPLAY) {
+        semiSplay(node);
+    } else {
+        splay(node, NULL);
+    }
+}
+
+/**
+* Rotates node above its parent, updating root_ if needed.
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::rotateUp(Node<Key, Value>* node)
+{
+    BST_COUNT(ROTATIONS);
+    Node<Key, Value>* parent = node->getParent();
+    Node<Key, Value>* grandparent = parent->getParent();
+
+    if (parent->getLeft() == node) {
+        parent->setLeft(node->getRight());
+        if (node->getRight() != NULL) {
+            node->getRight()->setParent(parent);
+        }
+        node->setRight(parent);
+    } else {
+        parent->setRight(node->getLeft());
+        if (node->getLeft() != NULL) {
+            node->getLeft()->setParent(parent);
+        }
+        node->setLeft(parent);
+    }
+    parent->setParent(node);
+
+    node->setParent(grandparent);
+    if (grandparent == NULL) {
+        this->root_ = node;
+    } else if (grandparent->getLeft() == parent) {
+        grandparent->setLeft(node);
+    } else {
+        grandparent->setRight(node);
+    }
+}
+
+/**
+* Splays node up until its parent is stop (NULL: to the root).
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::splay(Node<Key, Value>* node, Node<Key, Value>* stop)
+{
+    while (node->getParent() != stop) {
+        Node<Key, Value>* parent = node->getParent();
+        Node<Key, Value>* grandparent = parent->getParent();
+        if (grandparent == stop) {
+            // zig
+            rotateUp(node);
+        } else if ((grandparent->getLeft() == parent) == (parent->getLeft() == node)) {
+            // zig-zig
+            rotateUp(parent);
+            rotateUp(node);
+        } else {
+            // zig-zag
+            rotateUp(node);
+            rotateUp(node);
+        }
+    }
+}
+
+/**
+* Semi-splays node towards the root. A zig-zig only rotates the parent
+* and carries on from there, leaving node about halfway up; a zig-zag
+* is done as in splay().
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::semiSplay(Node<Key, Value>* node)
+{
+    while (node->getParent() != NULL) {
+        Node<Key, Value>* parent = node->getParent();
+        Node<Key, Value>* grandparent = parent->getParent();
+        if (grandparent == NULL) {
+            rotateUp(node);
+        } else if ((grandparent->getLeft() == parent) == (parent->getLeft() == node)) {
+            rotateUp(parent);
+            node = parent;
+        } else {
+            rotateUp(node);
+            rotateUp(node);
+        }
+    }
+}
+
+/*
+  --------------------------------------------
+  End implementations for the SplayTree class.
+  --------------------------------------------
+*/
+
+#endif
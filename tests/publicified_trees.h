@@ -0,0 +1,17 @@
+//
+// Wrapper around the tree headers to make all private/protected functions public
+//
+
+#ifndef TREE_TESTS_PUBLICIFIED_TREES_H
+#define TREE_TESTS_PUBLICIFIED_TREES_H
+
+#define private public
+#define protected public
+#include <avlbst.h>
+#include <splaybst.h>
+#include <concurrent_avlbst.h>
+#include <rbbst.h>
+#undef private
+#undef protected
+
+#endif //TREE_TESTS_PUBLICIFIED_TREES_H
@@ -0,0 +1,186 @@
+#include <block_tree.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+
+// Runs a random mix of inserts, overwrites and removes against std::map
+// and checks the contents, the bounds and the structure along the way.
+template<typename Key, typename Value>
+static void matchStdMap(const std::vector<Key>& domain, int operations, unsigned seed)
+{
+	BlockTree<Key, Value> tree;
+	std::map<Key, Value> expected;
+	std::mt19937 rng(seed);
+
+	for(int i = 0; i < operations; ++i)
+	{
+		Key key = domain[rng() % domain.size()];
+		// grow first, then shrink, so that nodes both split and merge
+		bool grow = i < operations / 2;
+		if(rng() % 4 == 0 || (!grow && rng() % 4 != 0))
+		{
+			tree.remove(key);
+			expected.erase(key);
+		}
+		else
+		{
+			Value value = static_cast<Value>(i);
+			tree.insert(std::make_pair(key, value));
+			expected[key] = value;
+		}
+		if(i % 997 == 0)
+		{
+			ASSERT_TRUE(tree.isBalanced()) << "after operation " << i;
+		}
+	}
+	ASSERT_TRUE(tree.isBalanced());
+	ASSERT_EQ(expected.size(), tree.size());
+
+	typename std::map<Key, Value>::iterator want = expected.begin();
+	for(typename BlockTree<Key, Value>::iterator it = tree.begin(); it != tree.end(); ++it, ++want)
+	{
+		ASSERT_NE(expected.end(), want);
+		EXPECT_EQ(want->first, it->first);
+		EXPECT_EQ(want->second, it->second);
+	}
+	EXPECT_EQ(expected.end(), want);
+
+	for(size_t i = 0; i < domain.size(); ++i)
+	{
+		Key key = domain[i];
+		typename std::map<Key, Value>::iterator it = expected.find(key);
+		typename BlockTree<Key, Value>::iterator got = tree.find(key);
+		ASSERT_EQ(it == expected.end(), got == tree.end());
+		if(it != expected.end())
+		{
+			EXPECT_EQ(it->second, got->second);
+		}
+
+		it = expected.lower_bound(key);
+		got = tree.lower_bound(key);
+		ASSERT_EQ(it == expected.end(), got == tree.end());
+		if(it != expected.end())
+		{
+			EXPECT_EQ(it->first, got->first);
+		}
+
+		it = expected.upper_bound(key);
+		got = tree.upper_bound(key);
+		ASSERT_EQ(it == expected.end(), got == tree.end());
+		if(it != expected.end())
+		{
+			EXPECT_EQ(it->first, got->first);
+		}
+	}
+}
+
+TEST(BlockTree, Uint64MatchesStdMap)
+{
+	std::vector<uint64_t> domain;
+	std::mt19937_64 rng(1);
+	for(int i = 0; i < 3000; ++i)
+	{
+		domain.push_back(rng());
+	}
+	// the largest key equals the padding in unused slots
+	domain.push_back(0);
+	domain.push_back(std::numeric_limits<uint64_t>::max());
+	domain.push_back(std::numeric_limits<uint64_t>::max() - 1);
+	matchStdMap<uint64_t, uint64_t>(domain, 40000, 2);
+}
+
+TEST(BlockTree, Int32MatchesStdMap)
+{
+	std::vector<int32_t> domain;
+	for(int32_t key = -1500; key < 1500; ++key)
+	{
+		domain.push_back(key * 7);
+	}
+	domain.push_back(std::numeric_limits<int32_t>::min());
+	domain.push_back(std::numeric_limits<int32_t>::max());
+	matchStdMap<int32_t, int>(domain, 40000, 3);
+}
+
+TEST(BlockTree, DoubleMatchesStdMap)
+{
+	std::vector<double> domain;
+	for(int i = -1000; i < 1000; ++i)
+	{
+		domain.push_back(i * 0.25);
+	}
+	domain.push_back(-std::numeric_limits<double>::infinity());
+	domain.push_back(std::numeric_limits<double>::infinity());
+	domain.push_back(std::numeric_limits<double>::max());
+	matchStdMap<double, long>(domain, 30000, 4);
+}
+
+TEST(BlockTree, SmallKeysMatchStdMap)
+{
+	std::vector<unsigned char> domain;
+	for(int key = 0; key < 256; ++key)
+	{
+		domain.push_back(static_cast<unsigned char>(key));
+	}
+	matchStdMap<unsigned char, int>(domain, 5000, 5);
+}
+
+TEST(BlockTree, ValuesAreMovedNotLost)
+{
+	BlockTree<int, std::string> tree;
+	for(int key = 0; key < 2000; ++key)
+	{
+		tree.insert(std::make_pair(key, std::string(40, static_cast<char>('a' + key % 26))));
+	}
+	for(int key = 0; key < 2000; key += 3)
+	{
+		tree.remove(key);
+	}
+	ASSERT_TRUE(tree.isBalanced());
+	for(BlockTree<int, std::string>::iterator it = tree.begin(); it != tree.end(); ++it)
+	{
+		EXPECT_NE(0, it->first % 3);
+		EXPECT_EQ(std::string(40, static_cast<char>('a' + it->first % 26)), it->second);
+	}
+
+	// values can be changed through an iterator, as with BinarySearchTree
+	tree.find(1)->second = "one";
+	EXPECT_EQ("one", tree.find(1)->second);
+
+	tree.clear();
+	EXPECT_TRUE(tree.empty());
+	EXPECT_EQ(tree.end(), tree.begin());
+	EXPECT_EQ(tree.end(), tree.find(1));
+}
+
+TEST(BlockTree, AscendingInsertAndRemove)
+{
+	BlockTree<uint64_t, uint64_t> tree;
+	const uint64_t n = 100000;
+	for(uint64_t key = 0; key < n; ++key)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+	ASSERT_TRUE(tree.isBalanced());
+	ASSERT_EQ(n, tree.size());
+	for(uint64_t key = 0; key < n; key += 2)
+	{
+		tree.remove(key);
+	}
+	ASSERT_TRUE(tree.isBalanced());
+	for(uint64_t key = 0; key < n; ++key)
+	{
+		ASSERT_EQ(key % 2 == 1, tree.find(key) != tree.end());
+	}
+	for(uint64_t key = n; key-- > 0; )
+	{
+		tree.remove(key);
+	}
+	EXPECT_TRUE(tree.isBalanced());
+	EXPECT_TRUE(tree.empty());
+}
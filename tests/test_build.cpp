@@ -0,0 +1,184 @@
+#include "publicified_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+typedef AVLTree<int, int> Tree;
+
+// Checks every balance factor against the real subtree heights and
+// returns the height of the subtree at node
+static int checkBalances(AVLNode<int, int>* node)
+{
+	if (node == NULL)
+	{
+		return 0;
+	}
+	int leftHeight = checkBalances(node->getLeft());
+	int rightHeight = checkBalances(node->getRight());
+	EXPECT_EQ(rightHeight - leftHeight, node->getBalance()) << "at key " << node->getKey();
+	EXPECT_LE(std::abs(rightHeight - leftHeight), 1) << "at key " << node->getKey();
+	return std::max(leftHeight, rightHeight) + 1;
+}
+
+static std::vector<std::pair<int, int> > expectedItems(const Tree& tree)
+{
+	std::vector<std::pair<int, int> > items;
+	for(Tree::iterator it = tree.begin(); it != tree.end(); ++it)
+	{
+		items.push_back(std::make_pair(it->first, it->second));
+	}
+	return items;
+}
+
+// Throws from its copy constructor once the countdown runs out
+struct Fragile
+{
+	static int copiesLeft;
+
+	explicit Fragile(int v = 0) : value(v) { }
+	Fragile(const Fragile& other) : value(other.value)
+	{
+		if (copiesLeft-- == 0)
+		{
+			throw std::runtime_error("copy failed");
+		}
+	}
+	Fragile& operator=(const Fragile& other) { value = other.value; return *this; }
+
+	int value;
+};
+
+int Fragile::copiesLeft = -1;
+
+// print() is virtual, so every value type needs one of these
+static std::ostream& operator<<(std::ostream& out, const Fragile& fragile)
+{
+	return out << fragile.value;
+}
+
+TEST(Build, ShapeAndBalancesOfLinearBuild)
+{
+	for(int n = 0; n <= 70; ++n)
+	{
+		std::vector<std::pair<int, int> > items;
+		for(int key = 0; key < n; ++key)
+		{
+			items.push_back(std::make_pair(key, key * 10));
+		}
+		Tree tree;
+		tree.buildFromSorted(items.begin(), items.end());
+
+		TreeShape shape = tree.validate();
+		ASSERT_TRUE(shape.valid()) << shape.problem;
+		EXPECT_EQ(static_cast<std::size_t>(n), tree.size());
+		EXPECT_EQ(items, expectedItems(tree));
+
+		// as short as any binary tree of n nodes can be
+		int height = 0;
+		while((1 << height) - 1 < n)
+		{
+			++height;
+		}
+		EXPECT_EQ(height, shape.height) << "n = " << n;
+		EXPECT_EQ(height, checkBalances(static_cast<AVLNode<int, int>*>(tree.root_)));
+
+		// no leaf is more than one level above another
+		if(n > 0)
+		{
+			EXPECT_LE(shape.maxDepth, height - 1);
+			std::size_t firstLeafDepth = 0;
+			while(shape.leafDepths[firstLeafDepth] == 0)
+			{
+				++firstLeafDepth;
+			}
+			EXPECT_GE(static_cast<int>(firstLeafDepth), height - 2) << "n = " << n;
+		}
+	}
+}
+
+TEST(Build, UnsortedInputIsSortedFirst)
+{
+	std::vector<std::pair<int, int> > items;
+	for(int i = 0; i < 100; ++i)
+	{
+		int key = (i * 37) % 100;
+		items.push_back(std::make_pair(key, -key));
+	}
+	Tree tree;
+	tree.buildFromSorted(items.begin(), items.end());
+
+	ASSERT_TRUE(tree.validate().valid());
+	EXPECT_EQ(7, tree.validate().height);
+	std::map<int, int> expected(items.begin(), items.end());
+	std::vector<std::pair<int, int> > expectedOrder(expected.begin(), expected.end());
+	EXPECT_EQ(expectedOrder, expectedItems(tree));
+	EXPECT_EQ(0, tree.begin()->first);
+	EXPECT_EQ(99, (--tree.end())->first);
+}
+
+TEST(Build, LastValueOfRepeatedKeyWins)
+{
+	std::vector<std::pair<int, int> > items;
+	items.push_back(std::make_pair(3, 1));
+	items.push_back(std::make_pair(1, 1));
+	items.push_back(std::make_pair(3, 2));
+	items.push_back(std::make_pair(2, 1));
+	items.push_back(std::make_pair(1, 2));
+	items.push_back(std::make_pair(3, 3));
+
+	Tree tree;
+	tree.buildFromSorted(items.begin(), items.end());
+	ASSERT_TRUE(tree.validate().valid());
+	ASSERT_EQ(3u, tree.size());
+	EXPECT_EQ(2, tree.find(1)->second);
+	EXPECT_EQ(1, tree.find(2)->second);
+	EXPECT_EQ(3, tree.find(3)->second);
+
+	// sorted apart from the repeats takes the same path
+	std::vector<std::pair<int, int> > runs;
+	runs.push_back(std::make_pair(1, 1));
+	runs.push_back(std::make_pair(1, 2));
+	runs.push_back(std::make_pair(2, 1));
+	runs.push_back(std::make_pair(2, 2));
+	tree.buildFromSorted(runs.begin(), runs.end());
+	ASSERT_EQ(2u, tree.size());
+	EXPECT_EQ(2, tree.find(1)->second);
+	EXPECT_EQ(2, tree.find(2)->second);
+}
+
+TEST(Build, FailedCopyLeavesAnEmptyTree)
+{
+	std::vector<std::pair<int, Fragile> > items;
+	for(int key = 0; key < 50; ++key)
+	{
+		items.push_back(std::make_pair(key, Fragile(key)));
+	}
+
+	std::shared_ptr<NodePool> pool = std::make_shared<NodePool>(sizeof(AVLNode<int, Fragile>));
+	AVLTree<int, Fragile> tree(pool);
+	for(int failAt = 0; failAt < 50; failAt += 7)
+	{
+		tree.insert(std::make_pair(100, Fragile(100)));
+		Fragile::copiesLeft = failAt;
+		EXPECT_THROW(tree.buildFromSorted(items.begin(), items.end()), std::runtime_error);
+		Fragile::copiesLeft = -1;
+
+		EXPECT_TRUE(tree.empty());
+		EXPECT_EQ(0u, tree.size());
+		EXPECT_TRUE(tree.begin() == tree.end());
+		EXPECT_EQ(0u, pool->blocksInUse()) << "failing at copy " << failAt;
+	}
+
+	tree.buildFromSorted(items.begin(), items.end());
+	EXPECT_EQ(50u, tree.size());
+	EXPECT_EQ(50u, pool->blocksInUse());
+	EXPECT_TRUE(tree.validate().valid());
+}
@@ -0,0 +1,116 @@
+#include "publicified_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <ostream>
+#include <utility>
+
+// Counts destructor calls, and makes the value non-trivial so that
+// clear() has to visit every node instead of dropping the slabs
+struct Tracked
+{
+	static int alive;
+
+	explicit Tracked(int v = 0) : value(v) { ++alive; }
+	Tracked(const Tracked& other) : value(other.value) { ++alive; }
+	Tracked& operator=(const Tracked& other) { value = other.value; return *this; }
+	~Tracked() { --alive; }
+
+	int value;
+};
+
+int Tracked::alive = 0;
+
+// print() is virtual, so every value type needs one of these
+static std::ostream& operator<<(std::ostream& out, const Tracked& tracked)
+{
+	return out << tracked.value;
+}
+
+typedef BinarySearchTree<int, Tracked> Tree;
+
+static const int DEPTH = 1000000;
+
+static int spineLength(const Node<int, Tracked>* node, bool left)
+{
+	int length = 0;
+	for(; node != NULL; node = left ? node->getLeft() : node->getRight())
+	{
+		++length;
+	}
+	return length;
+}
+
+// Hangs 2i + 1 under each 2i of a left spine of even keys: the hint is
+// 2i + 2, whose predecessor 2i still has a free right slot
+static void addRightLeaves(Tree& tree, int spine)
+{
+	Tree::iterator hint = tree.begin();
+	for(int i = 1; i < spine; ++i)
+	{
+		++hint;
+		tree.insert(hint, std::make_pair(2 * i + 1, Tracked(i)));
+	}
+}
+
+TEST(Clear, DestroysARightSpine)
+{
+	{
+		Tree tree;
+		// ascending keys all go right, each one an O(1) append
+		for(int key = 0; key < DEPTH; ++key)
+		{
+			tree.insert(tree.end(), std::make_pair(key, Tracked(key)));
+		}
+		ASSERT_EQ(DEPTH, spineLength(tree.root_, false));
+		ASSERT_EQ(DEPTH, Tracked::alive);
+	}
+	EXPECT_EQ(0, Tracked::alive);
+}
+
+TEST(Clear, DestroysALeftSpine)
+{
+	Tree tree;
+	// descending keys all go left; a hint at the smallest key skips the descent
+	for(int key = DEPTH; key > 0; --key)
+	{
+		tree.insert(tree.begin(), std::make_pair(key, Tracked(key)));
+	}
+	ASSERT_EQ(DEPTH, spineLength(tree.root_, true));
+	tree.clear();
+	EXPECT_TRUE(tree.empty());
+	EXPECT_EQ(0, Tracked::alive);
+}
+
+TEST(Clear, DestroysALeftSpineWithRightLeaves)
+{
+	// every node on the spine has two children, far more than the fixed
+	// stack holds, and the pool is shared so every block is given back
+	std::shared_ptr<NodePool> pool = std::make_shared<NodePool>(sizeof(Node<int, Tracked>));
+	{
+		Tree tree(pool);
+		const int spine = DEPTH / 2;
+		for(int i = spine; i > 0; --i)
+		{
+			tree.insert(tree.begin(), std::make_pair(2 * i, Tracked(i)));
+		}
+		addRightLeaves(tree, spine);
+		ASSERT_EQ(spine, spineLength(tree.root_, true));
+		ASSERT_EQ(static_cast<std::size_t>(2 * spine - 1), tree.size());
+		EXPECT_EQ(2 * spine - 1, Tracked::alive);
+
+		tree.clear();
+		EXPECT_EQ(0, Tracked::alive);
+		EXPECT_EQ(0u, pool->blocksInUse());
+
+		// again, left to the destructor this time
+		for(int i = spine; i > 0; --i)
+		{
+			tree.insert(tree.begin(), std::make_pair(2 * i, Tracked(i)));
+		}
+		addRightLeaves(tree, spine);
+	}
+	EXPECT_EQ(0, Tracked::alive);
+	EXPECT_EQ(0u, pool->blocksInUse());
+}
@@ -0,0 +1,60 @@
+#include <compact_avlbst.h>
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <utility>
+
+TEST(CompactAVLTree, MatchesStdMap)
+{
+	CompactAVLTree<int, int> tree;
+	std::map<int, int> expected;
+	std::mt19937 rng(31);
+	for(int i = 0; i < 30000; ++i)
+	{
+		int key = rng() % 2000;
+		if(rng() % 3 == 0)
+		{
+			tree.remove(key);
+			expected.erase(key);
+		}
+		else
+		{
+			tree.insert(std::make_pair(key, i));
+			expected[key] = i;
+		}
+	}
+	ASSERT_TRUE(tree.isBalanced());
+	ASSERT_EQ(expected.size(), tree.size());
+
+	std::map<int, int>::iterator want = expected.begin();
+	for(CompactAVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it, ++want)
+	{
+		ASSERT_NE(expected.end(), want);
+		EXPECT_EQ(want->first, it->first);
+		EXPECT_EQ(want->second, it->second);
+	}
+	EXPECT_EQ(expected.end(), want);
+
+	for(int key = -1; key <= 2000; ++key)
+	{
+		std::map<int, int>::iterator it = expected.lower_bound(key);
+		CompactAVLTree<int, int>::iterator got = tree.lower_bound(key);
+		ASSERT_EQ(it == expected.end(), got == tree.end());
+		if(it != expected.end())
+		{
+			EXPECT_EQ(it->first, got->first);
+		}
+		EXPECT_EQ(expected.count(key) == 1, tree.find(key) != tree.end());
+	}
+}
+
+TEST(CompactAVLTree, OverwriteKeepsOneNode)
+{
+	CompactAVLTree<int, int> tree;
+	tree.insert(std::make_pair(1, 1));
+	tree.insert(std::make_pair(1, 2));
+	EXPECT_EQ(1u, tree.size());
+	EXPECT_EQ(2, tree.find(1)->second);
+}
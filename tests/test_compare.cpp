@@ -0,0 +1,155 @@
+#include <avlbst.h>
+#include <rbbst.h>
+#include <splaybst.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A string slice that does not convert to std::string, so lookups with
+// it can only go through the heterogeneous find()
+struct NameView
+{
+	NameView(const char* text, std::size_t length) : data(text), size(length) { }
+
+	int compare(const std::string& other) const
+	{
+		int result = std::strncmp(data, other.data(), std::min(size, other.size()));
+		if (result != 0)
+		{
+			return result;
+		}
+		return size < other.size() ? -1 : (size > other.size() ? 1 : 0);
+	}
+
+	const char* data;
+	std::size_t size;
+};
+
+// Orders std::string keys against each other, against C strings and
+// against NameView slices (a C++11 stand-in for std::less<>)
+struct NameLess
+{
+	typedef void is_transparent;
+
+	bool operator()(const std::string& a, const std::string& b) const { return a < b; }
+	bool operator()(const std::string& a, const char* b) const { return a.compare(b) < 0; }
+	bool operator()(const char* a, const std::string& b) const { return b.compare(a) > 0; }
+	bool operator()(const std::string& a, const NameView& b) const { return b.compare(a) > 0; }
+	bool operator()(const NameView& a, const std::string& b) const { return a.compare(b) < 0; }
+};
+
+template<typename Tree>
+static std::vector<int> keysInOrder(const Tree& tree)
+{
+	std::vector<int> keys;
+	for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it)
+	{
+		keys.push_back(it->first);
+	}
+	return keys;
+}
+
+template<typename Tree>
+static void checkDescending(Tree& tree)
+{
+	for(int i = 0; i < 100; ++i)
+	{
+		tree.insert(std::make_pair((i * 37) % 100, i));
+	}
+	for(int key = 0; key < 100; key += 3)
+	{
+		tree.remove(key);
+	}
+
+	std::vector<int> expected;
+	for(int key = 99; key >= 0; --key)
+	{
+		if(key % 3 != 0)
+		{
+			expected.push_back(key);
+		}
+	}
+	EXPECT_EQ(expected, keysInOrder(tree));
+	EXPECT_TRUE(tree.validate().valid()) << tree.validate().problem;
+	EXPECT_EQ(98, tree.begin()->first);
+	EXPECT_EQ(tree.end(), tree.find(3));
+	ASSERT_NE(tree.end(), tree.find(4));
+
+	// bounds follow the tree's order: the first key not before 3 is 2
+	EXPECT_EQ(2, tree.lower_bound(3)->first);
+	EXPECT_EQ(4, tree.lower_bound(4)->first);
+	EXPECT_EQ(2, tree.upper_bound(4)->first);
+	EXPECT_EQ(tree.end(), tree.lower_bound(0));
+}
+
+TEST(Compare, GreaterOrdersKeysDescending)
+{
+	BinarySearchTree<int, int, std::greater<int> > plain;
+	checkDescending(plain);
+	AVLTree<int, int, std::greater<int> > avl;
+	checkDescending(avl);
+	EXPECT_TRUE(avl.isBalanced());
+	RBTree<int, int, std::greater<int> > rb;
+	checkDescending(rb);
+	SplayTree<int, int, std::greater<int> > splay;
+	checkDescending(splay);
+}
+
+TEST(Compare, GreaterBuildFromSorted)
+{
+	std::vector<std::pair<int, int> > items;
+	for(int key = 20; key > 0; --key)
+	{
+		items.push_back(std::make_pair(key, key));
+	}
+	AVLTree<int, int, std::greater<int> > tree;
+	tree.buildFromSorted(items.begin(), items.end());
+	ASSERT_TRUE(tree.validate().valid());
+	EXPECT_EQ(20, tree.begin()->first);
+
+	// ascending input is out of order for this tree and gets sorted
+	std::vector<std::pair<int, int> > ascending(items.rbegin(), items.rend());
+	tree.buildFromSorted(ascending.begin(), ascending.end());
+	ASSERT_TRUE(tree.validate().valid());
+	EXPECT_EQ(20u, tree.size());
+	EXPECT_EQ(20, tree.begin()->first);
+}
+
+TEST(Compare, HeterogeneousFind)
+{
+	AVLTree<std::string, int, NameLess> tree;
+	const char* names[] = { "ada", "grace", "alan", "edsger", "barbara", "donald" };
+	for(int i = 0; i < 6; ++i)
+	{
+		tree.insert(std::make_pair(std::string(names[i]), i));
+	}
+
+	// C strings, without building a std::string for the probe
+	AVLTree<std::string, int, NameLess>::iterator it = tree.find("edsger");
+	ASSERT_NE(tree.end(), it);
+	EXPECT_EQ(3, it->second);
+	EXPECT_EQ(tree.end(), tree.find("ed"));
+
+	// slices of a longer buffer
+	const char* buffer = "alanadagrace";
+	it = tree.find(NameView(buffer, 4));
+	ASSERT_NE(tree.end(), it);
+	EXPECT_EQ("alan", it->first);
+	it = tree.find(NameView(buffer + 4, 3));
+	ASSERT_NE(tree.end(), it);
+	EXPECT_EQ(0, it->second);
+	EXPECT_EQ(tree.end(), tree.find(NameView(buffer, 3)));
+	EXPECT_EQ(tree.end(), tree.find(NameView(buffer + 7, 4)));
+	it = tree.find(NameView(buffer + 7, 5));
+	ASSERT_NE(tree.end(), it);
+	EXPECT_EQ(1, it->second);
+
+	// the Key overload is still there
+	EXPECT_EQ(5, tree.find(std::string("donald"))->second);
+}
@@ -0,0 +1,216 @@
+#include "publicified_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Values are key * VALUE_SCALE plus a generation, so a reader can tell
+// that a value it copied out belongs to the key it looked up.
+static const uint64_t VALUE_SCALE = 1000;
+
+TEST(ConcurrentAVLTree, MatchesStdMap)
+{
+	ConcurrentAVLTree<int, uint64_t> tree;
+	std::map<int, uint64_t> expected;
+	std::mt19937 rng(7);
+
+	for(int i = 0; i < 20000; ++i)
+	{
+		int key = rng() % 500;
+		if(rng() % 3 == 0)
+		{
+			tree.remove(key);
+			expected.erase(key);
+		}
+		else
+		{
+			tree.insert(std::make_pair(key, static_cast<uint64_t>(i)));
+			expected[key] = i;
+		}
+	}
+
+	ASSERT_EQ(expected.size(), tree.size());
+	for(int key = -1; key <= 500; ++key)
+	{
+		uint64_t value;
+		std::map<int, uint64_t>::iterator it = expected.find(key);
+		ASSERT_EQ(it != expected.end(), tree.find(key, value)) << "key " << key;
+		if(it != expected.end())
+		{
+			EXPECT_EQ(it->second, value);
+		}
+
+		std::pair<int, uint64_t> item;
+		it = expected.lower_bound(key);
+		ASSERT_EQ(it != expected.end(), tree.lower_bound(key, item));
+		if(it != expected.end())
+		{
+			EXPECT_EQ(it->first, item.first);
+		}
+		it = expected.upper_bound(key);
+		ASSERT_EQ(it != expected.end(), tree.upper_bound(key, item));
+		if(it != expected.end())
+		{
+			EXPECT_EQ(it->first, item.first);
+		}
+	}
+
+	std::map<int, uint64_t>::iterator want = expected.begin();
+	for(ConcurrentAVLTree<int, uint64_t>::iterator it = tree.begin(); it != tree.end(); ++it, ++want)
+	{
+		ASSERT_NE(expected.end(), want);
+		EXPECT_EQ(want->first, it->first);
+		EXPECT_EQ(want->second, it->second);
+	}
+	EXPECT_EQ(expected.end(), want);
+
+	tree.clear();
+	EXPECT_TRUE(tree.empty());
+	EXPECT_EQ(tree.end(), tree.begin());
+}
+
+// One writer inserts, overwrites and removes odd keys and rewrites the
+// values of the even keys, which stay in the tree throughout. Readers
+// must always find every even key with a value that belongs to it, and
+// every walk must be in order and include all of them. Run it under
+// ThreadSanitizer (make check-tsan) to check the lock-free reads too.
+typedef ConcurrentAVLNode<int, uint64_t> ReadNode;
+
+// The reader links must describe exactly the writer's tree between writes
+static void expectReadLinksMatch(ReadNode* node, std::size_t& nodes)
+{
+	if(node == NULL)
+	{
+		return;
+	}
+	++nodes;
+	ASSERT_EQ(node->getLeft(), node->getReadLeft()) << "left of " << node->getKey();
+	ASSERT_EQ(node->getRight(), node->getReadRight()) << "right of " << node->getKey();
+	expectReadLinksMatch(node->getReadLeft(), nodes);
+	expectReadLinksMatch(node->getReadRight(), nodes);
+}
+
+TEST(ConcurrentAVLTree, WritesPublishEveryLinkTheyChange)
+{
+	ConcurrentAVLTree<int, uint64_t> tree;
+	std::mt19937 rng(8);
+	for(int i = 0; i < 20000; ++i)
+	{
+		int key = rng() % 300;
+		if(rng() % 2 == 0)
+		{
+			tree.remove(key);
+		}
+		else
+		{
+			tree.insert(std::make_pair(key, static_cast<uint64_t>(i)));
+		}
+		if(i % 7 == 0)
+		{
+			ASSERT_EQ(tree.root_, tree.readRoot_.load());
+			std::size_t nodes = 0;
+			expectReadLinksMatch(tree.readRoot_.load(), nodes);
+			ASSERT_EQ(tree.size(), nodes) << "after operation " << i;
+		}
+	}
+}
+
+TEST(ConcurrentAVLTree, StressOneWriterThreeReaders)
+{
+	const int KEYS = 2000;
+	const int WRITES = 100000;
+	ConcurrentAVLTree<int, uint64_t> tree;
+	for(int key = 0; key < KEYS; key += 2)
+	{
+		tree.insert(std::make_pair(key, key * VALUE_SCALE));
+	}
+
+	std::atomic<bool> done(false);
+	std::atomic<int> failures(0);
+	std::vector<std::thread> readers;
+	for(int r = 0; r < 3; ++r)
+	{
+		readers.push_back(std::thread([&tree, &done, &failures, r, KEYS]()
+		{
+			std::mt19937 rng(r + 1);
+			while(!done.load())
+			{
+				int key = (rng() % KEYS) & ~1;
+				uint64_t value;
+				if(!tree.find(key, value) || value / VALUE_SCALE != static_cast<uint64_t>(key))
+				{
+					++failures;
+				}
+
+				std::pair<int, uint64_t> item;
+				int probe = rng() % (KEYS - 1);
+				if(!tree.lower_bound(probe, item) || item.first < probe || item.first > probe + 1 ||
+					item.second / VALUE_SCALE != static_cast<uint64_t>(item.first))
+				{
+					++failures;
+				}
+
+				if(rng() % 64 == 0)
+				{
+					int evens = 0;
+					int last = -1;
+					for(ConcurrentAVLTree<int, uint64_t>::iterator it = tree.begin(); it != tree.end(); ++it)
+					{
+						if(it->first <= last)
+						{
+							++failures;
+						}
+						last = it->first;
+						evens += (it->first % 2 == 0);
+					}
+					if(evens != KEYS / 2)
+					{
+						++failures;
+					}
+				}
+			}
+		}));
+	}
+
+	std::map<int, uint64_t> expected;
+	for(int key = 0; key < KEYS; key += 2)
+	{
+		expected[key] = key * VALUE_SCALE;
+	}
+	std::mt19937 rng(99);
+	for(int i = 0; i < WRITES; ++i)
+	{
+		int key = rng() % KEYS;
+		uint64_t value = key * VALUE_SCALE + i % VALUE_SCALE;
+		if(key % 2 == 1 && rng() % 2 == 0)
+		{
+			tree.remove(key);
+			expected.erase(key);
+		}
+		else
+		{
+			tree.insert(std::make_pair(key, value));
+			expected[key] = value;
+		}
+	}
+	done = true;
+	for(size_t r = 0; r < readers.size(); ++r)
+	{
+		readers[r].join();
+	}
+
+	EXPECT_EQ(0, failures.load());
+	ASSERT_EQ(expected.size(), tree.size());
+	for(std::map<int, uint64_t>::iterator it = expected.begin(); it != expected.end(); ++it)
+	{
+		uint64_t value;
+		ASSERT_TRUE(tree.find(it->first, value));
+		EXPECT_EQ(it->second, value);
+	}
+}
@@ -0,0 +1,166 @@
+#include <avlbst.h>
+
+#include <gtest/gtest.h>
+
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+
+// Counts how often values are copied or moved, construction or assignment
+struct Counted
+{
+	static int copies;
+	static int moves;
+
+	explicit Counted(int v = 0) : value(v) { }
+	Counted(const Counted& other) : value(other.value) { ++copies; }
+	Counted(Counted&& other) : value(other.value) { other.value = -1; ++moves; }
+	Counted& operator=(const Counted& other) { value = other.value; ++copies; return *this; }
+	Counted& operator=(Counted&& other) { value = other.value; other.value = -1; ++moves; return *this; }
+
+	static void reset() { copies = 0; moves = 0; }
+
+	int value;
+};
+
+int Counted::copies = 0;
+int Counted::moves = 0;
+
+// print() is virtual, so every value type needs one of these
+static std::ostream& operator<<(std::ostream& out, const Counted& counted)
+{
+	return out << counted.value;
+}
+
+// Can only ever be constructed in place
+struct Pinned
+{
+	explicit Pinned(int v) : value(v) { }
+	Pinned(const Pinned&) = delete;
+	Pinned& operator=(const Pinned&) = delete;
+
+	int value;
+};
+
+static std::ostream& operator<<(std::ostream& out, const Pinned& pinned)
+{
+	return out << pinned.value;
+}
+
+TEST(Emplace, ReturnsIteratorAndWhetherInserted)
+{
+	BinarySearchTree<int, std::string> tree;
+	std::pair<BinarySearchTree<int, std::string>::iterator, bool> result = tree.emplace(1, "one");
+	EXPECT_TRUE(result.second);
+	ASSERT_NE(tree.end(), result.first);
+	EXPECT_EQ(1, result.first->first);
+	EXPECT_EQ("one", result.first->second);
+
+	// an existing value is left alone
+	result = tree.emplace(1, "uno");
+	EXPECT_FALSE(result.second);
+	EXPECT_EQ("one", result.first->second);
+	EXPECT_EQ(1u, tree.size());
+
+	result = tree.emplace(std::piecewise_construct, std::forward_as_tuple(2), std::forward_as_tuple(3, 'x'));
+	EXPECT_TRUE(result.second);
+	EXPECT_EQ("xxx", result.first->second);
+	EXPECT_EQ(2u, tree.size());
+}
+
+TEST(Emplace, BuildsValuesInPlace)
+{
+	AVLTree<int, Counted> tree;
+	Counted::reset();
+	tree.emplace(std::piecewise_construct, std::forward_as_tuple(1), std::forward_as_tuple(10));
+	tree.try_emplace(2, 20);
+	EXPECT_EQ(0, Counted::copies);
+	EXPECT_EQ(0, Counted::moves);
+
+	// an already built value is moved once, straight into the node
+	Counted value(30);
+	Counted::reset();
+	tree.emplace(3, std::move(value));
+	EXPECT_EQ(0, Counted::copies);
+	EXPECT_EQ(1, Counted::moves);
+	EXPECT_EQ(30, tree.find(3)->second.value);
+	EXPECT_TRUE(tree.isBalanced());
+}
+
+TEST(Emplace, FailedTryEmplaceLeavesArgumentsAlone)
+{
+	BinarySearchTree<std::string, std::string> tree;
+	EXPECT_TRUE(tree.try_emplace("a", "first").second);
+
+	std::string key = "a";
+	std::string value = "second";
+	std::pair<BinarySearchTree<std::string, std::string>::iterator, bool> result =
+		tree.try_emplace(std::move(key), std::move(value));
+	EXPECT_FALSE(result.second);
+	EXPECT_EQ("first", result.first->second);
+	EXPECT_EQ("a", key);
+	EXPECT_EQ("second", value);
+
+	result = tree.try_emplace(std::move(key), std::move(value));
+	EXPECT_FALSE(result.second);
+	EXPECT_EQ("second", value);
+}
+
+TEST(Emplace, InsertOrAssignMovesTheValue)
+{
+	AVLTree<int, Counted> tree;
+	Counted value(1);
+	Counted::reset();
+	std::pair<AVLTree<int, Counted>::iterator, bool> result = tree.insert_or_assign(1, std::move(value));
+	EXPECT_TRUE(result.second);
+	EXPECT_EQ(1, Counted::moves);
+
+	Counted other(2);
+	Counted::reset();
+	result = tree.insert_or_assign(1, std::move(other));
+	EXPECT_FALSE(result.second);
+	EXPECT_EQ(2, result.first->second.value);
+	EXPECT_EQ(-1, other.value);
+	EXPECT_EQ(0, Counted::copies);
+	EXPECT_EQ(1, Counted::moves);
+	EXPECT_EQ(1u, tree.size());
+}
+
+TEST(Emplace, RvalueInsertMovesAndOverwrites)
+{
+	AVLTree<int, Counted> tree;
+	std::pair<int, Counted> item(4, Counted(4));
+	Counted::reset();
+	std::pair<AVLTree<int, Counted>::iterator, bool> result = tree.insert(std::move(item));
+	EXPECT_TRUE(result.second);
+	EXPECT_EQ(4, result.first->second.value);
+	EXPECT_EQ(0, Counted::copies);
+	EXPECT_EQ(1, Counted::moves);
+
+	std::pair<int, Counted> update(4, Counted(40));
+	Counted::reset();
+	result = tree.insert(std::move(update));
+	EXPECT_FALSE(result.second);
+	EXPECT_EQ(40, result.first->second.value);
+	EXPECT_EQ(0, Counted::copies);
+	EXPECT_EQ(1, Counted::moves);
+}
+
+TEST(Emplace, ValuesThatCannotMove)
+{
+	AVLTree<int, Pinned> tree;
+	EXPECT_TRUE(tree.try_emplace(1, 10).second);
+	EXPECT_TRUE(tree.emplace(std::piecewise_construct, std::forward_as_tuple(2), std::forward_as_tuple(20)).second);
+	EXPECT_FALSE(tree.try_emplace(1, 11).second);
+	EXPECT_EQ(10, tree.find(1)->second.value);
+	EXPECT_EQ(20, tree.find(2)->second.value);
+
+	// the copying insert has to exist, but cannot work
+	std::pair<const int, Pinned> item(std::piecewise_construct, std::forward_as_tuple(3), std::forward_as_tuple(30));
+	EXPECT_THROW(tree.insert(item), std::logic_error);
+	EXPECT_EQ(2u, tree.size());
+	tree.remove(1);
+	EXPECT_EQ(1u, tree.size());
+}
@@ -0,0 +1,115 @@
+#include <avlbst.h>
+#include <rbbst.h>
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// findBatch() must give exactly what a loop of find() gives
+template<typename Tree, typename Key>
+static void expectSameAsFind(const Tree& tree, const std::vector<Key>& keys)
+{
+	std::vector<typename Tree::iterator> out(3, tree.begin());
+	tree.findBatch(keys, out);
+	ASSERT_EQ(keys.size(), out.size());
+	for(std::size_t i = 0; i < keys.size(); ++i)
+	{
+		EXPECT_EQ(tree.find(keys[i]), out[i]) << "probe " << i;
+	}
+}
+
+// count random probes in [-100, 1900), which covers the whole tree and
+// some misses on either side of it
+static std::vector<int> probes(std::size_t count, std::mt19937& rng)
+{
+	std::vector<int> keys;
+	for(std::size_t i = 0; i < count; ++i)
+	{
+		keys.push_back(static_cast<int>(rng() % 2000) - 100);
+	}
+	return keys;
+}
+
+TEST(FindBatch, MatchesFind)
+{
+	AVLTree<int, int> avl;
+	RBTree<int, int> rb;
+	BinarySearchTree<int, int> plain;
+	std::mt19937 rng(15);
+	// the even keys below 1800, in a scrambled order
+	for(int i = 0; i < 900; ++i)
+	{
+		int key = (i * 7919) % 900 * 2;
+		avl.insert(std::make_pair(key, i));
+		rb.insert(std::make_pair(key, i));
+		plain.insert(std::make_pair(key, i));
+	}
+	ASSERT_EQ(900u, avl.size());
+
+	// whole batches, a part batch, and sizes either side of a batch
+	const std::size_t sizes[] = { 0, 1, 5, 15, 16, 17, 31, 32, 33, 100, 1000 };
+	for(std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+	{
+		SCOPED_TRACE(sizes[s]);
+		std::vector<int> keys = probes(sizes[s], rng);
+		expectSameAsFind(avl, keys);
+		expectSameAsFind(rb, keys);
+		expectSameAsFind(plain, keys);
+	}
+}
+
+TEST(FindBatch, AllHitsAllMissesAndRepeats)
+{
+	AVLTree<int, int> tree;
+	for(int key = 0; key < 100; ++key)
+	{
+		tree.insert(std::make_pair(key * 3, key));
+	}
+
+	std::vector<int> hits, misses, repeats;
+	for(int i = 0; i < 37; ++i)
+	{
+		hits.push_back((i * 11 % 100) * 3);
+		misses.push_back(i % 2 == 0 ? i * 3 + 1 : -i);
+		repeats.push_back(42);
+	}
+	misses.push_back(1000);
+
+	std::vector<AVLTree<int, int>::iterator> out;
+	tree.findBatch(hits, out);
+	for(std::size_t i = 0; i < hits.size(); ++i)
+	{
+		ASSERT_NE(tree.end(), out[i]);
+		EXPECT_EQ(hits[i], out[i]->first);
+	}
+	tree.findBatch(misses, out);
+	for(std::size_t i = 0; i < misses.size(); ++i)
+	{
+		EXPECT_EQ(tree.end(), out[i]) << misses[i];
+	}
+	tree.findBatch(repeats, out);
+	for(std::size_t i = 0; i < repeats.size(); ++i)
+	{
+		EXPECT_EQ(14, out[i]->second);
+	}
+}
+
+TEST(FindBatch, EmptyTreeAndStringKeys)
+{
+	AVLTree<std::string, int> tree;
+	std::vector<std::string> keys;
+	for(int i = 0; i < 20; ++i)
+	{
+		keys.push_back(std::to_string(i));
+	}
+	expectSameAsFind(tree, keys);
+
+	for(int i = 0; i < 40; i += 3)
+	{
+		tree.insert(std::make_pair(std::to_string(i), i));
+	}
+	expectSameAsFind(tree, keys);
+}
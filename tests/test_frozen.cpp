@@ -0,0 +1,104 @@
+#include <avlbst.h>
+#include <frozen_tree.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <utility>
+#include <vector>
+
+// Sizes around the edges of one block of keys, and enough for several levels
+template<typename Key>
+static std::vector<std::size_t> sizesToTry()
+{
+	const std::size_t width = BlockSearch<Key, std::less<Key> >::WIDTH;
+	std::size_t sizes[] = { 0, 1, 2, width - 1, width, width + 1, width * (width + 1) - 1,
+		width * (width + 1), width * (width + 1) + 1, 5000 };
+	return std::vector<std::size_t>(sizes, sizes + sizeof(sizes) / sizeof(sizes[0]));
+}
+
+// Odd keys 1, 3, 5 ..., so every key has a missing neighbour on both sides
+template<typename Key>
+static std::map<Key, int> oddKeys(std::size_t count)
+{
+	std::map<Key, int> items;
+	for(std::size_t i = 0; i < count; ++i)
+	{
+		items[static_cast<Key>(2 * i + 1)] = static_cast<int>(i) * 7;
+	}
+	return items;
+}
+
+// Compares find, lower_bound and upper_bound with std::map at every key
+// and every gap
+template<typename Key>
+static void expectSameAsMap(const std::map<Key, int>& expected, const FrozenTree<Key, int>& tree)
+{
+	ASSERT_EQ(expected.size(), tree.size());
+	EXPECT_EQ(expected.empty(), tree.empty());
+	typename FrozenTree<Key, int>::iterator it = tree.begin();
+	for(typename std::map<Key, int>::const_iterator want = expected.begin(); want != expected.end(); ++want, ++it)
+	{
+		ASSERT_EQ(want->first, it->first);
+		EXPECT_EQ(want->second, it->second);
+	}
+	EXPECT_EQ(tree.end(), it);
+
+	const Key last = static_cast<Key>(2 * expected.size() + 2);
+	for(Key key = 0; key <= last; ++key)
+	{
+		typename std::map<Key, int>::const_iterator found = expected.find(key);
+		typename std::map<Key, int>::const_iterator lower = expected.lower_bound(key);
+		typename std::map<Key, int>::const_iterator upper = expected.upper_bound(key);
+		EXPECT_EQ(std::distance(expected.begin(), found), tree.find(key) - tree.begin()) << key;
+		EXPECT_EQ(std::distance(expected.begin(), lower), tree.lower_bound(key) - tree.begin()) << key;
+		EXPECT_EQ(std::distance(expected.begin(), upper), tree.upper_bound(key) - tree.begin()) << key;
+	}
+}
+
+template<typename Key>
+static void checkFrozen()
+{
+	std::vector<std::size_t> sizes = sizesToTry<Key>();
+	for(std::size_t i = 0; i < sizes.size(); ++i)
+	{
+		SCOPED_TRACE(sizes[i]);
+		std::map<Key, int> expected = oddKeys<Key>(sizes[i]);
+		AVLTree<Key, int> tree;
+		for(typename std::map<Key, int>::iterator it = expected.begin(); it != expected.end(); ++it)
+		{
+			tree.insert(*it);
+		}
+		expectSameAsMap(expected, tree.freeze());
+		// straight from sorted items too
+		expectSameAsMap(expected, FrozenTree<Key, int>(expected.begin(), expected.end()));
+	}
+}
+
+TEST(Frozen, MatchesMapForIntKeys)
+{
+	checkFrozen<int32_t>();
+}
+
+TEST(Frozen, MatchesMapForWideKeys)
+{
+	checkFrozen<uint64_t>();
+}
+
+TEST(Frozen, FreezeIsASnapshot)
+{
+	AVLTree<int, int> tree;
+	for(int key = 0; key < 100; ++key)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+	FrozenTree<int, int> frozen = tree.freeze();
+	tree.remove(50);
+	tree.insert(std::make_pair(200, 200));
+	EXPECT_EQ(100u, frozen.size());
+	EXPECT_NE(frozen.end(), frozen.find(50));
+	EXPECT_EQ(frozen.end(), frozen.find(200));
+}
@@ -0,0 +1,90 @@
+#include <avlbst.h>
+#include <rbbst.h>
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <utility>
+
+template<typename Tree>
+static void expectSameItems(const std::map<int, int>& expected, const Tree& tree)
+{
+	ASSERT_TRUE(tree.validate().valid()) << tree.validate().problem;
+	ASSERT_EQ(expected.size(), tree.size());
+	typename Tree::iterator it = tree.begin();
+	for(std::map<int, int>::const_iterator want = expected.begin(); want != expected.end(); ++want, ++it)
+	{
+		EXPECT_EQ(want->first, it->first);
+		EXPECT_EQ(want->second, it->second);
+	}
+}
+
+TEST(HintedInsert, CorrectHint)
+{
+	AVLTree<int, int> tree;
+	std::map<int, int> expected;
+	for(int key = 0; key < 200; key += 2)
+	{
+		tree.insert(std::make_pair(key, key));
+		expected[key] = key;
+	}
+	// every odd key goes right before the next even one
+	for(int key = 1; key < 200; key += 2)
+	{
+		AVLTree<int, int>::iterator hint = tree.find(key + 1);
+		AVLTree<int, int>::iterator it = tree.insert(hint, std::make_pair(key, -key));
+		ASSERT_NE(tree.end(), it);
+		EXPECT_EQ(key, it->first);
+		expected[key] = -key;
+	}
+	expectSameItems(expected, tree);
+	EXPECT_TRUE(tree.isBalanced());
+
+	// a hint at the key itself overwrites
+	AVLTree<int, int>::iterator it = tree.insert(tree.find(50), std::make_pair(50, 5));
+	EXPECT_EQ(5, it->second);
+	expected[50] = 5;
+	expectSameItems(expected, tree);
+}
+
+TEST(HintedInsert, WrongHint)
+{
+	AVLTree<int, int> avl;
+	RBTree<int, int> rb;
+	std::map<int, int> expected;
+	std::mt19937 rng(5);
+	for(int i = 0; i < 2000; ++i)
+	{
+		int key = static_cast<int>(rng() % 500);
+		int at = static_cast<int>(rng() % 500);
+		// any key already in the tree, usually not the right one
+		avl.insert(expected.empty() ? avl.end() : avl.lower_bound(at), std::make_pair(key, i));
+		rb.insert(expected.empty() ? rb.end() : rb.lower_bound(at), std::make_pair(key, i));
+		expected[key] = i;
+	}
+	expectSameItems(expected, avl);
+	expectSameItems(expected, rb);
+	EXPECT_TRUE(avl.isBalanced());
+}
+
+TEST(HintedInsert, EndHint)
+{
+	AVLTree<int, int> tree;
+	std::map<int, int> expected;
+	// appends, then keys that do not belong at the end
+	for(int key = 0; key < 300; ++key)
+	{
+		tree.insert(tree.end(), std::make_pair(key * 3, key));
+		expected[key * 3] = key;
+	}
+	for(int key = 0; key < 300; key += 5)
+	{
+		tree.insert(tree.end(), std::make_pair(key * 3 + 1, -key));
+		expected[key * 3 + 1] = -key;
+	}
+	tree.insert(tree.end(), std::make_pair(0, 100));
+	expected[0] = 100;
+	expectSameItems(expected, tree);
+	EXPECT_TRUE(tree.isBalanced());
+}
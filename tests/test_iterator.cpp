@@ -0,0 +1,197 @@
+#include "publicified_trees.h"
+#include <rbbst.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+template<typename Tree>
+static std::vector<int> forwardKeys(const Tree& tree)
+{
+	std::vector<int> keys;
+	for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it)
+	{
+		keys.push_back(it->first);
+	}
+	return keys;
+}
+
+template<typename Tree>
+static std::vector<int> backwardKeys(const Tree& tree)
+{
+	std::vector<int> keys;
+	typename Tree::iterator it = tree.end();
+	while(it != tree.begin())
+	{
+		--it;
+		keys.push_back(it->first);
+	}
+	return keys;
+}
+
+// The cached smallest and largest nodes must be the ends of the spines
+template<typename Tree>
+static void expectBounds(const Tree& tree)
+{
+	Node<int, int>* smallest = tree.root_;
+	Node<int, int>* largest = tree.root_;
+	while(smallest != NULL && smallest->getLeft() != NULL)
+	{
+		smallest = smallest->getLeft();
+	}
+	while(largest != NULL && largest->getRight() != NULL)
+	{
+		largest = largest->getRight();
+	}
+	EXPECT_EQ(smallest, tree.getSmallestNode());
+	EXPECT_EQ(largest, tree.getLargestNode());
+	if(largest != NULL)
+	{
+		typename Tree::iterator last = tree.end();
+		--last;
+		EXPECT_EQ(largest->getKey(), last->first);
+		EXPECT_EQ(smallest->getKey(), tree.begin()->first);
+	}
+}
+
+TEST(Iterator, DecrementFromEndReachesTheLargest)
+{
+	AVLTree<int, int> tree;
+	EXPECT_EQ(tree.begin(), tree.end());
+
+	tree.insert(std::make_pair(5, 50));
+	AVLTree<int, int>::iterator it = tree.end();
+	--it;
+	EXPECT_EQ(5, it->first);
+	EXPECT_EQ(tree.begin(), it);
+
+	for(int key = 0; key < 10; ++key)
+	{
+		tree.insert(std::make_pair(key, key * 10));
+	}
+	it = tree.end();
+	AVLTree<int, int>::iterator old = it--;
+	EXPECT_EQ(tree.end(), old);
+	EXPECT_EQ(9, it->first);
+	EXPECT_EQ(90, it->second);
+	++it;
+	EXPECT_EQ(tree.end(), it);
+}
+
+TEST(Iterator, BackwardIsForwardReversed)
+{
+	std::mt19937 rng(8);
+	AVLTree<int, int> avl;
+	RBTree<int, int> rb;
+	SplayTree<int, int> splay;
+	BinarySearchTree<int, int> plain;
+	for(int i = 0; i < 3000; ++i)
+	{
+		int key = static_cast<int>(rng() % 1000);
+		if(rng() % 3 == 0)
+		{
+			avl.remove(key);
+			rb.remove(key);
+			splay.remove(key);
+			plain.remove(key);
+		}
+		else
+		{
+			avl.insert(std::make_pair(key, i));
+			rb.insert(std::make_pair(key, i));
+			splay.insert(std::make_pair(key, i));
+			plain.insert(std::make_pair(key, i));
+		}
+	}
+
+	std::vector<int> forward = forwardKeys(avl);
+	ASSERT_FALSE(forward.empty());
+	EXPECT_TRUE(std::is_sorted(forward.begin(), forward.end()));
+	std::vector<int> backward(forward.rbegin(), forward.rend());
+	EXPECT_EQ(backward, backwardKeys(avl));
+	EXPECT_EQ(backward, backwardKeys(rb));
+	EXPECT_EQ(backward, backwardKeys(splay));
+	EXPECT_EQ(backward, backwardKeys(plain));
+	EXPECT_EQ(forward, forwardKeys(splay));
+}
+
+TEST(Iterator, BoundsAfterRemovingTheEnds)
+{
+	AVLTree<int, int> avl;
+	SplayTree<int, int> splay;
+	BinarySearchTree<int, int> plain;
+	for(int i = 0; i < 64; ++i)
+	{
+		int key = (i * 29) % 64;
+		avl.insert(std::make_pair(key, key));
+		splay.insert(std::make_pair(key, key));
+		plain.insert(std::make_pair(key, key));
+	}
+
+	// peel the smallest and largest keys off alternately
+	for(int lo = 0, hi = 63; lo < hi; ++lo, --hi)
+	{
+		avl.remove(lo);
+		splay.remove(lo);
+		plain.remove(lo);
+		expectBounds(avl);
+		expectBounds(splay);
+		expectBounds(plain);
+		EXPECT_EQ(lo + 1, avl.begin()->first);
+
+		avl.remove(hi);
+		splay.remove(hi);
+		plain.remove(hi);
+		expectBounds(avl);
+		expectBounds(splay);
+		expectBounds(plain);
+	}
+	EXPECT_TRUE(avl.empty());
+	EXPECT_EQ(NULL, avl.getSmallestNode());
+	EXPECT_EQ(NULL, avl.getLargestNode());
+	EXPECT_EQ(avl.begin(), avl.end());
+}
+
+TEST(Iterator, BoundsAfterSplitAndJoin)
+{
+	AVLTree<int, int> tree, upper;
+	for(int key = 0; key < 500; ++key)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+
+	tree.split(200, upper);
+	expectBounds(tree);
+	expectBounds(upper);
+	EXPECT_EQ(199, (--tree.end())->first);
+	EXPECT_EQ(200, upper.begin()->first);
+	EXPECT_EQ(499, (--upper.end())->first);
+
+	// a split point past either end leaves one side empty
+	AVLTree<int, int> none;
+	upper.split(1000, none);
+	expectBounds(upper);
+	expectBounds(none);
+	EXPECT_TRUE(none.empty());
+
+	tree.join(upper);
+	expectBounds(tree);
+	expectBounds(upper);
+	EXPECT_EQ(0, tree.begin()->first);
+	EXPECT_EQ(499, (--tree.end())->first);
+
+	tree.split(0, upper);
+	expectBounds(tree);
+	EXPECT_TRUE(tree.empty());
+	tree.join(-1, -1, upper);
+	expectBounds(tree);
+	EXPECT_EQ(-1, tree.begin()->first);
+	EXPECT_EQ(499, (--tree.end())->first);
+	std::vector<int> backward = backwardKeys(tree);
+	ASSERT_EQ(501u, backward.size());
+	EXPECT_EQ(-1, backward.back());
+}
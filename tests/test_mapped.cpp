@@ -0,0 +1,218 @@
+#include <avlbst.h>
+#include <mapped_tree.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+// Sizes around the edges of one block of keys, and enough for several levels
+template<typename Key>
+static std::vector<std::size_t> sizesToTry()
+{
+	const std::size_t width = BlockSearch<Key, std::less<Key> >::WIDTH;
+	std::size_t sizes[] = { 0, 1, 2, width - 1, width, width + 1, width * (width + 1) - 1,
+		width * (width + 1), width * (width + 1) + 1, 5000 };
+	return std::vector<std::size_t>(sizes, sizes + sizeof(sizes) / sizeof(sizes[0]));
+}
+
+// Odd keys 1, 3, 5 ..., so every key has a missing neighbour on both sides
+template<typename Key>
+static std::map<Key, int> oddKeys(std::size_t count)
+{
+	std::map<Key, int> items;
+	for(std::size_t i = 0; i < count; ++i)
+	{
+		items[static_cast<Key>(2 * i + 1)] = static_cast<int>(i) * 7;
+	}
+	return items;
+}
+
+// Compares find, lower_bound and upper_bound with std::map at every key
+// and every gap
+template<typename Key>
+static void expectSameAsMap(const std::map<Key, int>& expected, const MappedTree<Key, int>& tree)
+{
+	ASSERT_EQ(expected.size(), tree.size());
+	EXPECT_EQ(expected.empty(), tree.empty());
+	typename MappedTree<Key, int>::iterator it = tree.begin();
+	for(typename std::map<Key, int>::const_iterator want = expected.begin(); want != expected.end(); ++want, ++it)
+	{
+		ASSERT_EQ(want->first, it->first);
+		EXPECT_EQ(want->second, it->second);
+	}
+	EXPECT_EQ(tree.end(), it);
+
+	const Key last = static_cast<Key>(2 * expected.size() + 2);
+	for(Key key = 0; key <= last; ++key)
+	{
+		typename std::map<Key, int>::const_iterator found = expected.find(key);
+		typename std::map<Key, int>::const_iterator lower = expected.lower_bound(key);
+		typename std::map<Key, int>::const_iterator upper = expected.upper_bound(key);
+		EXPECT_EQ(std::distance(expected.begin(), found), tree.find(key) - tree.begin()) << key;
+		EXPECT_EQ(std::distance(expected.begin(), lower), tree.lower_bound(key) - tree.begin()) << key;
+		EXPECT_EQ(std::distance(expected.begin(), upper), tree.upper_bound(key) - tree.begin()) << key;
+	}
+}
+
+static std::string imagePath(const char* name)
+{
+	std::ostringstream path;
+	path << ::testing::TempDir() << "mapped_test_" << ::getpid() << "_" << name << ".img";
+	return path.str();
+}
+
+static std::string readFile(const std::string& path)
+{
+	std::ifstream in(path.c_str(), std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::string& bytes)
+{
+	std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+	out.write(bytes.data(), bytes.size());
+}
+
+template<typename Key>
+static void checkRoundTrip()
+{
+	std::vector<std::size_t> sizes = sizesToTry<Key>();
+	for(std::size_t i = 0; i < sizes.size(); ++i)
+	{
+		SCOPED_TRACE(sizes[i]);
+		std::map<Key, int> expected = oddKeys<Key>(sizes[i]);
+		AVLTree<Key, int> tree;
+		for(typename std::map<Key, int>::iterator it = expected.begin(); it != expected.end(); ++it)
+		{
+			tree.insert(*it);
+		}
+
+		std::string path = imagePath("round_trip");
+		MappedTree<Key, int>::write(tree.freeze(), path);
+		{
+			MappedTree<Key, int> mapped(path);
+			expectSameAsMap(expected, mapped);
+		}
+		std::remove(path.c_str());
+	}
+}
+
+TEST(Mapped, RoundTripForIntKeys)
+{
+	checkRoundTrip<int32_t>();
+}
+
+TEST(Mapped, RoundTripForWideKeys)
+{
+	checkRoundTrip<uint64_t>();
+}
+
+TEST(Mapped, ImagePaddingIsZeroed)
+{
+	typedef std::pair<const int32_t, int64_t> Item;
+	ASSERT_LT(sizeof(int32_t) + sizeof(int64_t), sizeof(Item));
+
+	// items built over junk keep it in their padding, and copies of them
+	// usually carry it along
+	const int count = 64;
+	std::vector<char> storage(count * sizeof(Item) + alignof(Item), '\xAB');
+	Item* items = reinterpret_cast<Item*>(&storage[0] + (alignof(Item) -
+		reinterpret_cast<std::uintptr_t>(&storage[0]) % alignof(Item)) % alignof(Item));
+	for(int key = 0; key < count; ++key)
+	{
+		new (&items[key]) Item(key, static_cast<int64_t>(key) << 40);
+	}
+	FrozenTree<int32_t, int64_t> frozen(items, items + count);
+
+	std::ostringstream out;
+	MappedTree<int32_t, int64_t>::write(frozen, out);
+	std::string image = out.str();
+
+	// the items are the first section after the 64 byte aligned header
+	const Item& first = *frozen.begin();
+	std::size_t keyEnd = reinterpret_cast<const char*>(&first.first) - reinterpret_cast<const char*>(&first) + sizeof(int32_t);
+	std::size_t valueStart = reinterpret_cast<const char*>(&first.second) - reinterpret_cast<const char*>(&first);
+	ASSERT_LT(keyEnd, valueStart);
+	// the header is 80 bytes, so the items start at 128
+	const std::size_t itemsOffset = 128;
+	int64_t value;
+	std::memcpy(&value, &image[itemsOffset + sizeof(Item) + valueStart], sizeof(value));
+	ASSERT_EQ(static_cast<int64_t>(1) << 40, value);
+	for(std::size_t i = 0; i < frozen.size(); ++i)
+	{
+		for(std::size_t b = keyEnd; b < valueStart; ++b)
+		{
+			EXPECT_EQ('\0', image[itemsOffset + i * sizeof(Item) + b]) << "item " << i << ", byte " << b;
+		}
+	}
+
+	// and the values still come back
+	std::string path = imagePath("padding");
+	writeFile(path, image);
+	{
+		MappedTree<int32_t, int64_t> mapped(path);
+		ASSERT_EQ(64u, mapped.size());
+		EXPECT_EQ(static_cast<int64_t>(33) << 40, mapped.find(33)->second);
+	}
+	std::remove(path.c_str());
+}
+
+TEST(Mapped, RejectsBadImages)
+{
+	AVLTree<int32_t, int32_t> tree;
+	for(int key = 0; key < 1000; ++key)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+	std::string path = imagePath("bad");
+	MappedTree<int32_t, int32_t>::write(tree.freeze(), path);
+	const std::string good = readFile(path);
+	{
+		MappedTree<int32_t, int32_t> mapped(path);
+		EXPECT_EQ(1000u, mapped.size());
+	}
+
+	// the wrong key type
+	EXPECT_THROW((MappedTree<int64_t, int32_t>(path)), std::runtime_error);
+	// the wrong value type
+	EXPECT_THROW((MappedTree<int32_t, int64_t>(path)), std::runtime_error);
+
+	// the wrong version: the field after the 8 byte magic
+	std::string bytes = good;
+	uint32_t version = 2;
+	std::memcpy(&bytes[8], &version, sizeof(version));
+	writeFile(path, bytes);
+	EXPECT_THROW((MappedTree<int32_t, int32_t>(path)), std::runtime_error);
+
+	// not an image at all
+	bytes = good;
+	bytes[0] = 'X';
+	writeFile(path, bytes);
+	EXPECT_THROW((MappedTree<int32_t, int32_t>(path)), std::runtime_error);
+
+	// cut short: in the middle of the sections, and inside the header
+	writeFile(path, good.substr(0, good.size() - 1));
+	EXPECT_THROW((MappedTree<int32_t, int32_t>(path)), std::runtime_error);
+	writeFile(path, good.substr(0, good.size() / 2));
+	EXPECT_THROW((MappedTree<int32_t, int32_t>(path)), std::runtime_error);
+	writeFile(path, good.substr(0, 20));
+	EXPECT_THROW((MappedTree<int32_t, int32_t>(path)), std::runtime_error);
+	writeFile(path, "");
+	EXPECT_THROW((MappedTree<int32_t, int32_t>(path)), std::runtime_error);
+
+	std::remove(path.c_str());
+	EXPECT_THROW((MappedTree<int32_t, int32_t>(path)), std::runtime_error);
+}
@@ -0,0 +1,141 @@
+#include <avlbst.h>
+#include <node_pool.h>
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+
+typedef AVLTree<int, int> Tree;
+
+static std::shared_ptr<NodePool> makePool()
+{
+	return std::make_shared<NodePool>(sizeof(AVLNode<int, std::string>), 8);
+}
+
+TEST(NodePool, ReusesFreedBlocks)
+{
+	NodePool pool(24, 4);
+	std::set<void*> handedOut;
+	for(int i = 0; i < 4; ++i)
+	{
+		handedOut.insert(pool.allocate());
+	}
+	EXPECT_EQ(4u, handedOut.size());
+	EXPECT_EQ(1u, pool.slabCount());
+
+	// the last block freed is the next one handed out, with no new slab
+	void* block = *handedOut.begin();
+	pool.deallocate(block);
+	EXPECT_EQ(3u, pool.blocksInUse());
+	EXPECT_EQ(block, pool.allocate());
+	EXPECT_EQ(1u, pool.slabCount());
+	EXPECT_EQ(4u, pool.blocksInUse());
+
+	pool.allocate();
+	EXPECT_EQ(2u, pool.slabCount());
+}
+
+TEST(NodePool, TreeReusesSlotsAfterRemove)
+{
+	std::shared_ptr<NodePool> pool = makePool();
+	Tree tree(pool);
+	for(int key = 0; key < 100; ++key)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+	std::size_t slabs = pool->slabCount();
+	EXPECT_EQ(100u, pool->blocksInUse());
+
+	for(int round = 0; round < 10; ++round)
+	{
+		for(int key = 0; key < 100; key += 2)
+		{
+			tree.remove(key);
+		}
+		EXPECT_EQ(50u, pool->blocksInUse());
+		for(int key = 0; key < 100; key += 2)
+		{
+			tree.insert(std::make_pair(key, round));
+		}
+		EXPECT_EQ(100u, pool->blocksInUse());
+	}
+	EXPECT_EQ(slabs, pool->slabCount());
+	EXPECT_TRUE(tree.isBalanced());
+}
+
+TEST(NodePool, ClearReleasesSlabsOnlyWhenUnshared)
+{
+	std::shared_ptr<NodePool> pool = makePool();
+	{
+		Tree tree(pool);
+		for(int key = 0; key < 100; ++key)
+		{
+			tree.insert(std::make_pair(key, key));
+		}
+		// the test holds a reference too, so the slabs stay
+		ASSERT_EQ(2, pool.use_count());
+		std::size_t slabs = pool->slabCount();
+		tree.clear();
+		EXPECT_EQ(slabs, pool->slabCount());
+		EXPECT_EQ(0u, pool->blocksInUse());
+	}
+
+	// a tree that is the pool's only owner gives the slabs back
+	Tree tree;
+	for(int key = 0; key < 100; ++key)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+	NodePool* own = tree.getPool().get();
+	EXPECT_LT(0u, own->slabCount());
+	tree.clear();
+	EXPECT_EQ(0u, own->slabCount());
+
+	// values with destructors are destroyed first, then the slabs go
+	AVLTree<int, std::string> strings;
+	for(int key = 0; key < 100; ++key)
+	{
+		strings.insert(std::make_pair(key, std::string(100, 'x')));
+	}
+	strings.clear();
+	EXPECT_EQ(0u, strings.getPool()->slabCount());
+	EXPECT_TRUE(strings.empty());
+}
+
+TEST(NodePool, SharedPoolSurvivesClear)
+{
+	std::shared_ptr<NodePool> pool = makePool();
+	AVLTree<int, std::string> first(pool);
+	AVLTree<int, std::string> second(pool);
+	pool.reset();
+	for(int key = 0; key < 100; ++key)
+	{
+		first.insert(std::make_pair(key, std::to_string(key)));
+		second.insert(std::make_pair(key, std::to_string(-key)));
+	}
+	EXPECT_EQ(200u, first.getPool()->blocksInUse());
+
+	first.clear();
+	EXPECT_TRUE(first.empty());
+	EXPECT_EQ(100u, second.getPool()->blocksInUse());
+	EXPECT_LT(0u, second.getPool()->slabCount());
+	for(int key = 0; key < 100; ++key)
+	{
+		AVLTree<int, std::string>::iterator it = second.find(key);
+		ASSERT_NE(second.end(), it);
+		EXPECT_EQ(std::to_string(-key), it->second);
+	}
+
+	// the cleared tree can keep using the pool, starting with the freed blocks
+	std::size_t slabs = second.getPool()->slabCount();
+	for(int key = 0; key < 100; ++key)
+	{
+		first.insert(std::make_pair(key, std::to_string(key)));
+	}
+	EXPECT_EQ(slabs, first.getPool()->slabCount());
+	EXPECT_EQ(200u, first.getPool()->blocksInUse());
+	EXPECT_TRUE(second.isBalanced());
+}
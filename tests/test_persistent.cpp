@@ -0,0 +1,181 @@
+#include <persistent_avlbst.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+typedef PersistentAVLTree<int, int> Tree;
+
+static void expectSame(const std::map<int, int>& expected, const Tree& tree)
+{
+	ASSERT_EQ(expected.size(), tree.size());
+	ASSERT_TRUE(tree.isBalanced());
+	std::map<int, int>::const_iterator want = expected.begin();
+	for(Tree::iterator it = tree.begin(); it != tree.end(); ++it, ++want)
+	{
+		ASSERT_NE(expected.end(), want);
+		EXPECT_EQ(want->first, it->first);
+		EXPECT_EQ(want->second, it->second);
+	}
+}
+
+TEST(PersistentAVLTree, MatchesStdMap)
+{
+	Tree tree;
+	std::map<int, int> expected;
+	std::mt19937 rng(21);
+	for(int i = 0; i < 20000; ++i)
+	{
+		int key = rng() % 1000;
+		if(rng() % 3 == 0)
+		{
+			tree.remove(key);
+			expected.erase(key);
+		}
+		else
+		{
+			tree.insert(std::make_pair(key, i));
+			expected[key] = i;
+		}
+	}
+	expectSame(expected, tree);
+
+	for(int key = -1; key <= 1000; ++key)
+	{
+		std::map<int, int>::iterator it = expected.find(key);
+		Tree::iterator got = tree.find(key);
+		ASSERT_EQ(it == expected.end(), got == tree.end());
+		if(it != expected.end())
+		{
+			EXPECT_EQ(it->second, got->second);
+		}
+		it = expected.lower_bound(key);
+		got = tree.lower_bound(key);
+		ASSERT_EQ(it == expected.end(), got == tree.end());
+		if(it != expected.end())
+		{
+			EXPECT_EQ(it->first, got->first);
+		}
+	}
+}
+
+TEST(PersistentAVLTree, SnapshotsNeverChange)
+{
+	Tree tree;
+	std::map<int, int> expected;
+	std::vector<Tree> snapshots;
+	std::vector<std::map<int, int> > versions;
+	std::mt19937 rng(22);
+	for(int i = 0; i < 10000; ++i)
+	{
+		int key = rng() % 500;
+		if(rng() % 2 == 0)
+		{
+			tree.remove(key);
+			expected.erase(key);
+		}
+		else
+		{
+			tree.insert(std::make_pair(key, i));
+			expected[key] = i;
+		}
+		if(i % 250 == 0)
+		{
+			snapshots.push_back(tree.snapshot());
+			versions.push_back(expected);
+		}
+	}
+
+	for(size_t v = 0; v < snapshots.size(); ++v)
+	{
+		expectSame(versions[v], snapshots[v]);
+	}
+
+	// copies and assignment share the version they were taken from
+	Tree copy(snapshots[3]);
+	snapshots[3].clear();
+	expectSame(versions[3], copy);
+	copy = tree;
+	tree.clear();
+	expectSame(expected, copy);
+	EXPECT_TRUE(tree.empty());
+}
+
+// The writer keeps the keys [version - WINDOW, version] and publishes a
+// snapshot now and then; readers check whole snapshots on their own
+// threads and drop them there, which is where shared nodes get freed.
+TEST(PersistentAVLTree, SnapshotsReadOnOtherThreads)
+{
+	const int WINDOW = 200;
+	const int VERSIONS = 20000;
+	Tree tree;
+	std::mutex lock;
+	Tree published;
+	int publishedVersion = -1;
+	std::atomic<bool> done(false);
+	std::atomic<int> failures(0);
+
+	std::vector<std::thread> readers;
+	for(int r = 0; r < 3; ++r)
+	{
+		readers.push_back(std::thread([&]()
+		{
+			while(!done.load())
+			{
+				Tree snapshot;
+				int version;
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					snapshot = published;
+					version = publishedVersion;
+				}
+				if(version < 0)
+				{
+					continue;
+				}
+				int expectedKey = version > WINDOW ? version - WINDOW : 0;
+				for(Tree::iterator it = snapshot.begin(); it != snapshot.end(); ++it, ++expectedKey)
+				{
+					if(it->first != expectedKey || it->second != expectedKey)
+					{
+						++failures;
+						break;
+					}
+				}
+				if(expectedKey != version + 1 || !snapshot.isBalanced())
+				{
+					++failures;
+				}
+			}
+		}));
+	}
+
+	for(int version = 0; version < VERSIONS; ++version)
+	{
+		tree.insert(std::make_pair(version, version));
+		if(version > WINDOW)
+		{
+			tree.remove(version - WINDOW - 1);
+		}
+		if(version % 16 == 0)
+		{
+			Tree snapshot = tree.snapshot();
+			std::lock_guard<std::mutex> guard(lock);
+			published = snapshot;
+			publishedVersion = version;
+		}
+	}
+	done = true;
+	for(size_t r = 0; r < readers.size(); ++r)
+	{
+		readers[r].join();
+	}
+	EXPECT_EQ(0, failures.load());
+	EXPECT_EQ(static_cast<size_t>(WINDOW + 1), tree.size());
+}
@@ -0,0 +1,164 @@
+#include <avlbst.h>
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+typedef AVLTree<int, int> Tree;
+typedef std::vector<std::pair<int, int> > Items;
+
+// The keys 10, 20, ... 100, each mapped to its negation
+static void fillTens(Tree& tree, std::map<int, int>& expected)
+{
+	for(int key = 10; key <= 100; key += 10)
+	{
+		tree.insert(std::make_pair(key, -key));
+		expected[key] = -key;
+	}
+}
+
+static Items collect(const Tree& tree, int lo, int hi, std::size_t& visited)
+{
+	Items items;
+	visited = tree.forEachInRange(lo, hi, [&items](const std::pair<const int, int>& item)
+	{
+		items.push_back(std::make_pair(item.first, item.second));
+	});
+	return items;
+}
+
+static Items collect(const std::map<int, int>& expected, int lo, int hi)
+{
+	Items items;
+	if(lo < hi)
+	{
+		items.assign(expected.lower_bound(lo), expected.lower_bound(hi));
+	}
+	return items;
+}
+
+TEST(Range, EmptyTree)
+{
+	Tree tree;
+	EXPECT_EQ(tree.end(), tree.lower_bound(5));
+	EXPECT_EQ(tree.end(), tree.upper_bound(5));
+	std::pair<Tree::iterator, Tree::iterator> range = tree.equal_range(5);
+	EXPECT_EQ(tree.end(), range.first);
+	EXPECT_EQ(tree.end(), range.second);
+	std::size_t visited;
+	EXPECT_TRUE(collect(tree, 0, 100, visited).empty());
+	EXPECT_EQ(0u, visited);
+}
+
+TEST(Range, Bounds)
+{
+	Tree tree;
+	std::map<int, int> expected;
+	fillTens(tree, expected);
+
+	// below the smallest key
+	EXPECT_EQ(10, tree.lower_bound(-5)->first);
+	EXPECT_EQ(10, tree.upper_bound(-5)->first);
+	// above the largest
+	EXPECT_EQ(tree.end(), tree.lower_bound(101));
+	EXPECT_EQ(tree.end(), tree.upper_bound(101));
+	EXPECT_EQ(tree.end(), tree.upper_bound(100));
+	// exact hits and the gaps between them
+	EXPECT_EQ(40, tree.lower_bound(40)->first);
+	EXPECT_EQ(50, tree.upper_bound(40)->first);
+	EXPECT_EQ(50, tree.lower_bound(41)->first);
+	EXPECT_EQ(50, tree.upper_bound(41)->first);
+	EXPECT_EQ(100, tree.lower_bound(100)->first);
+
+	for(int key = 0; key <= 110; ++key)
+	{
+		std::map<int, int>::iterator lower = expected.lower_bound(key);
+		std::map<int, int>::iterator upper = expected.upper_bound(key);
+		Tree::iterator treeLower = tree.lower_bound(key);
+		Tree::iterator treeUpper = tree.upper_bound(key);
+		if(lower == expected.end())
+		{
+			EXPECT_EQ(tree.end(), treeLower) << key;
+		}
+		else
+		{
+			ASSERT_NE(tree.end(), treeLower) << key;
+			EXPECT_EQ(lower->first, treeLower->first);
+		}
+		if(upper == expected.end())
+		{
+			EXPECT_EQ(tree.end(), treeUpper) << key;
+		}
+		else
+		{
+			ASSERT_NE(tree.end(), treeUpper) << key;
+			EXPECT_EQ(upper->first, treeUpper->first);
+		}
+	}
+}
+
+TEST(Range, EqualRange)
+{
+	Tree tree;
+	std::map<int, int> expected;
+	fillTens(tree, expected);
+
+	// a hit spans exactly its own item
+	std::pair<Tree::iterator, Tree::iterator> range = tree.equal_range(30);
+	ASSERT_NE(tree.end(), range.first);
+	EXPECT_EQ(30, range.first->first);
+	EXPECT_EQ(-30, range.first->second);
+	Tree::iterator next = range.first;
+	++next;
+	EXPECT_EQ(next, range.second);
+
+	// a miss is empty, at the insertion point
+	range = tree.equal_range(35);
+	EXPECT_EQ(range.first, range.second);
+	EXPECT_EQ(40, range.first->first);
+	range = tree.equal_range(5);
+	EXPECT_EQ(range.first, range.second);
+	EXPECT_EQ(tree.begin(), range.first);
+	range = tree.equal_range(105);
+	EXPECT_EQ(tree.end(), range.first);
+	EXPECT_EQ(tree.end(), range.second);
+
+	// the largest key ends at end()
+	range = tree.equal_range(100);
+	EXPECT_EQ(100, range.first->first);
+	EXPECT_EQ(tree.end(), range.second);
+}
+
+TEST(Range, ForEachInRange)
+{
+	Tree tree;
+	std::map<int, int> expected;
+	fillTens(tree, expected);
+
+	// half-open [lo, hi), with bounds on and between the keys
+	const int probes[] = { -5, 0, 10, 15, 50, 55, 100, 101, 200 };
+	const int count = sizeof(probes) / sizeof(probes[0]);
+	for(int i = 0; i < count; ++i)
+	{
+		for(int j = 0; j < count; ++j)
+		{
+			std::size_t visited;
+			Items items = collect(tree, probes[i], probes[j], visited);
+			EXPECT_EQ(collect(expected, probes[i], probes[j]), items) << probes[i] << ", " << probes[j];
+			EXPECT_EQ(items.size(), visited);
+		}
+	}
+
+	std::size_t visited;
+	EXPECT_EQ(10u, collect(tree, -5, 200, visited).size());
+	// lo > hi and lo == hi visit nothing
+	EXPECT_TRUE(collect(tree, 60, 20, visited).empty());
+	EXPECT_EQ(0u, visited);
+	EXPECT_TRUE(collect(tree, 50, 50, visited).empty());
+	EXPECT_EQ(0u, visited);
+	// nor does a range that falls between two keys
+	EXPECT_TRUE(collect(tree, 51, 59, visited).empty());
+	EXPECT_EQ(0u, visited);
+}
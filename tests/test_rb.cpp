@@ -0,0 +1,175 @@
+#include "publicified_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+typedef RBTree<int, int> Tree;
+typedef RBNode<int, int> RBN;
+
+// Walks the subtree at node checking the red-black rules and returns its
+// black height (NULL leaves count as black), or -1 if a rule is broken
+static int checkedBlackHeight(const Node<int, int>* node, const Node<int, int>* parent)
+{
+	if(node == NULL)
+	{
+		return 1;
+	}
+	const RBN* rb = static_cast<const RBN*>(node);
+	EXPECT_EQ(parent, node->getParent()) << "at key " << node->getKey();
+	if(rb->getColor() == RBN::RED && parent != NULL && static_cast<const RBN*>(parent)->getColor() == RBN::RED)
+	{
+		ADD_FAILURE() << "red node " << node->getKey() << " has a red parent";
+		return -1;
+	}
+	int left = checkedBlackHeight(node->getLeft(), node);
+	int right = checkedBlackHeight(node->getRight(), node);
+	if(left < 0 || right < 0)
+	{
+		return -1;
+	}
+	if(left != right)
+	{
+		ADD_FAILURE() << "black heights " << left << " and " << right << " under key " << node->getKey();
+		return -1;
+	}
+	return left + (rb->getColor() == RBN::BLACK ? 1 : 0);
+}
+
+static void expectRedBlack(const Tree& tree)
+{
+	if(tree.root_ != NULL)
+	{
+		EXPECT_EQ(RBN::BLACK, static_cast<const RBN*>(tree.root_)->getColor()) << "the root is red";
+	}
+	EXPECT_LT(0, checkedBlackHeight(tree.root_, NULL));
+	EXPECT_TRUE(tree.isRedBlack());
+	EXPECT_TRUE(tree.validate().valid());
+}
+
+TEST(RedBlack, RandomInsertAndRemove)
+{
+	Tree tree;
+	std::map<int, int> expected;
+	std::mt19937 rng(17);
+	for(int i = 0; i < 4000; ++i)
+	{
+		int key = static_cast<int>(rng() % 600);
+		if(rng() % 5 < 2)
+		{
+			tree.remove(key);
+			expected.erase(key);
+		}
+		else
+		{
+			tree.insert(std::make_pair(key, i));
+			expected[key] = i;
+		}
+		if(i % 50 == 0)
+		{
+			expectRedBlack(tree);
+			if(::testing::Test::HasFailure())
+			{
+				FAIL() << "after operation " << i;
+			}
+		}
+	}
+	expectRedBlack(tree);
+
+	ASSERT_EQ(expected.size(), tree.size());
+	Tree::iterator it = tree.begin();
+	for(std::map<int, int>::iterator want = expected.begin(); want != expected.end(); ++want, ++it)
+	{
+		EXPECT_EQ(want->first, it->first);
+		EXPECT_EQ(want->second, it->second);
+	}
+
+	// at most twice the height of a perfect tree
+	int perfect = 0;
+	while((std::size_t(1) << perfect) - 1 < tree.size())
+	{
+		++perfect;
+	}
+	EXPECT_LE(tree.validate().height, 2 * perfect);
+}
+
+TEST(RedBlack, SortedInsertsAndDrainingRemoves)
+{
+	Tree tree;
+	for(int key = 0; key < 1000; ++key)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+	expectRedBlack(tree);
+	for(int key = 999; key >= 0; key -= 3)
+	{
+		tree.insert(std::make_pair(-key, key));
+	}
+	expectRedBlack(tree);
+
+	// take everything out again, from both ends and the middle
+	std::vector<int> keys;
+	for(Tree::iterator it = tree.begin(); it != tree.end(); ++it)
+	{
+		keys.push_back(it->first);
+	}
+	std::mt19937 rng(3);
+	std::shuffle(keys.begin(), keys.end(), rng);
+	for(std::size_t i = 0; i < keys.size(); ++i)
+	{
+		tree.remove(keys[i]);
+		if(i % 25 == 0)
+		{
+			expectRedBlack(tree);
+		}
+	}
+	EXPECT_TRUE(tree.empty());
+	expectRedBlack(tree);
+}
+
+TEST(RedBlack, BuildFromSorted)
+{
+	for(int n = 0; n < 70; ++n)
+	{
+		std::vector<std::pair<int, int> > items;
+		for(int key = 0; key < n; ++key)
+		{
+			items.push_back(std::make_pair(key, key));
+		}
+		Tree tree;
+		tree.buildFromSorted(items.begin(), items.end());
+		SCOPED_TRACE(n);
+		expectRedBlack(tree);
+		tree.insert(std::make_pair(n, n));
+		tree.remove(0);
+		expectRedBlack(tree);
+	}
+}
+
+TEST(RedBlack, IsRedBlackSpotsBrokenTrees)
+{
+	Tree tree;
+	for(int key = 0; key < 15; ++key)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+	ASSERT_TRUE(tree.isRedBlack());
+
+	// a red root
+	RBN* root = static_cast<RBN*>(tree.root_);
+	root->setColor(RBN::RED);
+	EXPECT_FALSE(tree.isRedBlack());
+	root->setColor(RBN::BLACK);
+
+	// one path a black node short
+	RBN* leaf = static_cast<RBN*>(tree.getSmallestNode());
+	RBN::Color color = leaf->getColor();
+	leaf->setColor(color == RBN::RED ? RBN::BLACK : RBN::RED);
+	EXPECT_FALSE(tree.isRedBlack());
+	leaf->setColor(color);
+	EXPECT_TRUE(tree.isRedBlack());
+}
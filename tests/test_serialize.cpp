@@ -0,0 +1,226 @@
+#include <avlbst.h>
+#include <codec.h>
+#include <rbbst.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A value that is not trivially copyable, so it needs a codec of its own
+struct Point
+{
+	Point() : x(0), y(0) { }
+	Point(int px, int py) : x(px), y(py) { }
+	Point(const Point& other) : x(other.x), y(other.y) { }
+	Point& operator=(const Point& other) { x = other.x; y = other.y; return *this; }
+
+	bool operator==(const Point& other) const { return x == other.x && y == other.y; }
+
+	int x;
+	int y;
+};
+
+static std::ostream& operator<<(std::ostream& out, const Point& point)
+{
+	return out << "(" << point.x << ", " << point.y << ")";
+}
+
+// Writes a point as text, "x,y;", to show that codecs control the format
+struct PointTextCodec
+{
+	static void write(std::ostream& out, const Point& point)
+	{
+		out << point.x << ',' << point.y << ';';
+	}
+
+	static Point read(std::istream& in)
+	{
+		Point point;
+		char comma = 0, semicolon = 0;
+		in >> point.x >> comma >> point.y >> semicolon;
+		if (comma != ',' || semicolon != ';')
+		{
+			in.setstate(std::ios::failbit);
+		}
+		return point;
+	}
+};
+
+// The items of tree as a std::map, for comparing trees of any kind
+template<typename Tree, typename Key, typename Value>
+static std::map<Key, Value> itemsOf(const Tree& tree)
+{
+	std::map<Key, Value> items;
+	for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it)
+	{
+		items.insert(std::make_pair(it->first, it->second));
+	}
+	return items;
+}
+
+// A stream with a valid header claiming count records
+static std::string header(uint64_t count)
+{
+	std::ostringstream out;
+	writeTreeStreamHeader(out, count);
+	return out.str();
+}
+
+template<typename T>
+static std::string record(const T& value)
+{
+	std::ostringstream out;
+	Codec<T>::write(out, value);
+	return out.str();
+}
+
+TEST(Serialize, RoundTrip)
+{
+	AVLTree<int, double> tree;
+	for(int key = 0; key < 1000; ++key)
+	{
+		tree.insert(std::make_pair((key * 613) % 1000, key / 4.0));
+	}
+	std::stringstream stream;
+	tree.serialize(stream);
+
+	AVLTree<int, double> copy;
+	copy.insert(std::make_pair(-1, -1.0));
+	copy.deserialize(stream);
+	EXPECT_EQ((itemsOf<AVLTree<int, double>, int, double>(tree)),
+		(itemsOf<AVLTree<int, double>, int, double>(copy)));
+	EXPECT_TRUE(copy.isBalanced());
+	// rebuilt in one pass, so as short as possible
+	EXPECT_EQ(10, copy.validate().height);
+
+	// the format does not depend on the kind of tree
+	stream.clear();
+	stream.seekg(0);
+	RBTree<int, double> rb;
+	rb.deserialize(stream);
+	EXPECT_EQ((itemsOf<AVLTree<int, double>, int, double>(tree)),
+		(itemsOf<RBTree<int, double>, int, double>(rb)));
+	EXPECT_TRUE(rb.validate().valid());
+}
+
+TEST(Serialize, EmptyTree)
+{
+	AVLTree<int, int> tree;
+	std::stringstream stream;
+	tree.serialize(stream);
+	EXPECT_EQ(header(0), stream.str());
+
+	AVLTree<int, int> copy;
+	copy.insert(std::make_pair(1, 1));
+	copy.deserialize(stream);
+	EXPECT_TRUE(copy.empty());
+}
+
+TEST(Serialize, Strings)
+{
+	AVLTree<std::string, std::string> tree;
+	tree.insert(std::make_pair(std::string(""), std::string("empty")));
+	tree.insert(std::make_pair(std::string("long"), std::string(10000, 'z')));
+	tree.insert(std::make_pair(std::string("nul"), std::string("a\0b", 3)));
+	std::stringstream stream;
+	tree.serialize(stream);
+
+	AVLTree<std::string, std::string> copy;
+	copy.deserialize(stream);
+	ASSERT_EQ(3u, copy.size());
+	EXPECT_EQ("empty", copy.find("")->second);
+	EXPECT_EQ(std::string(10000, 'z'), copy.find("long")->second);
+	EXPECT_EQ(std::string("a\0b", 3), copy.find("nul")->second);
+
+	// a string cut short fails instead of coming back shorter
+	std::string bytes = stream.str();
+	std::istringstream cut(bytes.substr(0, bytes.size() - 1));
+	EXPECT_THROW(copy.deserialize(cut), std::runtime_error);
+	EXPECT_EQ(3u, copy.size());
+}
+
+TEST(Serialize, CustomCodec)
+{
+	AVLTree<int, Point> tree;
+	for(int key = 0; key < 20; ++key)
+	{
+		tree.insert(std::make_pair(key, Point(key, -key)));
+	}
+	std::stringstream stream;
+	tree.serialize<Codec<int>, PointTextCodec>(stream);
+	EXPECT_NE(std::string::npos, stream.str().find("7,-7;"));
+
+	AVLTree<int, Point> copy;
+	copy.deserialize<Codec<int>, PointTextCodec>(stream);
+	ASSERT_EQ(20u, copy.size());
+	for(int key = 0; key < 20; ++key)
+	{
+		EXPECT_EQ(Point(key, -key), copy.find(key)->second);
+	}
+
+	// a malformed record is caught like a short one
+	std::string bad = header(1) + record<int>(1) + "1.2;";
+	std::istringstream in(bad);
+	EXPECT_THROW((copy.deserialize<Codec<int>, PointTextCodec>(in)), std::runtime_error);
+	EXPECT_EQ(20u, copy.size());
+}
+
+TEST(Serialize, RejectsBadStreams)
+{
+	AVLTree<int, int> tree;
+	for(int key = 0; key < 10; ++key)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+	std::stringstream stream;
+	tree.serialize(stream);
+	const std::string good = stream.str();
+
+	AVLTree<int, int> target;
+	target.insert(std::make_pair(100, 100));
+
+	// bad magic
+	std::string bytes = good;
+	bytes[0] = 'X';
+	std::istringstream badMagic(bytes);
+	EXPECT_THROW(target.deserialize(badMagic), std::runtime_error);
+
+	// unknown version, just after the 8 byte magic
+	bytes = good;
+	bytes[8] = 2;
+	std::istringstream badVersion(bytes);
+	EXPECT_THROW(target.deserialize(badVersion), std::runtime_error);
+
+	// truncated in the header, and in the records
+	std::istringstream shortHeader(good.substr(0, 12));
+	EXPECT_THROW(target.deserialize(shortHeader), std::runtime_error);
+	std::istringstream shortRecords(good.substr(0, good.size() - 2));
+	EXPECT_THROW(target.deserialize(shortRecords), std::runtime_error);
+	std::istringstream empty("");
+	EXPECT_THROW(target.deserialize(empty), std::runtime_error);
+
+	// a count far beyond the records
+	std::istringstream hugeCount(header(uint64_t(1) << 60) + record<int>(1) + record<int>(1));
+	EXPECT_THROW(target.deserialize(hugeCount), std::runtime_error);
+
+	// keys out of order, and repeated
+	std::istringstream unordered(header(2) + record<int>(5) + record<int>(0) + record<int>(3) + record<int>(0));
+	EXPECT_THROW(target.deserialize(unordered), std::runtime_error);
+	std::istringstream repeated(header(2) + record<int>(5) + record<int>(0) + record<int>(5) + record<int>(1));
+	EXPECT_THROW(target.deserialize(repeated), std::runtime_error);
+
+	// every failure left the tree as it was
+	ASSERT_EQ(1u, target.size());
+	EXPECT_EQ(100, target.find(100)->second);
+
+	// and the good stream still loads
+	std::istringstream in(good);
+	target.deserialize(in);
+	EXPECT_EQ(10u, target.size());
+}
@@ -0,0 +1,159 @@
+#include "publicified_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <utility>
+
+typedef SplayTree<int, int> Tree;
+
+static int depthOf(const Tree& tree, int key)
+{
+	int depth = 0;
+	for(Node<int, int>* node = tree.root_; node != NULL; ++depth)
+	{
+		if(key < node->getKey())
+		{
+			node = node->getLeft();
+		}
+		else if(node->getKey() < key)
+		{
+			node = node->getRight();
+		}
+		else
+		{
+			return depth;
+		}
+	}
+	return -1;
+}
+
+TEST(SplayTree, FindSplaysTheMatch)
+{
+	Tree tree;
+	for(int key = 0; key < 100; ++key)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+	for(int key = 0; key < 100; key += 7)
+	{
+		Tree::iterator it = tree.find(key);
+		ASSERT_NE(tree.end(), it);
+		EXPECT_EQ(key, it->second);
+		EXPECT_EQ(key, tree.root_->getKey());
+	}
+	EXPECT_TRUE(tree.validate().valid());
+}
+
+TEST(SplayTree, MissSplaysTheLastNodeVisited)
+{
+	Tree tree;
+	for(int key = 0; key < 100; key += 2)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+	EXPECT_EQ(tree.end(), tree.find(51));
+	// the walk ends next to where 51 would be
+	int top = tree.root_->getKey();
+	EXPECT_TRUE(top == 50 || top == 52) << top;
+	EXPECT_EQ(tree.end(), tree.find(-5));
+	EXPECT_EQ(0, tree.root_->getKey());
+	EXPECT_TRUE(tree.validate().valid());
+	EXPECT_EQ(50u, tree.size());
+}
+
+TEST(SplayTree, AccessToExistingKeysSplays)
+{
+	Tree tree;
+	for(int key = 0; key < 100; ++key)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+
+	tree.insert(std::make_pair(10, -10));
+	EXPECT_EQ(10, tree.root_->getKey());
+	EXPECT_EQ(-10, tree.root_->getValue());
+
+	std::pair<Tree::iterator, bool> result = tree.insert_or_assign(20, -20);
+	EXPECT_FALSE(result.second);
+	EXPECT_EQ(20, tree.root_->getKey());
+	EXPECT_EQ(-20, tree.root_->getValue());
+
+	result = tree.try_emplace(30, 0);
+	EXPECT_FALSE(result.second);
+	EXPECT_EQ(30, tree.root_->getKey());
+	EXPECT_EQ(30, tree.root_->getValue());
+
+	tree.insert(tree.end(), std::make_pair(40, -40));
+	EXPECT_EQ(40, tree.root_->getKey());
+
+	tree[50] = -50;
+	EXPECT_EQ(50, tree.root_->getKey());
+	EXPECT_EQ(-50, tree.root_->getValue());
+
+	// lookups through a const tree leave the shape alone
+	const Tree& constTree = tree;
+	EXPECT_EQ(60, constTree[60]);
+	EXPECT_EQ(50, tree.root_->getKey());
+	EXPECT_TRUE(tree.validate().valid());
+}
+
+TEST(SplayTree, SemiSplayMovesTheMatchUp)
+{
+	Tree tree;
+	tree.setLookupSplay(Tree::SEMI_SPLAY);
+	// ascending inserts leave a path, with 0 at the bottom
+	for(int key = 0; key < 64; ++key)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+	int before = depthOf(tree, 0);
+	ASSERT_NE(tree.end(), tree.find(0));
+	EXPECT_LT(depthOf(tree, 0), before);
+	EXPECT_TRUE(tree.validate().valid());
+}
+
+TEST(SplayTree, MatchesStdMap)
+{
+	for(int mode = 0; mode < 2; ++mode)
+	{
+		Tree tree;
+		tree.setLookupSplay(mode == 0 ? Tree::FULL_SPLAY : Tree::SEMI_SPLAY);
+		std::map<int, int> expected;
+		std::mt19937 rng(41 + mode);
+		for(int i = 0; i < 20000; ++i)
+		{
+			int key = rng() % 1000;
+			unsigned op = rng() % 4;
+			if(op == 0)
+			{
+				tree.remove(key);
+				expected.erase(key);
+			}
+			else if(op == 1)
+			{
+				tree.insert(std::make_pair(key, i));
+				expected[key] = i;
+			}
+			else
+			{
+				std::map<int, int>::iterator want = expected.find(key);
+				Tree::iterator got = tree.find(key);
+				ASSERT_EQ(want == expected.end(), got == tree.end()) << "key " << key;
+				if(want != expected.end())
+				{
+					EXPECT_EQ(want->second, got->second);
+				}
+			}
+		}
+		ASSERT_TRUE(tree.validate().valid());
+		ASSERT_EQ(expected.size(), tree.size());
+		std::map<int, int>::iterator want = expected.begin();
+		for(Tree::iterator it = tree.begin(); it != tree.end(); ++it, ++want)
+		{
+			ASSERT_NE(expected.end(), want);
+			EXPECT_EQ(want->first, it->first);
+		}
+	}
+}
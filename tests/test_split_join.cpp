@@ -0,0 +1,206 @@
+#include "publicified_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+typedef AVLTree<int, int> Tree;
+
+static void fill(Tree& tree, int first, int last, int step = 1)
+{
+	for(int key = first; key < last; key += step)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+}
+
+static void expectKeys(Tree& tree, const std::set<int>& expected)
+{
+	ASSERT_EQ(expected.size(), tree.size());
+	std::set<int>::const_iterator want = expected.begin();
+	for(Tree::iterator it = tree.begin(); it != tree.end(); ++it, ++want)
+	{
+		ASSERT_NE(expected.end(), want);
+		EXPECT_EQ(*want, it->first);
+	}
+	EXPECT_TRUE(tree.validate().valid());
+}
+
+TEST(SplitJoin, SplitThenJoinDoesNotCount)
+{
+	Tree tree;
+	fill(tree, 0, 1000);
+
+	Tree upper;
+	tree.split(400, upper);
+	EXPECT_EQ(Tree::UNKNOWN_COUNT, tree.knownCount());
+	EXPECT_EQ(Tree::UNKNOWN_COUNT, upper.knownCount());
+
+	// join passes the unknown count along instead of walking both trees
+	tree.join(upper);
+	EXPECT_EQ(Tree::UNKNOWN_COUNT, tree.knownCount());
+	EXPECT_EQ(0u, upper.size());
+	EXPECT_EQ(1000u, tree.size());
+
+	// once size() has counted, later changes keep the count up to date
+	EXPECT_EQ(1000u, tree.knownCount());
+	tree.insert(std::make_pair(5000, 0));
+	tree.remove(3);
+	tree.remove(4);
+	EXPECT_EQ(999u, tree.knownCount());
+	EXPECT_EQ(999u, tree.size());
+}
+
+TEST(SplitJoin, ChangesBeforeCountingStayCorrect)
+{
+	Tree tree;
+	fill(tree, 0, 100);
+	Tree upper;
+	tree.split(50, upper);
+
+	tree.insert(std::make_pair(-1, 0));
+	tree.remove(10);
+	upper.remove(50);
+	std::set<int> lower, higher;
+	for(int key = -1; key < 50; ++key)
+	{
+		if(key != 10) lower.insert(key);
+	}
+	for(int key = 51; key < 100; ++key)
+	{
+		higher.insert(key);
+	}
+	expectKeys(tree, lower);
+	expectKeys(upper, higher);
+
+	tree.join(50, 0, upper);
+	lower.insert(higher.begin(), higher.end());
+	lower.insert(50);
+	expectKeys(tree, lower);
+}
+
+TEST(SplitJoin, ConcurrentSizeOnConstTree)
+{
+	Tree tree;
+	fill(tree, 0, 20000);
+	Tree upper;
+	tree.split(12345, upper);
+
+	const Tree& shared = tree;
+	std::vector<std::thread> threads;
+	std::vector<std::size_t> sizes(4);
+	for(size_t t = 0; t < sizes.size(); ++t)
+	{
+		threads.push_back(std::thread([&shared, &sizes, t]() { sizes[t] = shared.size(); }));
+	}
+	for(size_t t = 0; t < threads.size(); ++t)
+	{
+		threads[t].join();
+	}
+	for(size_t t = 0; t < sizes.size(); ++t)
+	{
+		EXPECT_EQ(12345u, sizes[t]);
+	}
+}
+
+TEST(SplitJoin, OrderStatisticsKeepCounts)
+{
+	AVLTree<int, int, std::less<int>, true> tree, upper;
+	for(int key = 0; key < 500; ++key)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+	tree.split(123, upper);
+	EXPECT_EQ(123u, tree.knownCount());
+	EXPECT_EQ(377u, upper.knownCount());
+	tree.join(upper);
+	EXPECT_EQ(500u, tree.knownCount());
+	EXPECT_EQ(250, tree.select(250)->first);
+}
+
+TEST(SplitJoin, OrderStatisticsSizeLimit)
+{
+	typedef AVLTree<int, int, std::less<int>, true> CountedTree;
+	const std::size_t limit = CountedTree::MAX_ORDER_STATISTICS_SIZE;
+	CountedTree tree(std::make_shared<NodePool>(sizeof(AVLNode<int, int>))), other(tree.getPool());
+	for(int key = 0; key < 10; ++key)
+	{
+		tree.insert(std::make_pair(key, key));
+		other.insert(std::make_pair(key + 100, key));
+	}
+
+	// pretend the tree is full rather than allocating 2^32 nodes
+	tree.nodeCount_ = limit;
+	EXPECT_THROW(tree.insert(std::make_pair(50, 50)), std::length_error);
+	tree.insert(std::make_pair(5, 55));
+	EXPECT_EQ(55, tree.find(5)->second);
+
+	tree.nodeCount_ = limit - 9;
+	EXPECT_THROW(tree.join(other), std::length_error);
+	EXPECT_THROW(tree.join(50, 50, other), std::length_error);
+	EXPECT_THROW(tree.unionWith(other), std::length_error);
+	EXPECT_EQ(10u, other.size());
+
+	// intersections and differences only ever shrink the tree
+	tree.nodeCount_ = 10;
+	tree.intersectWith(other);
+	EXPECT_TRUE(tree.empty());
+	EXPECT_TRUE(other.empty());
+}
+
+TEST(SplitJoin, MismatchedPoolsAreRejected)
+{
+	Tree left, right;
+	fill(left, 0, 10);
+	fill(right, 10, 20);
+	EXPECT_THROW(left.join(right), std::invalid_argument);
+	EXPECT_THROW(left.unionWith(right), std::invalid_argument);
+	EXPECT_EQ(10u, left.size());
+	EXPECT_EQ(10u, right.size());
+
+	// an empty tree takes over the other tree's pool
+	Tree empty;
+	empty.join(right);
+	EXPECT_EQ(10u, empty.size());
+	EXPECT_EQ(right.getPool(), empty.getPool());
+
+	Tree shared(left.getPool());
+	fill(shared, 10, 20);
+	left.join(shared);
+	EXPECT_EQ(20u, left.size());
+}
+
+TEST(SplitJoin, SetOperationsMatchStdSet)
+{
+	Tree a;
+	Tree b(a.getPool());
+	fill(a, 0, 3000, 2);
+	fill(b, 0, 3000, 3);
+	std::set<int> evens, thirds;
+	for(int key = 0; key < 3000; key += 2) evens.insert(key);
+	for(int key = 0; key < 3000; key += 3) thirds.insert(key);
+
+	// split first so that the set operation starts from unknown counts
+	Tree upper;
+	a.split(1500, upper);
+	a.join(upper);
+	a.unionWith(b);
+	std::set<int> expected(evens);
+	expected.insert(thirds.begin(), thirds.end());
+	expectKeys(a, expected);
+
+	Tree c(a.getPool());
+	fill(c, 0, 3000, 3);
+	a.difference(c);
+	std::set<int> difference;
+	for(std::set<int>::iterator it = expected.begin(); it != expected.end(); ++it)
+	{
+		if(thirds.count(*it) == 0) difference.insert(*it);
+	}
+	expectKeys(a, difference);
+}
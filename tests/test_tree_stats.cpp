@@ -0,0 +1,189 @@
+// Built with BST_INSTRUMENT (see tree-stats-tests in the Makefile)
+#include <avlbst.h>
+#include <splaybst.h>
+#include <tree_stats.h>
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef BST_INSTRUMENT
+#error "tree stats tests need -DBST_INSTRUMENT"
+#endif
+
+TEST(TreeStats, CountsAllocationsAndFrees)
+{
+	BinarySearchTree<int, int> tree;
+	TreeStats::reset();
+	for(int key = 0; key < 10; ++key)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+	// overwriting a value allocates nothing
+	tree.insert(std::make_pair(3, 30));
+	for(int key = 0; key < 4; ++key)
+	{
+		tree.remove(key);
+	}
+	TreeStats stats = TreeStats::local();
+	EXPECT_EQ(10u, stats.counts[TreeStats::ALLOCATIONS]);
+	EXPECT_EQ(4u, stats.counts[TreeStats::DEALLOCATIONS]);
+}
+
+TEST(TreeStats, CountsOneDescent)
+{
+	AVLTree<int, int> tree;
+	std::map<int, int> items;
+	for(int key = 1; key <= 7; ++key)
+	{
+		items[key] = key;
+	}
+	tree.buildFromSorted(items.begin(), items.end());
+
+	// 4, 2, 1 and then one comparison to confirm the candidate
+	TreeStats::reset();
+	ASSERT_NE(tree.end(), tree.find(1));
+	TreeStats stats = TreeStats::local();
+	EXPECT_EQ(3u, stats.counts[TreeStats::NODE_VISITS]);
+	EXPECT_EQ(4u, stats.counts[TreeStats::COMPARISONS]);
+	EXPECT_EQ(0u, stats.counts[TreeStats::ROTATIONS]);
+}
+
+TEST(TreeStats, SplayFindOfHotKeyVisitsOneNode)
+{
+	SplayTree<int, int> tree;
+	for(int key = 0; key < 1000; ++key)
+	{
+		tree.insert(std::make_pair((key * 7919) % 1000, key));
+	}
+	ASSERT_NE(tree.end(), tree.find(500));
+
+	// the first find splayed 500 to the root, where the descent now stops
+	TreeStats::reset();
+	ASSERT_NE(tree.end(), tree.find(500));
+	TreeStats stats = TreeStats::local();
+	EXPECT_EQ(1u, stats.counts[TreeStats::NODE_VISITS]);
+	EXPECT_EQ(0u, stats.counts[TreeStats::ROTATIONS]);
+}
+
+TEST(TreeStats, HintedInsertSkipsTheDescent)
+{
+	AVLTree<int, int> tree;
+	for(int key = 0; key < 1000; ++key)
+	{
+		tree.insert(std::make_pair(key * 2, key));
+	}
+
+	// appends at end() only compare against the largest key
+	TreeStats::reset();
+	for(int key = 1000; key < 1100; ++key)
+	{
+		tree.insert(tree.end(), std::make_pair(key * 2, key));
+	}
+	TreeStats stats = TreeStats::local();
+	EXPECT_EQ(0u, stats.counts[TreeStats::NODE_VISITS]);
+	EXPECT_EQ(100u, stats.counts[TreeStats::COMPARISONS]);
+
+	// a correct hint looks at the hint and its predecessor only
+	AVLTree<int, int>::iterator hint = tree.find(1001 * 2);
+	TreeStats::reset();
+	tree.insert(hint, std::make_pair(2001, 0));
+	stats = TreeStats::local();
+	EXPECT_EQ(2u, stats.counts[TreeStats::NODE_VISITS]);
+	EXPECT_EQ(2u, stats.counts[TreeStats::COMPARISONS]);
+
+	// so does a begin() hint for a new smallest key, without a predecessor
+	TreeStats::reset();
+	tree.insert(tree.begin(), std::make_pair(-1, 0));
+	stats = TreeStats::local();
+	EXPECT_EQ(1u, stats.counts[TreeStats::NODE_VISITS]);
+	EXPECT_EQ(1u, stats.counts[TreeStats::COMPARISONS]);
+
+	// a wrong one falls back to the full descent
+	TreeStats::reset();
+	tree.insert(hint, std::make_pair(7, 0));
+	stats = TreeStats::local();
+	EXPECT_LE(10u, stats.counts[TreeStats::NODE_VISITS]);
+	EXPECT_TRUE(tree.isBalanced());
+}
+
+TEST(TreeStats, CountsRotationsAndRebalancing)
+{
+	AVLTree<int, int> tree;
+	TreeStats::reset();
+	tree.insert(std::make_pair(1, 1));
+	tree.insert(std::make_pair(2, 2));
+	tree.insert(std::make_pair(3, 3));
+	TreeStats stats = TreeStats::local();
+	EXPECT_EQ(1u, stats.counts[TreeStats::ROTATIONS]);
+	EXPECT_LE(1u, stats.counts[TreeStats::REBALANCES]);
+	EXPECT_LE(1u, stats.counts[TreeStats::REBALANCE_STEPS]);
+	EXPECT_LE(1u, stats.maxRebalanceDepth);
+
+	TreeStats::reset();
+	stats = TreeStats::local();
+	for(int i = 0; i < TreeStats::COUNTERS; ++i)
+	{
+		EXPECT_EQ(0u, stats.counts[i]) << TreeStats::name(static_cast<TreeStats::Counter>(i));
+	}
+	EXPECT_EQ(0u, stats.maxRebalanceDepth);
+}
+
+TEST(TreeStats, TotalAddsUpThreads)
+{
+	const int THREADS = 4;
+	const int KEYS = 5000;
+	TreeStats::reset();
+
+	std::vector<std::thread> threads;
+	for(int t = 0; t < THREADS; ++t)
+	{
+		threads.push_back(std::thread([KEYS]()
+		{
+			AVLTree<int, int> tree;
+			for(int key = 0; key < KEYS; ++key)
+			{
+				tree.insert(std::make_pair(key, key));
+			}
+			// total() is safe to call while other threads are counting
+			TreeStats::total();
+		}));
+	}
+	for(int t = 0; t < THREADS; ++t)
+	{
+		threads[t].join();
+	}
+
+	// the threads have exited, so their counts are in the retired totals
+	TreeStats total = TreeStats::total();
+	EXPECT_EQ(static_cast<uint64_t>(THREADS * KEYS), total.counts[TreeStats::ALLOCATIONS]);
+	EXPECT_EQ(0u, TreeStats::local().counts[TreeStats::ALLOCATIONS]);
+
+	TreeStats::reset();
+	EXPECT_EQ(0u, TreeStats::total().counts[TreeStats::ALLOCATIONS]);
+}
+
+TEST(TreeStats, AddsAndPrintsJson)
+{
+	TreeStats a, b;
+	a.counts[TreeStats::ROTATIONS] = 2;
+	a.maxRebalanceDepth = 5;
+	b.counts[TreeStats::ROTATIONS] = 3;
+	b.counts[TreeStats::NODE_SWAPS] = 1;
+	b.maxRebalanceDepth = 4;
+	a += b;
+	EXPECT_EQ(5u, a.counts[TreeStats::ROTATIONS]);
+	EXPECT_EQ(1u, a.counts[TreeStats::NODE_SWAPS]);
+	EXPECT_EQ(5u, a.maxRebalanceDepth);
+
+	std::ostringstream out;
+	a.writeJson(out);
+	EXPECT_EQ("{\"comparisons\": 0, \"nodeVisits\": 0, \"rotations\": 5, \"nodeSwaps\": 1, "
+		"\"allocations\": 0, \"deallocations\": 0, \"rebalances\": 0, \"rebalanceSteps\": 0, "
+		"\"maxRebalanceDepth\": 5}", out.str());
+}
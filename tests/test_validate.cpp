@@ -0,0 +1,175 @@
+#include "publicified_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+
+typedef AVLTree<int, int> Tree;
+
+// A perfect tree of 2^levels - 1 nodes with keys 1, 2, 3 ...
+static void buildPerfect(Tree& tree, int levels)
+{
+	std::map<int, int> items;
+	for(int key = 1; key < (1 << levels); ++key)
+	{
+		items[key] = key;
+	}
+	tree.buildFromSorted(items.begin(), items.end());
+}
+
+static std::string problemOf(const TreeShape& shape)
+{
+	return shape.problem == NULL ? "" : shape.problem;
+}
+
+TEST(Validate, ShapeOfPerfectTree)
+{
+	Tree tree;
+	buildPerfect(tree, 3);
+	TreeShape shape = tree.validate();
+	ASSERT_TRUE(shape.valid()) << shape.problem;
+	EXPECT_TRUE(shape.heightBalanced);
+	EXPECT_EQ(7u, shape.nodes);
+	EXPECT_EQ(3, shape.height);
+	EXPECT_EQ(2, shape.maxDepth);
+	EXPECT_DOUBLE_EQ(10.0 / 7, shape.averageDepth);
+	ASSERT_EQ(3u, shape.leafDepths.size());
+	EXPECT_EQ(0u, shape.leafDepths[0]);
+	EXPECT_EQ(0u, shape.leafDepths[1]);
+	EXPECT_EQ(4u, shape.leafDepths[2]);
+}
+
+TEST(Validate, EmptyTree)
+{
+	Tree tree;
+	TreeShape shape = tree.validate();
+	EXPECT_TRUE(shape.valid());
+	EXPECT_EQ(0u, shape.nodes);
+	EXPECT_EQ(0, shape.height);
+	EXPECT_TRUE(shape.leafDepths.empty());
+}
+
+TEST(Validate, RandomTreesStayValid)
+{
+	Tree tree;
+	std::mt19937 rng(11);
+	for(int i = 0; i < 20000; ++i)
+	{
+		int key = rng() % 4000;
+		if(rng() % 3 == 0)
+		{
+			tree.remove(key);
+		}
+		else
+		{
+			tree.insert(std::make_pair(key, i));
+		}
+	}
+	TreeShape shape = tree.validate();
+	ASSERT_TRUE(shape.valid()) << shape.problem;
+	EXPECT_TRUE(shape.heightBalanced);
+	EXPECT_EQ(tree.size(), shape.nodes);
+}
+
+TEST(Validate, DegenerateTreeIsValidButNotBalanced)
+{
+	BinarySearchTree<int, int> tree;
+	for(int key = 0; key < 10; ++key)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+	TreeShape shape = tree.validate();
+	EXPECT_TRUE(shape.valid());
+	EXPECT_FALSE(shape.heightBalanced);
+	EXPECT_EQ(10, shape.height);
+	ASSERT_EQ(10u, shape.leafDepths.size());
+	EXPECT_EQ(1u, shape.leafDepths[9]);
+}
+
+TEST(Validate, CatchesWrongBalanceFactor)
+{
+	Tree tree;
+	buildPerfect(tree, 3);
+	AVLNode<int, int>* node = static_cast<AVLNode<int, int>*>(tree.root_)->getLeft();
+	node->setBalance(1);
+	EXPECT_EQ("a stored balance factor does not match the subtree heights", problemOf(tree.validate()));
+	node->setBalance(0);
+	EXPECT_TRUE(tree.validate().valid());
+}
+
+TEST(Validate, CatchesAvlImbalance)
+{
+	// relink 0 <- 1 -> 2 into the path 0 -> 1 -> 2, with balances that
+	// match the heights, so only the AVL condition itself is broken
+	Tree tree;
+	buildPerfect(tree, 2);
+	AVLNode<int, int>* middle = static_cast<AVLNode<int, int>*>(tree.root_);
+	AVLNode<int, int>* low = middle->getLeft();
+	middle->setLeft(NULL);
+	low->setRight(middle);
+	low->setParent(NULL);
+	middle->setParent(low);
+	tree.root_ = low;
+	low->setBalance(2);
+	middle->setBalance(1);
+	EXPECT_EQ("a node is out of AVL balance", problemOf(tree.validate()));
+}
+
+TEST(Validate, CatchesBrokenParentLink)
+{
+	Tree tree;
+	buildPerfect(tree, 3);
+	AVLNode<int, int>* root = static_cast<AVLNode<int, int>*>(tree.root_);
+	AVLNode<int, int>* child = root->getLeft()->getLeft();
+	child->setParent(root);
+	EXPECT_EQ("a child does not point back at its parent", problemOf(tree.validate()));
+	child->setParent(root->getLeft());
+
+	root->setParent(child);
+	EXPECT_EQ("the root has a parent", problemOf(tree.validate()));
+	root->setParent(NULL);
+	EXPECT_TRUE(tree.validate().valid());
+}
+
+TEST(Validate, CatchesKeysOutOfOrder)
+{
+	Tree tree;
+	buildPerfect(tree, 2);
+	AVLNode<int, int>* root = static_cast<AVLNode<int, int>*>(tree.root_);
+	AVLNode<int, int>* left = root->getLeft();
+	AVLNode<int, int>* right = root->getRight();
+	root->setLeft(right);
+	root->setRight(left);
+	EXPECT_EQ("keys are not in increasing order", problemOf(tree.validate()));
+}
+
+TEST(Validate, CatchesStaleCaches)
+{
+	Tree tree;
+	buildPerfect(tree, 3);
+	Node<int, int>* smallest = tree.minNode_;
+	tree.minNode_ = tree.root_;
+	EXPECT_EQ("the cached smallest or largest node is stale", problemOf(tree.validate()));
+	tree.minNode_ = smallest;
+
+	tree.nodeCount_ = 8;
+	EXPECT_EQ("the cached node count is wrong", problemOf(tree.validate()));
+	tree.nodeCount_ = 7;
+	EXPECT_TRUE(tree.validate().valid());
+}
+
+TEST(Validate, CatchesWrongSubtreeSize)
+{
+	AVLTree<int, int, std::less<int>, true> tree;
+	for(int key = 0; key < 15; ++key)
+	{
+		tree.insert(std::make_pair(key, key));
+	}
+	ASSERT_TRUE(tree.validate().valid());
+	AVLNode<int, int>* root = static_cast<AVLNode<int, int>*>(tree.root_);
+	root->getLeft()->setSize(root->getLeft()->getSize() + 1);
+	EXPECT_EQ("a stored subtree size is wrong", problemOf(tree.validate()));
+}
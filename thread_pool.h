@@ -0,0 +1,224 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+* A small fork-join thread pool for divide and conquer tree algorithms.
+* parallelInvoke(first, second) offers first to the workers, runs second on
+* the calling thread and then waits for first. While waiting, a thread takes
+* its own task back if nobody has started it yet, or else helps by running
+* other queued tasks. That way parallelInvoke can be nested as deeply as the
+* recursion goes without ever blocking every worker on a child task.
+*/
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    template<typename F, typename G>
+    void parallelInvoke(F&& first, G&& second);
+
+    unsigned size() const;
+
+    static ThreadPool& shared();
+
+private:
+    // Non-copyable: the workers belong to exactly one pool
+    ThreadPool(const ThreadPool& other);
+    ThreadPool& operator=(const ThreadPool& other);
+
+    enum TaskState { PENDING, RUNNING, DONE };
+
+    struct Task
+    {
+        std::function<void()> work;
+        std::atomic<int> state;
+        std::exception_ptr error;
+    };
+
+    void workerLoop();
+    bool runQueued();
+    static bool tryRun(Task& task);
+
+    std::vector<std::thread> workers_;
+    std::deque<std::shared_ptr<Task> > queue_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    bool stopping_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the ThreadPool class.
+  -----------------------------------------------
+*/
+
+/**
+* Creates a pool where threads threads (counting the caller of
+* parallelInvoke) share the work, so threads - 1 workers are started.
+*/
+inline ThreadPool::ThreadPool(unsigned threads) :
+    stopping_(false)
+{
+    for (unsigned i = 1; i < threads; ++i) {
+        workers_.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+/**
+* Destructor, which lets the workers drain the queue and joins them.
+*/
+inline ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    ready_.notify_all();
+    for (std::size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i].join();
+    }
+}
+
+/**
+* Runs first and second, potentially in parallel, and returns once both
+* are done. An exception thrown by either one is rethrown here (second's
+* wins if both throw).
+*/
+template<typename F, typename G>
+void ThreadPool::parallelInvoke(F&& first, G&& second)
+{
+    if (workers_.empty()) {
+        first();
+        second();
+        return;
+    }
+
+    std::shared_ptr<Task> task = std::make_shared<Task>();
+    task->work = std::function<void()>(std::forward<F>(first));
+    task->state.store(PENDING);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(task);
+    }
+    ready_.notify_one();
+
+    // first may refer to our stack frame, so it has to finish even if second throws
+    std::exception_ptr secondError;
+    try {
+        second();
+    } catch (...) {
+        secondError = std::current_exception();
+    }
+
+    if (!tryRun(*task)) {
+        while (task->state.load(std::memory_order_acquire) != DONE) {
+            if (!runQueued()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    if (secondError) {
+        std::rethrow_exception(secondError);
+    }
+    if (task->error) {
+        std::rethrow_exception(task->error);
+    }
+}
+
+/**
+* Returns how many threads share the work, including the caller.
+*/
+inline unsigned ThreadPool::size() const
+{
+    return static_cast<unsigned>(workers_.size()) + 1;
+}
+
+/**
+* A process-wide pool with one thread per hardware thread.
+*/
+inline ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+/**
+* Worker body: run tasks until the pool is destroyed.
+*/
+inline void ThreadPool::workerLoop()
+{
+    for (;;) {
+        std::shared_ptr<Task> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (queue_.empty() && !stopping_) {
+                ready_.wait(lock);
+            }
+            if (queue_.empty()) {
+                return;
+            }
+            task = queue_.front();
+            queue_.pop_front();
+        }
+        tryRun(*task);
+    }
+}
+
+/**
+* Runs one queued task on the calling thread.
+* Returns false if there was nothing to run.
+*/
+inline bool ThreadPool::runQueued()
+{
+    std::shared_ptr<Task> task;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.empty()) {
+            return false;
+        }
+        task = queue_.front();
+        queue_.pop_front();
+    }
+    tryRun(*task);
+    return true;
+}
+
+/**
+* Claims and runs task unless another thread already has.
+* Tasks taken back by their owner stay queued, so losing the race is normal.
+*/
+inline bool ThreadPool::tryRun(Task& task)
+{
+    int expected = PENDING;
+    if (!task.state.compare_exchange_strong(expected, RUNNING)) {
+        return false;
+    }
+    try {
+        task.work();
+    } catch (...) {
+        task.error = std::current_exception();
+    }
+    task.state.store(DONE, std::memory_order_release);
+    return true;
+}
+
+/*
+  ---------------------------------------------
+  End implementations for the ThreadPool class.
+  ---------------------------------------------
+*/
+
+#endif
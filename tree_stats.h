@@ -0,0 +1,307 @@
+#ifndef TREE_STATS_H
+#define TREE_STATS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+/**
+* Hot-path counters for the search trees: comparisons and nodes visited
+* by the descents, rotations, nodeSwap() calls, node allocations and
+* frees, and how far AVL rebalancing walks back up per insert/remove.
+* Frees count nodes released one at a time; clear() may drop whole pool
+* slabs instead.
+*
+* They are compiled in only when BST_INSTRUMENT is defined (e.g.
+* make DEFS=-DBST_INSTRUMENT). Otherwise the BST_COUNT macros below
+* expand to nothing, so an uninstrumented build runs exactly the code it
+* did before.
+*
+* Every thread counts into its own slot, so counting takes no lock and
+* no atomic read-modify-write. TreeStats::local() snapshots the calling
+* thread's counters; TreeStats::total() adds up every thread's, those of
+* threads that have already exited included. Snapshots add up with +=
+* and print as a JSON object with writeJson().
+*/
+struct TreeStats
+{
+    enum Counter {
+        COMPARISONS,
+        NODE_VISITS,
+        ROTATIONS,
+        NODE_SWAPS,
+        ALLOCATIONS,
+        DEALLOCATIONS,
+        REBALANCES,
+        REBALANCE_STEPS,
+        COUNTERS
+    };
+
+    TreeStats();
+    TreeStats& operator+=(const TreeStats& other);
+    void writeJson(std::ostream& out) const;
+
+    static TreeStats local();
+    static TreeStats total();
+    static void reset();
+    static const char* name(Counter counter);
+
+    uint64_t counts[COUNTERS];
+    // the most levels a single rebalance walked
+    uint64_t maxRebalanceDepth;
+};
+
+/**
+* One thread's counters. Only the owning thread writes them, with plain
+* relaxed load/store pairs, so total() can read them from other threads
+* without a data race.
+*/
+class TreeStatsRecorder
+{
+public:
+    TreeStatsRecorder();
+    ~TreeStatsRecorder();
+
+    static TreeStatsRecorder& mine();
+
+    void add(TreeStats::Counter counter);
+    void startRebalance();
+    void rebalanceStep();
+    TreeStats snapshot() const;
+    void reset();
+
+private:
+    // Non-copyable: the registry holds a pointer to each recorder
+    TreeStatsRecorder(const TreeStatsRecorder& other);
+    TreeStatsRecorder& operator=(const TreeStatsRecorder& other);
+
+    struct Registry
+    {
+        std::mutex lock;
+        std::vector<TreeStatsRecorder*> live;
+        TreeStats retired;
+    };
+    static Registry& registry();
+
+    friend struct TreeStats;
+
+    std::atomic<uint64_t> counts_[TreeStats::COUNTERS];
+    std::atomic<uint64_t> maxDepth_;
+    uint64_t depth_;
+};
+
+#ifdef BST_INSTRUMENT
+#define BST_COUNT(counter) TreeStatsRecorder::mine().add(TreeStats::counter)
+#define BST_REBALANCE_START() TreeStatsRecorder::mine().startRebalance()
+#define BST_REBALANCE_STEP() TreeStatsRecorder::mine().rebalanceStep()
+#else
+#define BST_COUNT(counter) ((void)0)
+#define BST_REBALANCE_START() ((void)0)
+#define BST_REBALANCE_STEP() ((void)0)
+#endif
+
+/*
+  ----------------------------------------------
+  Begin implementations for the TreeStats class.
+  ----------------------------------------------
+*/
+
+/**
+* Default constructor: all counters zero
+*/
+inline TreeStats::TreeStats() :
+    maxRebalanceDepth(0)
+{
+    std::fill(counts, counts + COUNTERS, 0);
+}
+
+/**
+* Adds other's counters to these (the deepest rebalance is the larger one).
+*/
+inline TreeStats& TreeStats::operator+=(const TreeStats& other)
+{
+    for (int i = 0; i < COUNTERS; ++i) {
+        counts[i] += other.counts[i];
+    }
+    maxRebalanceDepth = std::max(maxRebalanceDepth, other.maxRebalanceDepth);
+    return *this;
+}
+
+/**
+* Prints the counters as one JSON object keyed by name().
+*/
+inline void TreeStats::writeJson(std::ostream& out) const
+{
+    out << "{";
+    for (int i = 0; i < COUNTERS; ++i) {
+        out << "\"" << name(static_cast<Counter>(i)) << "\": " << counts[i] << ", ";
+    }
+    out << "\"maxRebalanceDepth\": " << maxRebalanceDepth << "}";
+}
+
+/**
+* Returns the calling thread's counters.
+*/
+inline TreeStats TreeStats::local()
+{
+    return TreeStatsRecorder::mine().snapshot();
+}
+
+/**
+* Returns every thread's counters added up.
+*/
+inline TreeStats TreeStats::total()
+{
+    TreeStatsRecorder::Registry& registry = TreeStatsRecorder::registry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+    TreeStats sum = registry.retired;
+    for (std::size_t i = 0; i < registry.live.size(); ++i) {
+        sum += registry.live[i]->snapshot();
+    }
+    return sum;
+}
+
+/**
+* Zeroes every thread's counters. Counts made concurrently may survive.
+*/
+inline void TreeStats::reset()
+{
+    TreeStatsRecorder::Registry& registry = TreeStatsRecorder::registry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+    registry.retired = TreeStats();
+    for (std::size_t i = 0; i < registry.live.size(); ++i) {
+        registry.live[i]->reset();
+    }
+}
+
+/**
+* The JSON name of a counter.
+*/
+inline const char* TreeStats::name(Counter counter)
+{
+    static const char* const names[COUNTERS] = {
+        "comparisons", "nodeVisits", "rotations", "nodeSwaps",
+        "allocations", "deallocations", "rebalances", "rebalanceSteps"
+    };
+    return names[counter];
+}
+
+/*
+  --------------------------------------------
+  End implementations for the TreeStats class.
+  --------------------------------------------
+*/
+
+/*
+  ------------------------------------------------------
+  Begin implementations for the TreeStatsRecorder class.
+  ------------------------------------------------------
+*/
+
+/**
+* Constructor: registers the new thread's counters.
+*/
+inline TreeStatsRecorder::TreeStatsRecorder() :
+    maxDepth_(0),
+    depth_(0)
+{
+    for (int i = 0; i < TreeStats::COUNTERS; ++i) {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    reg.live.push_back(this);
+}
+
+/**
+* Destructor: at thread exit the counts move to the retired totals.
+*/
+inline TreeStatsRecorder::~TreeStatsRecorder()
+{
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    reg.retired += snapshot();
+    reg.live.erase(std::find(reg.live.begin(), reg.live.end(), this));
+}
+
+/**
+* Returns the calling thread's recorder, creating it on first use.
+*/
+inline TreeStatsRecorder& TreeStatsRecorder::mine()
+{
+    static thread_local TreeStatsRecorder recorder;
+    return recorder;
+}
+
+/**
+* Counts one event.
+*/
+inline void TreeStatsRecorder::add(TreeStats::Counter counter)
+{
+    counts_[counter].store(counts_[counter].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+/**
+* Called as an insert or remove starts rebalancing.
+*/
+inline void TreeStatsRecorder::startRebalance()
+{
+    add(TreeStats::REBALANCES);
+    depth_ = 0;
+}
+
+/**
+* Called for every level the current rebalance walks.
+*/
+inline void TreeStatsRecorder::rebalanceStep()
+{
+    add(TreeStats::REBALANCE_STEPS);
+    if (++depth_ > maxDepth_.load(std::memory_order_relaxed)) {
+        maxDepth_.store(depth_, std::memory_order_relaxed);
+    }
+}
+
+/**
+* Returns a copy of the counters.
+*/
+inline TreeStats TreeStatsRecorder::snapshot() const
+{
+    TreeStats stats;
+    for (int i = 0; i < TreeStats::COUNTERS; ++i) {
+        stats.counts[i] = counts_[i].load(std::memory_order_relaxed);
+    }
+    stats.maxRebalanceDepth = maxDepth_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+/**
+* Zeroes the counters.
+*/
+inline void TreeStatsRecorder::reset()
+{
+    for (int i = 0; i < TreeStats::COUNTERS; ++i) {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+    maxDepth_.store(0, std::memory_order_relaxed);
+}
+
+/**
+* The list of live recorders and the counts left by exited threads.
+*/
+inline TreeStatsRecorder::Registry& TreeStatsRecorder::registry()
+{
+    static Registry reg;
+    return reg;
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the TreeStatsRecorder class.
+  ----------------------------------------------------
+*/
+
+#endif